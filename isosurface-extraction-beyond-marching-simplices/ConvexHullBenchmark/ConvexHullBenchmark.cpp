@@ -0,0 +1,241 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <map>
+#include <set>
+#include <tuple>
+#include <iostream>
+#include <random>
+#include <type_traits>
+#include "Misha/Miscellany.h"
+#include "Misha/CmdLineParser.h"
+#include "Misha/Geometry.h"
+#include "Include/ConvexHull.h"
+#include "Include/Timings.h"
+
+Misha::CmdLineParameter< std::string > Out( "out" ) , Baseline( "baseline" );
+Misha::CmdLineParameter< unsigned int > MaxPoints( "maxN" , 256 ) , Trials( "trials" , 2000 ) , Seed( "seed" , 0 );
+Misha::CmdLineParameter< double > Slack( "slack" , 1.5 );
+Misha::CmdLineReadable RunDefaults( "run" ) , Verbose( "verbose" );
+
+Misha::CmdLineReadable* params[] =
+{
+	&RunDefaults ,
+	&Out ,
+	&Baseline ,
+	&MaxPoints ,
+	&Trials ,
+	&Seed ,
+	&Slack ,
+	&Verbose ,
+	NULL
+};
+
+void ShowUsage( const char* ex )
+{
+	std::cout << "Usage " << std::string( ex ) << ":" << std::endl;
+	std::cout << "\t[--" << RunDefaults.name << "] (runs the benchmark if no other argument is given)" << std::endl;
+	std::cout << "\t[--" << Out.name << " <output timings (CSV)>]" << std::endl;
+	std::cout << "\t[--" << Baseline.name << " <baseline timings (CSV)>]" << std::endl;
+	std::cout << "\t[--" << MaxPoints.name << " <maximum number of points>=" << MaxPoints.value << "]" << std::endl;
+	std::cout << "\t[--" << Trials.name << " <number of hulls per measurement>=" << Trials.value << "]" << std::endl;
+	std::cout << "\t[--" << Seed.name << " <random seed>=" << Seed.value << "]" << std::endl;
+	std::cout << "\t[--" << Slack.name << " <allowed slow-down relative to the baseline>=" << Slack.value << "]" << std::endl;
+	std::cout << "\t[--" << Verbose.name << "]" << std::endl;
+}
+
+// The maximum number of entries in the (dense) boundary map of the incremental hull for which it will be benchmarked
+static const size_t MaxIncrementalHullStorage = 1<<22;
+
+// The number of entries in the (dense) boundary map of the incremental hull, Choose( n , Dim-1 ), computed without overflow
+template< unsigned int Dim >
+size_t IncrementalHullStorage( unsigned int n )
+{
+	size_t storage = 1;
+	for( unsigned int k=0 ; k<Dim-1 ; k++ ) storage = ( storage * ( n-k ) ) / ( k+1 );
+	return storage;
+}
+
+enum Distribution
+{
+	RANDOM ,		// Uniformly distributed in the unit cube
+	SPHERICAL ,		// Uniformly distributed on the unit sphere (co-circular in 2D)
+	DEGENERATE ,	// Points on a coarse lattice, with a small jitter
+	DISTRIBUTION_COUNT
+};
+const std::string DistributionNames[] = { "random" , "spherical" , "degenerate" };
+
+enum Method
+{
+	SIMPLE_HULL ,
+	INCREMENTAL_HULL ,
+	Q_HULL ,
+	METHOD_COUNT
+};
+const std::string MethodNames[] = { "simple" , "incremental" , "qhull" };
+
+// A (dimension , distribution , number of points , method) key
+using Key = std::tuple< unsigned int , std::string , unsigned int , std::string >;
+
+template< unsigned int Dim >
+std::vector< Point< double , Dim > > Sample( Distribution distribution , unsigned int n , std::mt19937 &generator )
+{
+	std::uniform_real_distribution< double > uniform( -1. , 1. );
+	std::normal_distribution< double > normal( 0. , 1. );
+	// Use a lattice with (roughly) as many sites as points
+	int latticeRadius = std::max< int >( 2 , (int)ceil( pow( (double)n , 1./Dim ) / 2 ) );
+	std::uniform_int_distribution< int > lattice( -latticeRadius , latticeRadius );
+
+	std::vector< Point< double , Dim > > points( n );
+	for( unsigned int i=0 ; i<n ; i++ )
+	{
+		Point< double , Dim > &p = points[i];
+		switch( distribution )
+		{
+		case RANDOM:
+			for( unsigned int d=0 ; d<Dim ; d++ ) p[d] = uniform( generator );
+			break;
+		case SPHERICAL:
+			do for( unsigned int d=0 ; d<Dim ; d++ ) p[d] = normal( generator );
+			while( !p.squareNorm() );
+			p /= sqrt( p.squareNorm() );
+			break;
+		case DEGENERATE:
+			for( unsigned int d=0 ; d<Dim ; d++ ) p[d] = lattice( generator ) + 1e-4 * uniform( generator );
+			break;
+		default: ERROR_OUT( "Unrecognized distribution: " , distribution );
+		}
+	}
+	return points;
+}
+
+// Returns the facets with sorted indices, in sorted order
+template< unsigned int Dim >
+std::vector< std::vector< unsigned int > > CanonicalFacets( const std::vector< SimplexIndex< Dim-1 > > &hull )
+{
+	std::vector< std::vector< unsigned int > > facets( hull.size() );
+	for( unsigned int i=0 ; i<hull.size() ; i++ )
+	{
+		facets[i].resize( Dim );
+		for( unsigned int d=0 ; d<Dim ; d++ ) facets[i][d] = hull[i][d];
+		std::sort( facets[i].begin() , facets[i].end() );
+	}
+	std::sort( facets.begin() , facets.end() );
+	return facets;
+}
+
+// Returns the set of indices of points on the hull
+template< unsigned int Dim >
+std::set< unsigned int > HullVertices( const std::vector< SimplexIndex< Dim-1 > > &hull )
+{
+	std::set< unsigned int > vertices;
+	for( unsigned int i=0 ; i<hull.size() ; i++ ) for( unsigned int d=0 ; d<Dim ; d++ ) vertices.insert( hull[i][d] );
+	return vertices;
+}
+
+template< unsigned int Dim >
+void Benchmark( std::mt19937 &generator , std::map< Key , std::pair< double , unsigned int > > &timings )
+{
+	ConvexHull::SimpleHullScratch< Dim > simpleHullScratch;
+	ConvexHull::IncrementalHullScratch< Dim , (unsigned int)-1 > incrementalHullScratch;
+
+	// The numbers of points to benchmark
+	std::vector< unsigned int > sizes;
+	sizes.push_back( Dim+1 ) , sizes.push_back( Dim+2 );
+	for( unsigned int n=8 ; n<=MaxPoints.value ; n*=2 )
+	{
+		if( n>Dim+2 ) sizes.push_back( n );
+		if( n+n/2>Dim+2 && n+n/2<=MaxPoints.value ) sizes.push_back( n+n/2 );
+	}
+
+	for( unsigned int dist=0 ; dist<DISTRIBUTION_COUNT ; dist++ )
+	{
+		unsigned int crossover = (unsigned int)-1;
+		for( unsigned int s=0 ; s<sizes.size() ; s++ )
+		{
+			unsigned int n = sizes[s];
+			unsigned int trials = std::max< unsigned int >( 1 , ( Trials.value * (Dim+2) ) / n );
+
+			std::vector< std::vector< Point< double , Dim > > > pointSets( trials );
+			for( unsigned int t=0 ; t<trials ; t++ ) pointSets[t] = Sample< Dim >( (Distribution)dist , n , generator );
+
+			std::vector< std::vector< SimplexIndex< Dim-1 > > > hulls[METHOD_COUNT];
+			double nsPerHull[METHOD_COUNT];
+			for( unsigned int m=0 ; m<METHOD_COUNT ; m++ )
+			{
+				nsPerHull[m] = -1;
+				if( m==SIMPLE_HULL && n>ConvexHull::MaxSimpleHullSize< Dim >() ) continue;
+				if( m==INCREMENTAL_HULL && ( n<=Dim || IncrementalHullStorage< Dim >( n )>MaxIncrementalHullStorage ) ) continue;
+
+				hulls[m].resize( trials );
+				Miscellany::Timer timer;
+				for( unsigned int t=0 ; t<trials ; t++ )
+				{
+					if     ( m==SIMPLE_HULL      ) hulls[m][t] = ConvexHull::SimpleHull( pointSets[t] , simpleHullScratch );
+					else if( m==INCREMENTAL_HULL ) hulls[m][t] = ConvexHull::IncrementalHull( pointSets[t] , incrementalHullScratch );
+					else                           hulls[m][t] = ConvexHull::QHull( pointSets[t] );
+				}
+				nsPerHull[m] = ( timer() * 1e9 ) / trials;
+			}
+
+			// Cross-check against qhull, comparing the facets for points in general position and the hull vertices otherwise
+			unsigned int mismatches[METHOD_COUNT];
+			for( unsigned int m=0 ; m<METHOD_COUNT ; m++ )
+			{
+				mismatches[m] = 0;
+				if( m==Q_HULL || nsPerHull[m]<0 ) continue;
+				for( unsigned int t=0 ; t<trials ; t++ )
+					if( dist==DEGENERATE ){ if( HullVertices< Dim >( hulls[m][t] )!=HullVertices< Dim >( hulls[Q_HULL][t] ) ) mismatches[m]++; }
+					else                  { if( CanonicalFacets< Dim >( hulls[m][t] )!=CanonicalFacets< Dim >( hulls[Q_HULL][t] ) ) mismatches[m]++; }
+			}
+
+			for( unsigned int m=0 ; m<METHOD_COUNT ; m++ ) if( nsPerHull[m]>=0 )
+			{
+				timings[ Key( Dim , DistributionNames[dist] , n , MethodNames[m] ) ] = std::pair< double , unsigned int >( nsPerHull[m] , mismatches[m] );
+				if( Verbose.set ) std::cout << "\t" << Dim << " " << DistributionNames[dist] << " " << n << " " << MethodNames[m] << ": " << nsPerHull[m] << " (ns) " << mismatches[m] << " / " << trials << std::endl;
+			}
+
+			if( crossover==(unsigned int)-1 && nsPerHull[INCREMENTAL_HULL]>=0 && nsPerHull[Q_HULL]<nsPerHull[INCREMENTAL_HULL] ) crossover = n;
+		}
+		if( crossover==(unsigned int)-1 ) std::cout << "Dim " << Dim << " , " << DistributionNames[dist] << ": incremental hull faster for all benchmarked sizes" << std::endl;
+		else                std::cout << "Dim " << Dim << " , " << DistributionNames[dist] << ": qhull faster from " << crossover << " points" << std::endl;
+	}
+}
+
+int main( int argc , char* argv[] )
+{
+	Misha::CmdLineParse( argc-1 , argv+1 , params );
+	// [NOTE] Since all the parameters are optional, the benchmark runs only if some argument is given, with --run running it with the default settings
+	if( argc<2 )
+	{
+		ShowUsage( argv[0] );
+		return EXIT_SUCCESS;
+	}
+
+	std::mt19937 generator( Seed.value );
+	std::map< Key , std::pair< double , unsigned int > > timings;
+
+	Benchmark< 2 >( generator , timings );
+	Benchmark< 3 >( generator , timings );
+	Benchmark< 4 >( generator , timings );
+	Benchmark< 5 >( generator , timings );
+
+	if( Out.set ) Timings::Write( Out.value , "dim,distribution,points,method,ns_per_hull,mismatches" , timings , []( std::pair< double , unsigned int > t ){ return std::make_tuple( t.first , t.second ); } );
+
+	// Mismatches are failures for points in general position
+	// [NOTE] The incremental hull assumes general position so mismatches for degenerate input are only reported
+	bool success = true;
+	for( auto iter=timings.begin() ; iter!=timings.end() ; iter++ ) if( iter->second.second )
+	{
+		if( std::get<1>( iter->first )==DistributionNames[DEGENERATE] )
+			WARN( "Hull-vertex mismatch: " , Timings::ToString( iter->first ) , ": " , iter->second.second );
+		else
+		{
+			std::cerr << "[FAILURE] Facet mismatch: " << Timings::ToString( iter->first ) << ": " << iter->second.second << std::endl;
+			success = false;
+		}
+	}
+
+	if( Baseline.set && !Timings::CheckBaseline( Baseline.value , timings , Slack.value , []( std::pair< double , unsigned int > t ){ return t.first; } ) ) success = false;
+
+	return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
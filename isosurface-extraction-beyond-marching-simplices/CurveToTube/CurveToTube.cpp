@@ -3,12 +3,14 @@
 #include "Misha/CmdLineParser.h"
 #include "Misha/Ply.h"
 #include "Misha/PlyVertexData.h"
+#include "Include/CurveTube.h"
 
 static const unsigned int Dim = 2;
 
-Misha::CmdLineParameter< std::string > In( "in" ) , Out( "out" );
-Misha::CmdLineParameter< unsigned int > AngularResolution( "res" , 8 );
-Misha::CmdLineParameter< double > TubularRadius( "radius" , 0. );
+Misha::CmdLineParameter< std::string > In( "in" ) , Out( "out" ) , Stats( "stats" ) , Trace( "trace" );
+Misha::CmdLineParameter< unsigned int > AngularResolution( "res" , 8 ) , MinAngularResolution( "minRes" , 3 ) , ScreenSize( "screen" , 0 );
+Misha::CmdLineParameter< double > TubularRadius( "radius" , 0. ) , Tolerance( "tolerance" , 0. );
+Misha::CmdLineReadable ASCII( "ascii" ) , Verbose( "verbose" ) , Performance( "performance" );
 
 Misha::CmdLineReadable* params[] =
 {
@@ -16,6 +18,14 @@ Misha::CmdLineReadable* params[] =
 	&Out ,
 	&AngularResolution ,
 	&TubularRadius ,
+	&Tolerance ,
+	&MinAngularResolution ,
+	&ScreenSize ,
+	&ASCII ,
+	&Verbose ,
+	&Performance ,
+	&Stats ,
+	&Trace ,
 	NULL
 };
 
@@ -24,8 +34,16 @@ void ShowUsage( const char* ex )
 	std::cout << "Usage " << std::string( ex ) << ":" << std::endl;
 	std::cout << "\t --" << In.name << " <input curve>" << std::endl;
 	std::cout << "\t[--" << Out.name << " <output mesh>]" << std::endl;
-	std::cout << "\t[--" << AngularResolution.name << " <angular resolution>=" << AngularResolution.value << "]" << std::endl;
+	std::cout << "\t[--" << AngularResolution.name << " <(maximum) angular resolution>=" << AngularResolution.value << "]" << std::endl;
 	std::cout << "\t[--" << TubularRadius.name << " <tubular radius>=" << TubularRadius.value << "]" << std::endl;
+	std::cout << "\t[--" << Tolerance.name << " <adaptive angular resolution tolerance (world units, or pixels if the screen size is given)>]" << std::endl;
+	std::cout << "\t[--" << MinAngularResolution.name << " <minimum adaptive angular resolution>=" << MinAngularResolution.value << "]" << std::endl;
+	std::cout << "\t[--" << ScreenSize.name << " <screen size of the curve's bounding box diagonal (pixels)>]" << std::endl;
+	std::cout << "\t[--" << ASCII.name << "]" << std::endl;
+	std::cout << "\t[--" << Performance.name << "]" << std::endl;
+	std::cout << "\t[--" << Verbose.name << "]" << std::endl;
+	std::cout << "\t[--" << Stats.name << " <output statistics (JSON)>]" << std::endl;
+	std::cout << "\t[--" << Trace.name << " <output trace (Chrome trace-event JSON)>]" << std::endl;
 }
 
 template< unsigned int Dimension >
@@ -41,71 +59,67 @@ int main( int argc , char *argv[] )
 		return EXIT_SUCCESS;
 	}
 	if( AngularResolution.value<3 ) ERROR_OUT( "Angular resolution must be at least three: " , AngularResolution.value );
+	if( Tolerance.value<0 ) ERROR_OUT( "Tolerance must be non-negative: " , Tolerance.value );
+	if( Stats.set || Trace.set ) Instrumentation::Enable();
 
 	// The input/output vertices
 	std::vector< Factory< Dim >::VertexType > curveVertices;
 	std::vector< Factory< Dim+1 >::VertexType > tubeVertices;
-	// The input edges and output quads
+	// The input edges and output triangles
 	std::vector< SimplexIndex< Dim-1 > > curveEdges;
-	std::vector< std::vector< unsigned int > > tubeQuads;
+	std::vector< SimplexIndex< Dim > > tubeTriangles;
+
+	Miscellany::Timer timer , subTimer;
 
 	{
+		Instrumentation::Scope scope( "read" );
 		Factory< Dim > vFactory;
 		int file_type;
 		PLY::ReadSimplices( In.value , vFactory , curveVertices , curveEdges , NULL , file_type );
 	}
 	std::cout << "Input vertices/edges: " << curveVertices.size() << " / " << curveEdges.size() << std::endl;
 
+	subTimer.reset();
+	if( Tolerance.set )
 	{
-		std::vector< Point< double , Dim > > normals( curveVertices.size() );
-		for( unsigned int i=0 ; i<curveEdges.size() ; i++ )
+		// When the screen size is given, the tolerance is in pixels and is converted to world units using the size of the bounding box
+		double tolerance = Tolerance.value;
+		if( ScreenSize.set && curveVertices.size() )
 		{
-			Point< double , Dim > dir = curveVertices[ curveEdges[i][1] ] - curveVertices[ curveEdges[i][0] ];
-
-			Point< double , Dim > n = Point< double , Dim >::CrossProduct( dir );
-			normals[ curveEdges[i][0] ] += n;
-			normals[ curveEdges[i][1] ] += n;
+			Point< double , Dim > min = curveVertices[0] , max = curveVertices[0];
+			for( unsigned int i=0 ; i<curveVertices.size() ; i++ ) for( unsigned int d=0 ; d<Dim ; d++ )
+				min[d] = std::min< double >( min[d] , curveVertices[i][d] ) , max[d] = std::max< double >( max[d] , curveVertices[i][d] );
+			if( !ScreenSize.value ) ERROR_OUT( "Screen size must be positive" );
+			tolerance *= sqrt( ( max - min ).squareNorm() ) / ScreenSize.value;
 		}
-		for( unsigned int i=0 ; i<normals.size() ; i++ ) normals[i] /= sqrt( normals[i].squareNorm() );
-
-		std::vector< unsigned int > quad( 4 );
-
-		tubeVertices.resize( curveVertices.size() * AngularResolution.value );
-		for( unsigned int i=0 ; i<curveVertices.size() ; i++ )
+		std::vector< unsigned int > angularResolutions;
 		{
-			Point< double , 3 > v( curveVertices[i][0] , curveVertices[i][1] , 0 );
-			Point< double , 3 > n1(0,0,1);
-			Point< double , 3 > n2( normals[i][0] , normals[i][1] , 0 );
-			for( unsigned int j=0 ; j<AngularResolution.value ; j++ )
-			{
-				double theta = ( 2. * M_PI * j ) / AngularResolution.value;
-				tubeVertices[ i*AngularResolution.value + j ] = v + n1 * sin( theta ) * TubularRadius.value + n2 * cos( theta ) * TubularRadius.value;
-			}
+			Instrumentation::Scope scope( "angular resolutions" );
+			angularResolutions = CurveTube::AngularResolutions( curveVertices , curveEdges , TubularRadius.value , tolerance , MinAngularResolution.value , AngularResolution.value );
 		}
-
-		for( unsigned int i=0 ; i<curveEdges.size() ; i++ )
+		if( Verbose.set )
 		{
-			unsigned int i1 = curveEdges[i][0] , i2 = curveEdges[i][1];
-
-			for( unsigned int j=0 ; j<AngularResolution.value ; j++ )
-			{
-				quad[0] = i1 * AngularResolution.value + ( ( j + 0 ) % AngularResolution.value );
-				quad[1] = i2 * AngularResolution.value + ( ( j + 0 ) % AngularResolution.value );
-				quad[2] = i2 * AngularResolution.value + ( ( j + 1 ) % AngularResolution.value );
-				quad[3] = i1 * AngularResolution.value + ( ( j + 1 ) % AngularResolution.value );
-
-				tubeQuads.push_back( quad );
-			}
+			size_t count = 0;
+			for( unsigned int i=0 ; i<angularResolutions.size() ; i++ ) count += angularResolutions[i];
+			std::cout << "Average angular resolution: " << ( angularResolutions.size() ? (double)count / angularResolutions.size() : 0. ) << std::endl;
 		}
+		CurveTube::Generate( curveVertices , curveEdges , angularResolutions , TubularRadius.value , tubeVertices , tubeTriangles );
 	}
+	else CurveTube::Generate( curveVertices , curveEdges , AngularResolution.value , TubularRadius.value , tubeVertices , tubeTriangles );
+	if( Verbose.set ) std::cout << "Got tube: " << subTimer() << std::endl;
 
-	std::cout << "Output vertices/quads: " << tubeVertices.size() << " / " << tubeQuads.size() << std::endl;
+	std::cout << "Output vertices/triangles: " << tubeVertices.size() << " / " << tubeTriangles.size() << std::endl;
 
 	if( Out.set )
 	{
+		Instrumentation::Scope scope( "write" );
 		Factory< Dim+1 > vertexFactory;
-		PLY::WritePolygons( Out.value , vertexFactory , tubeVertices , tubeQuads , PLY_ASCII );
+		PLY::WriteSimplices( Out.value , vertexFactory , tubeVertices , tubeTriangles , ASCII.set ? PLY_ASCII : PLY_BINARY_NATIVE );
 	}
 
+	if( Performance.set ) std::cout << "Performance: " << timer() << ", " << Miscellany::MemoryInfo::PeakMemoryUsageMB() << " (MB)" << std::endl;
+	if( Stats.set ) Instrumentation::WriteStats( Stats.value , "CurveToTube" );
+	if( Trace.set ) Instrumentation::WriteTrace( Trace.value , "CurveToTube" );
+
 	return EXIT_SUCCESS;
 }
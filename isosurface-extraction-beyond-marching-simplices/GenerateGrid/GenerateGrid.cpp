@@ -0,0 +1,165 @@
+#include <iostream>
+#include "Misha/Miscellany.h"
+#include "Misha/CmdLineParser.h"
+#include "Misha/RegularGrid.h"
+#include "Include/GridGenerator.h"
+#include "Include/TiledGrid.h"
+#include "Include/QuantizedGrid.h"
+
+Misha::CmdLineParameter< std::string > Out( "out" ) , Field( "field" , GridGenerator::FieldNames[ GridGenerator::NOISE ] ) , Type( "type" , "double" );
+Misha::CmdLineParameter< unsigned int > Dimension( "dim" , 2 ) , Resolution( "res" , 257 ) , Channels( "channels" , 1 ) , Seed( "seed" , 0 ) , Frequency( "frequency" , 8 ) , Octaves( "octaves" , 4 ) , Count( "count" , 16 ) , Levels( "levels" , 0 ) , Quantize( "quantize" , 0 ) , TileSize( "tile" , TiledGrid::DefaultTileSize );
+Misha::CmdLineParameter< double > Softness( "softness" , 0. ) , Scale( "scale" , 1024. );
+Misha::CmdLineReadable Verbose( "verbose" ) , Performance( "performance" );
+
+Misha::CmdLineReadable* params[] =
+{
+	&Out ,
+	&Field ,
+	&Type ,
+	&Dimension ,
+	&Resolution ,
+	&Channels ,
+	&Seed ,
+	&Frequency ,
+	&Octaves ,
+	&Count ,
+	&Softness ,
+	&Levels ,
+	&Scale ,
+	&Quantize ,
+	&TileSize ,
+	&Verbose ,
+	&Performance ,
+	NULL
+};
+
+void ShowUsage( const char* ex )
+{
+	std::cout << "Usage " << std::string( ex ) << ":" << std::endl;
+	std::cout << "\t --" << Out.name << " <output grid>" << std::endl;
+	std::cout << "\t[--" << Field.name << " <field: noise, sdf, or voronoi>=" << Field.value << "]" << std::endl;
+	std::cout << "\t[--" << Type.name << " <value type: double, float, int, or unsigned int>=" << Type.value << "]" << std::endl;
+	std::cout << "\t[--" << Dimension.name << " <grid dimension (1, 2, or 3)>=" << Dimension.value << "]" << std::endl;
+	std::cout << "\t[--" << Resolution.name << " <samples along each dimension>=" << Resolution.value << "]" << std::endl;
+	std::cout << "\t[--" << Channels.name << " <values per sample (labels, for Voronoi fields)>=" << Channels.value << "]" << std::endl;
+	std::cout << "\t[--" << Seed.name << " <random seed>=" << Seed.value << "]" << std::endl;
+	std::cout << "\t[--" << Frequency.name << " <noise lattice cells along each dimension>=" << Frequency.value << "]" << std::endl;
+	std::cout << "\t[--" << Octaves.name << " <noise octaves>=" << Octaves.value << "]" << std::endl;
+	std::cout << "\t[--" << Count.name << " <primitives (sdf) or sites per label (voronoi)>=" << Count.value << "]" << std::endl;
+	std::cout << "\t[--" << Softness.name << " <Voronoi distance blending width>=" << Softness.value << "]" << std::endl;
+	std::cout << "\t[--" << Levels.name << " <snap values to multiples of 1/levels>]" << std::endl;
+	std::cout << "\t[--" << Scale.name << " <scale applied before rounding to integer types>=" << Scale.value << "]" << std::endl;
+	std::cout << "\t[--" << Quantize.name << " <output bits per value (8 or 16)>]" << std::endl;
+	std::cout << "\t[--" << TileSize.name << " <output tile size>=" << TileSize.value << "]" << std::endl;
+	std::cout << "\t[--" << Performance.name << "]" << std::endl;
+	std::cout << "\t[--" << Verbose.name << "]" << std::endl;
+}
+
+template< unsigned int Dim , typename Data >
+void Write( const GridGenerator::Description &description )
+{
+	using Traits = TiledGrid::_DataTraits< Data >;
+	RegularGrid< Dim , Data > grid;
+	XForm< double , Dim+1 > gridToWorld;
+	{
+		Miscellany::Timer timer;
+		GridGenerator::Generate( description , grid , gridToWorld , Scale.value );
+		if( Verbose.set ) std::cout << "Generated grid: " << timer() << std::endl;
+	}
+
+	Miscellany::Timer timer;
+	if constexpr( std::is_same_v< typename Traits::Real , double > ) if( Quantize.value )
+	{
+		auto QuantizeAndWrite = [&]< typename Quantized >( void )
+			{
+				using QuantizedData = std::conditional_t< Traits::Channels==1 , Quantized , Point< Quantized , Traits::Channels > >;
+				RegularGrid< Dim , QuantizedData > _grid;
+				double scale , offset;
+				QuantizedGrid::Quantize( grid , _grid , scale , offset );
+				QuantizedGrid::Write( Out.value , _grid , gridToWorld , scale , offset );
+			};
+		if( TileSize.set ) WARN( "Quantized grids are not tiled" );
+		if     ( Quantize.value== 8 ) QuantizeAndWrite.template operator()< unsigned char  >();
+		else if( Quantize.value==16 ) QuantizeAndWrite.template operator()< unsigned short >();
+		else ERROR_OUT( "Only 8 and 16 bit quantization supported: " , Quantize.value );
+		if( Verbose.set ) std::cout << "Wrote grid: " << timer() << std::endl;
+		return;
+	}
+	if( TileSize.set ) TiledGrid::Write( Out.value , grid , gridToWorld , TileSize.value );
+	else grid.write( Out.value , gridToWorld );
+	if( Verbose.set ) std::cout << "Wrote grid: " << timer() << std::endl;
+}
+
+template< unsigned int Dim , typename Real >
+void Execute( const GridGenerator::Description &description )
+{
+	switch( description.channels )
+	{
+	case  1: Write< Dim , Real >( description ) ; break;
+	case  2: Write< Dim , Point< Real ,  2 > >( description ) ; break;
+	case  3: Write< Dim , Point< Real ,  3 > >( description ) ; break;
+	case  4: Write< Dim , Point< Real ,  4 > >( description ) ; break;
+	case  5: Write< Dim , Point< Real ,  5 > >( description ) ; break;
+	case  6: Write< Dim , Point< Real ,  6 > >( description ) ; break;
+	case  7: Write< Dim , Point< Real ,  7 > >( description ) ; break;
+	case  8: Write< Dim , Point< Real ,  8 > >( description ) ; break;
+	case  9: Write< Dim , Point< Real ,  9 > >( description ) ; break;
+	case 10: Write< Dim , Point< Real , 10 > >( description ) ; break;
+	default: ERROR_OUT( "Only channel counts 1..10 are supported: " , description.channels );
+	}
+}
+
+template< unsigned int Dim >
+void Execute( const GridGenerator::Description &description )
+{
+	if( Quantize.value && Type.value!="double" ) WARN( "Quantizing from double-precision values" );
+	if     ( Quantize.value || Type.value=="double" ) Execute< Dim , double >( description );
+	else if( Type.value=="float"        ) Execute< Dim , float >( description );
+	else if( Type.value=="int"          ) Execute< Dim , int >( description );
+	else if( Type.value=="unsigned int" ) Execute< Dim , unsigned int >( description );
+	else ERROR_OUT( "Unrecognized value type: " , Type.value );
+}
+
+int main( int argc , char *argv[] )
+{
+	Misha::CmdLineParse( argc-1 , argv+1 , params );
+	if( !Out.set )
+	{
+		ShowUsage( argv[0] );
+		return EXIT_SUCCESS;
+	}
+
+	Miscellany::Timer timer;
+
+	GridGenerator::Description description;
+	{
+		unsigned int f = 0;
+		while( f<GridGenerator::FIELD_COUNT && GridGenerator::FieldNames[f]!=Field.value ) f++;
+		if( f==GridGenerator::FIELD_COUNT ) ERROR_OUT( "Unrecognized field: " , Field.value );
+		description.field = (GridGenerator::Field)f;
+	}
+	description.dim = Dimension.value;
+	description.res = Resolution.value;
+	description.channels = Channels.value;
+	description.seed = Seed.value;
+	description.frequency = Frequency.value;
+	description.octaves = Octaves.value;
+	description.count = Count.value;
+	description.softness = Softness.value;
+	description.levels = Levels.value;
+
+	// The description can also be passed to the other tools in place of the name of the input grid, generating the grid in memory
+	if( Verbose.set ) std::cout << "Description: " << description.toString() << std::endl;
+
+	switch( description.dim )
+	{
+		case 1: Execute< 1 >( description ) ; break;
+		case 2: Execute< 2 >( description ) ; break;
+		case 3: Execute< 3 >( description ) ; break;
+		default: ERROR_OUT( "Only dimensions 1, 2, and 3 supported: " , description.dim );
+	}
+
+	if( Performance.set ) std::cout << "Performance: " << timer() << ", " << Miscellany::MemoryInfo::PeakMemoryUsageMB() << " (MB)" << std::endl;
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,182 @@
+#ifndef BATCH_INCLUDED
+#define BATCH_INCLUDED
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <map>
+#include <memory>
+#include <typeindex>
+#include <exception>
+#include <omp.h>
+#include "Misha/Miscellany.h"
+#include "GridGenerator.h"
+
+// Functionality for processing the jobs listed in a manifest within a single process, so that the cost of starting the process,
+// parsing the command line, and dispatching on the grid type is paid once rather than per grid.
+// The manifest has one job per line:
+//		<input grid> [<output> [<iso-value>]]
+// with "-" standing for no output. Blank lines and lines starting with '#' are ignored.
+// [NOTE] File names cannot contain white-space
+namespace Batch
+{
+	//////////////////
+	// Declarations //
+	//////////////////
+
+	struct Job
+	{
+		std::string in , out;
+		// Whether the job prescribes an iso-value, and the iso-value
+		bool hasIsoValue = false;
+		double isoValue = 0;
+	};
+
+	struct Report
+	{
+		bool success = false;
+		std::string message;
+		double seconds = 0;
+		// The index of the thread that processed the job
+		unsigned int thread = 0;
+		// The size of the output geometry
+		size_t vertices = 0 , simplices = 0;
+	};
+
+	// The buffers of a thread, one per workspace type, constructed when a job first needs them and re-used by the later jobs of the thread
+	// [NOTE] This allows a thread to process jobs whose grids have different types, re-using the buffers of earlier jobs with the same type
+	struct Workspaces
+	{
+		template< typename Workspace >
+		Workspace &get( void );
+
+	protected:
+		std::map< std::type_index , std::shared_ptr< void > > _workspaces;
+	};
+
+	// Reads the jobs from the manifest
+	inline std::vector< Job > ReadManifest( std::string fileName );
+
+	// Processes the jobs on a pool of threads, each job by a single thread, and returns the per-job reports
+	// The functor takes the job, the index of the thread processing it (in the range [0,omp_get_max_threads())), and the report, in which it sets the size of the output
+	// [NOTE] Since nested parallelism is disabled by default, the parallel regions within a job are executed by the thread processing it
+	// [NOTE] Jobs whose input cannot be opened, or whose processing throws, are reported as failures and the remaining jobs are still processed
+	// [NOTE] Failures must be reported by throwing (e.g. using THROW), since ERROR_OUT ends the process
+	template< typename JobFunctor /* = std::function< void ( const Job & , unsigned int , Report & ) > */ >
+	std::vector< Report > Process( const std::vector< Job > &jobs , JobFunctor jobFunctor );
+
+	// Prints the numbers of jobs that succeeded and failed (and, if verbose, the reasons for the failures) and returns the number of failures
+	inline size_t Summarize( const std::vector< Job > &jobs , const std::vector< Report > &reports , bool verbose );
+
+	// Writes the per-job reports in CSV format
+	inline void WriteReport( std::string fileName , const std::vector< Job > &jobs , const std::vector< Report > &reports );
+
+	/////////////////
+	// Definitions //
+	/////////////////
+
+	template< typename Workspace >
+	Workspace &Workspaces::get( void )
+	{
+		std::shared_ptr< void > &workspace = _workspaces[ std::type_index( typeid( Workspace ) ) ];
+		if( !workspace ) workspace = std::make_shared< Workspace >();
+		return *std::static_pointer_cast< Workspace >( workspace );
+	}
+
+	inline std::vector< Job > ReadManifest( std::string fileName )
+	{
+		std::ifstream stream( fileName );
+		if( !stream.is_open() ) ERROR_OUT( "Could not open manifest for reading: " , fileName );
+
+		std::vector< Job > jobs;
+		std::string line;
+		unsigned int lineNum = 0;
+		while( std::getline( stream , line ) )
+		{
+			lineNum++;
+			std::stringstream ss( line );
+			std::string in , out , isoValue;
+			if( !( ss >> in ) || in[0]=='#' ) continue;
+
+			Job job;
+			job.in = in;
+			if( ss >> out && out!="-" ) job.out = out;
+			if( ss >> isoValue )
+			{
+				try{ job.isoValue = std::stod( isoValue ); }
+				catch( ... ){ ERROR_OUT( "Could not parse iso-value on line " , lineNum , ": " , isoValue ); }
+				job.hasIsoValue = true;
+			}
+			jobs.push_back( job );
+		}
+		return jobs;
+	}
+
+	template< typename JobFunctor >
+	std::vector< Report > Process( const std::vector< Job > &jobs , JobFunctor jobFunctor )
+	{
+		std::vector< Report > reports( jobs.size() );
+#pragma omp parallel for schedule( dynamic )
+		for( long long j=0 ; j<(long long)jobs.size() ; j++ )
+		{
+			Report &report = reports[j];
+			report.thread = omp_get_thread_num();
+			Miscellany::Timer timer;
+
+			bool exists = GridGenerator::IsProcedural( jobs[j].in );
+			if( !exists )
+			{
+				FILE *fp = fopen( jobs[j].in.c_str() , "rb" );
+				if( fp ) exists = true , fclose( fp );
+			}
+			if( !exists ) report.message = "could not open input";
+			else
+			{
+				try
+				{
+					jobFunctor( jobs[j] , report.thread , report );
+					report.success = true;
+				}
+				catch( const std::exception &e ){ report.message = e.what(); }
+			}
+			report.seconds = timer();
+		}
+		return reports;
+	}
+
+	inline size_t Summarize( const std::vector< Job > &jobs , const std::vector< Report > &reports , bool verbose )
+	{
+		size_t failures = 0;
+		for( size_t j=0 ; j<reports.size() ; j++ ) if( !reports[j].success )
+		{
+			failures++;
+			if( verbose ) std::cerr << "[FAILURE] " << jobs[j].in << ": " << reports[j].message << std::endl;
+		}
+		std::cout << "Jobs succeeded/failed: " << reports.size()-failures << " / " << failures << std::endl;
+		return failures;
+	}
+
+	// Returns the string as a CSV field, quoted if necessary
+	inline std::string _CSV( std::string str )
+	{
+		if( str.find_first_of( ",\"\n" )==std::string::npos ) return str;
+		std::string _str = "\"";
+		for( size_t i=0 ; i<str.size() ; i++ ) _str += str[i]=='"' ? std::string( "\"\"" ) : std::string( 1 , str[i] );
+		return _str + "\"";
+	}
+
+	inline void WriteReport( std::string fileName , const std::vector< Job > &jobs , const std::vector< Report > &reports )
+	{
+		FILE *fp = fopen( fileName.c_str() , "w" );
+		if( !fp ) ERROR_OUT( "Could not open file for writing: " , fileName );
+		fprintf( fp , "job,input,output,status,seconds,thread,vertices,simplices,message\n" );
+		for( size_t j=0 ; j<jobs.size() ; j++ )
+			fprintf( fp , "%zu,%s,%s,%s,%g,%u,%zu,%zu,%s\n" , j , _CSV( jobs[j].in ).c_str() , _CSV( jobs[j].out ).c_str() , reports[j].success ? "ok" : "failed" , reports[j].seconds , reports[j].thread , reports[j].vertices , reports[j].simplices , _CSV( reports[j].message ).c_str() );
+		fclose( fp );
+	}
+}
+
+#endif // BATCH_INCLUDED
@@ -0,0 +1,212 @@
+#ifndef BLOCKED_GRID_INCLUDED
+#define BLOCKED_GRID_INCLUDED
+
+#include <vector>
+#include <algorithm>
+#include "Misha/RegularGrid.h"
+
+// Functionality for traversing and storing grids block by block, so that samples that are close in the grid are close in memory.
+// A RegularGrid stores its samples with the first dimension varying fastest, while Range::process visits the indices with the last dimension varying fastest,
+// so consecutive indices visited are a full row (or slab) apart in memory. Instead:
+//		the traversal visits the blocks covering a range in Morton order, and the indices within a block with the first dimension varying fastest, and
+//		the blocked grid stores the samples of each block contiguously (with the first dimension varying fastest), and the blocks in Morton order.
+// [NOTE] The block size is a power of two, and the blocks on the boundary are padded so that all blocks have the same size
+namespace BlockedGrid
+{
+	//////////////////
+	// Declarations //
+	//////////////////
+
+	static const unsigned int DefaultBlockSize = 16;
+
+	// Returns the Morton code of the index, interleaving the bits of the coordinates with those of the first coordinate least significant
+	template< unsigned int Dim >
+	unsigned long long MortonCode( const unsigned int I[Dim] );
+
+	// Returns the ranges of the blocks covering the range, in Morton order
+	template< unsigned int Dim >
+	std::vector< typename RegularGrid< Dim >::Range > Blocks( const typename RegularGrid< Dim >::Range &range , unsigned int blockSize );
+
+	// Visits the indices of the range, with the first dimension varying fastest
+	template< unsigned int Dim , typename IndexFunctor /* = std::function< void ( typename RegularGrid< Dim >::Index ) > */ >
+	void ProcessRange( const typename RegularGrid< Dim >::Range &range , IndexFunctor f );
+
+	// Visits the indices of the range block by block
+	template< unsigned int Dim , typename IndexFunctor /* = std::function< void ( typename RegularGrid< Dim >::Index ) > */ >
+	void Process( const typename RegularGrid< Dim >::Range &range , unsigned int blockSize , IndexFunctor f );
+
+	// A grid whose samples are stored block by block
+	template< unsigned int Dim , typename Data >
+	struct Grid
+	{
+		Grid( void ) : _blockSize(0) , _log(0) { for( unsigned int d=0 ; d<Dim ; d++ ) _res[d] = _blockRes[d] = 0; }
+
+		// Resizes the grid, with blocks of the prescribed size
+		void resize( const unsigned int res[Dim] , unsigned int blockSize=DefaultBlockSize );
+
+		unsigned int res( unsigned int d ) const { return _res[d]; }
+		const unsigned int *res( void ) const { return _res; }
+		// The number of samples (excluding padding)
+		size_t resolution( void ) const;
+		unsigned int blockSize( void ) const { return _blockSize; }
+
+		// Returns the position of the sample in storage
+		size_t index( typename RegularGrid< Dim >::Index I ) const;
+
+		      Data &operator()( typename RegularGrid< Dim >::Index I )       { return _values[ index(I) ]; }
+		const Data &operator()( typename RegularGrid< Dim >::Index I ) const { return _values[ index(I) ]; }
+
+		// Returns the ranges of the blocks (clipped to the grid), in storage order
+		std::vector< typename RegularGrid< Dim >::Range > blocks( void ) const;
+
+		// Copies the samples from/to a regular grid, resizing the destination
+		void set( const RegularGrid< Dim , Data > &grid , unsigned int blockSize=DefaultBlockSize );
+		void get( RegularGrid< Dim , Data > &grid ) const;
+
+	protected:
+		unsigned int _res[Dim] , _blockRes[Dim] , _blockSize , _log;
+		// The storage offsets of the blocks, indexed with the first dimension varying fastest
+		std::vector< size_t > _blockOffsets;
+		std::vector< Data > _values;
+	};
+
+	/////////////////
+	// Definitions //
+	/////////////////
+
+	template< unsigned int Dim >
+	unsigned long long MortonCode( const unsigned int I[Dim] )
+	{
+		unsigned long long code = 0;
+		for( unsigned int b=0 ; b<64/Dim ; b++ ) for( unsigned int d=0 ; d<Dim ; d++ ) code |= ( ( (unsigned long long)I[d]>>b ) & 1 ) << ( b*Dim + d );
+		return code;
+	}
+
+	template< unsigned int Dim >
+	std::vector< typename RegularGrid< Dim >::Range > Blocks( const typename RegularGrid< Dim >::Range &range , unsigned int blockSize )
+	{
+		if( !blockSize ) ERROR_OUT( "Block size must be positive" );
+		typename RegularGrid< Dim >::Range blockRange;
+		for( unsigned int d=0 ; d<Dim ; d++ ) blockRange.first[d] = 0 , blockRange.second[d] = range.empty() ? 0 : ( range.second[d] - range.first[d] + blockSize - 1 ) / blockSize;
+
+		std::vector< std::pair< unsigned long long , typename RegularGrid< Dim >::Range > > blocks;
+		blocks.reserve( blockRange.size() );
+		blockRange.process( [&]( typename RegularGrid< Dim >::Index B )
+			{
+				unsigned int _B[Dim];
+				typename RegularGrid< Dim >::Range r;
+				for( unsigned int d=0 ; d<Dim ; d++ )
+				{
+					_B[d] = B[d];
+					r.first[d] = range.first[d] + B[d] * blockSize , r.second[d] = std::min< int >( r.first[d] + blockSize , range.second[d] );
+				}
+				blocks.push_back( std::make_pair( MortonCode< Dim >( _B ) , r ) );
+			} );
+		std::sort( blocks.begin() , blocks.end() , []( const auto &b1 , const auto &b2 ){ return b1.first<b2.first; } );
+
+		std::vector< typename RegularGrid< Dim >::Range > _blocks( blocks.size() );
+		for( size_t i=0 ; i<blocks.size() ; i++ ) _blocks[i] = blocks[i].second;
+		return _blocks;
+	}
+
+	template< unsigned int Dim , typename IndexFunctor >
+	void ProcessRange( const typename RegularGrid< Dim >::Range &range , IndexFunctor f )
+	{
+		if( range.empty() ) return;
+		typename RegularGrid< Dim >::Index I = range.first;
+		while( true )
+		{
+			f( I );
+			unsigned int d=0;
+			for( ; d<Dim ; d++ )
+				if( ++I[d]<range.second[d] ) break;
+				else I[d] = range.first[d];
+			if( d==Dim ) break;
+		}
+	}
+
+	template< unsigned int Dim , typename IndexFunctor >
+	void Process( const typename RegularGrid< Dim >::Range &range , unsigned int blockSize , IndexFunctor f )
+	{
+		std::vector< typename RegularGrid< Dim >::Range > blocks = Blocks< Dim >( range , blockSize );
+		for( size_t b=0 ; b<blocks.size() ; b++ ) ProcessRange< Dim >( blocks[b] , f );
+	}
+
+	template< unsigned int Dim , typename Data >
+	void Grid< Dim , Data >::resize( const unsigned int res[Dim] , unsigned int blockSize )
+	{
+		if( !blockSize || ( blockSize & ( blockSize-1 ) ) ) ERROR_OUT( "Block size must be a power of two: " , blockSize );
+		_blockSize = blockSize;
+		for( _log=0 ; (1u<<_log)<blockSize ; _log++ );
+
+		typename RegularGrid< Dim >::Range range;
+		size_t blockCount = 1;
+		for( unsigned int d=0 ; d<Dim ; d++ )
+		{
+			_res[d] = res[d] , _blockRes[d] = ( res[d] + blockSize - 1 ) / blockSize;
+			range.first[d] = 0 , range.second[d] = _blockRes[d] * blockSize;
+			blockCount *= _blockRes[d];
+		}
+
+		// Assign the storage offsets in Morton order
+		std::vector< typename RegularGrid< Dim >::Range > blocks = Blocks< Dim >( range , blockSize );
+		size_t blockVolume = (size_t)1 << ( _log * Dim );
+		_blockOffsets.resize( blockCount );
+		for( size_t b=0 ; b<blocks.size() ; b++ )
+		{
+			size_t idx = 0;
+			for( int d=Dim-1 ; d>=0 ; d-- ) idx = idx * _blockRes[d] + ( blocks[b].first[d] >> _log );
+			_blockOffsets[idx] = b * blockVolume;
+		}
+		_values.resize( blockCount * blockVolume );
+	}
+
+	template< unsigned int Dim , typename Data >
+	size_t Grid< Dim , Data >::resolution( void ) const
+	{
+		size_t resolution = 1;
+		for( unsigned int d=0 ; d<Dim ; d++ ) resolution *= _res[d];
+		return resolution;
+	}
+
+	template< unsigned int Dim , typename Data >
+	size_t Grid< Dim , Data >::index( typename RegularGrid< Dim >::Index I ) const
+	{
+		const unsigned int mask = _blockSize-1;
+		size_t block = 0 , offset = 0;
+		for( int d=Dim-1 ; d>=0 ; d-- )
+		{
+			block = block * _blockRes[d] + ( (unsigned int)I[d] >> _log );
+			offset = ( offset << _log ) | ( (unsigned int)I[d] & mask );
+		}
+		return _blockOffsets[block] + offset;
+	}
+
+	template< unsigned int Dim , typename Data >
+	std::vector< typename RegularGrid< Dim >::Range > Grid< Dim , Data >::blocks( void ) const
+	{
+		typename RegularGrid< Dim >::Range range;
+		for( unsigned int d=0 ; d<Dim ; d++ ) range.first[d] = 0 , range.second[d] = _res[d];
+		return Blocks< Dim >( range , _blockSize );
+	}
+
+	template< unsigned int Dim , typename Data >
+	void Grid< Dim , Data >::set( const RegularGrid< Dim , Data > &grid , unsigned int blockSize )
+	{
+		resize( grid.res() , blockSize );
+		std::vector< typename RegularGrid< Dim >::Range > _blocks = blocks();
+#pragma omp parallel for schedule( dynamic )
+		for( long long b=0 ; b<(long long)_blocks.size() ; b++ ) ProcessRange< Dim >( _blocks[b] , [&]( typename RegularGrid< Dim >::Index I ){ (*this)(I) = grid(I); } );
+	}
+
+	template< unsigned int Dim , typename Data >
+	void Grid< Dim , Data >::get( RegularGrid< Dim , Data > &grid ) const
+	{
+		grid.resize( _res );
+		std::vector< typename RegularGrid< Dim >::Range > _blocks = blocks();
+#pragma omp parallel for schedule( dynamic )
+		for( long long b=0 ; b<(long long)_blocks.size() ; b++ ) ProcessRange< Dim >( _blocks[b] , [&]( typename RegularGrid< Dim >::Index I ){ grid(I) = (*this)(I); } );
+	}
+}
+
+#endif // BLOCKED_GRID_INCLUDED
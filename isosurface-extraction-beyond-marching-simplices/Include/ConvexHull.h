@@ -20,6 +20,7 @@ extern "C"
 #endif // USE_CPP_QHULL
 #include "Misha/Geometry.h"
 #include "MultiIndex.h"
+#include "Instrumentation.h"
 
 #ifdef USE_CPP_QHULL
 #pragma comment( lib , "qhullcpp.lib" )
@@ -34,8 +35,16 @@ namespace ConvexHull
 	// Declarations //
 	//////////////////
 
+	// The number of hulls computed using each of the methods
+	inline Instrumentation::Counter SimpleHullCount( "simple hulls" ) , IncrementalHullCount( "incremental hulls" ) , QHullCount( "qhull hulls" );
+
 	template< unsigned int Dim > constexpr unsigned int MaxSimpleHullSize( void );
+	// [NOTE] The crossover can be tuned for a machine (see ConvexHullBenchmark) by defining MAX_INCREMENTAL_HULL_SIZE
+#ifdef MAX_INCREMENTAL_HULL_SIZE
+	template< unsigned int Dim > constexpr unsigned int DefaultMaxIncrementalHullSize( void ){ return MAX_INCREMENTAL_HULL_SIZE; }
+#else // !MAX_INCREMENTAL_HULL_SIZE
 	template< unsigned int Dim > constexpr unsigned int DefaultMaxIncrementalHullSize( void ){ if constexpr( Dim<5 ) return 40 ; else return (unsigned int)-1; }
+#endif // MAX_INCREMENTAL_HULL_SIZE
 
 	///////////////////////////////////
 	// These methods are thread-safe //
@@ -43,6 +52,10 @@ namespace ConvexHull
 	template< unsigned int Dim , unsigned int MaxIncrementalHullSize=DefaultMaxIncrementalHullSize< Dim >() > struct      ConvexHullScratch;
 	template< unsigned int Dim >                                                                              struct      SimpleHullScratch;
 	template< unsigned int Dim , unsigned int MaxN=-1 >                                                       struct IncrementalHullScratch;
+#ifdef FAST_SIMPLE_INCREMENTAL
+	// Lanes: The number of independent (equally sized) point sets whose simple hulls are computed together
+	template< unsigned int Dim , unsigned int Lanes=8 >                                                       struct SimpleHullBatch;
+#endif // FAST_SIMPLE_INCREMENTAL
 
 	// MaxIncrementalHullSize: The incremental approach will be used if the number of points is less than MaxIncrementalHullSize
 	template< unsigned int Dim , unsigned int MaxIncrementalHullSize >
@@ -175,6 +188,7 @@ namespace ConvexHull
 	std::vector< SimplexIndex< Dim-1 > > SimpleHull( const std::vector< Point< double , Dim > > &points )
 #endif // FAST_SIMPLE_INCREMENTAL
 	{
+		SimpleHullCount.add();
 		std::vector< SimplexIndex< Dim-1 > > hull;
 		if( points.size()<Dim ) ERROR_OUT( "Insufficient points: " , points.size() , " >= " , Dim );
 		else if( points.size()==Dim )
@@ -231,6 +245,224 @@ namespace ConvexHull
 		return hull;
 	}
 
+#ifdef FAST_SIMPLE_INCREMENTAL
+	// A structure for computing the simple hulls of Lanes point sets (all with Dim+1 or all with Dim+2 points) at once.
+	// The points are stored in structure-of-arrays format so that the orientation tests of the fixed hull topology
+	// are evaluated for all lanes together. The output is, for each lane, the mask of candidate faces on the hull
+	// and the mask of candidate faces whose orientation has to be flipped.
+	template< unsigned int Dim , unsigned int Lanes >
+	struct SimpleHullBatch : public BoundaryIncident< Dim >
+	{
+		static_assert( Dim>=2 , "[ERROR] Dimension must be at least two" );
+		static_assert( Lanes>=1 , "[ERROR] Need at least one lane" );
+
+		// The number of candidate faces:
+		// -- The Dim+1 faces of the simplex spanned by the first Dim+1 points
+		// -- The Dim*(Dim+1)/2 faces joining the boundaries of these faces to the last point
+		static const unsigned int CandidateNum = (Dim+1) + ( Dim*(Dim+1) )/2;
+		static_assert( CandidateNum<=64 , "[ERROR] Too many candidate faces" );
+
+		// The points, with coordinates[p][d][l] the d-th coordinate of the p-th point in the l-th lane
+		double coordinates[Dim+2][Dim][Lanes];
+
+		// The candidate faces when there are Dim+2 points (in the order in which SimpleHull generates them)
+		SimplexIndex< Dim-1 > candidates[ CandidateNum ];
+		// The faces when there are Dim+1 points (in the order in which SimpleHull generates them)
+		SimplexIndex< Dim-1 > simplexFaces[ Dim+1 ];
+
+		// The masks of hull faces and of faces that need to be flipped, for each lane
+		unsigned long long hullMask[Lanes] , flipMask[Lanes];
+
+		SimpleHullBatch( void );
+
+		// Sets the points of the prescribed lane
+		void set( unsigned int lane , const Point< double , Dim > *points , unsigned int pointCount );
+
+		// Computes the hull masks for all lanes, assuming each lane has pointCount points
+		void process( unsigned int pointCount );
+
+		// Returns the hull of the prescribed lane (identical to the output of SimpleHull)
+		void hull( unsigned int lane , unsigned int pointCount , std::vector< SimplexIndex< Dim-1 > > &hull ) const;
+
+	protected:
+		// The sign relating the determinant to the dot-product with the normal returned by Simplex::normal
+		double _sign;
+
+		// Computes the determinant of the Dim x Dim matrices, for all lanes, using cofactor expansion
+		template< unsigned int Row >
+		static void _Determinant( const double m[Dim][Dim][Lanes] , unsigned int usedColumns , double det[Lanes] );
+
+		// Computes the determinant of the matrix whose rows are the face's edge vectors and the offset of x from the face
+		void _orientation( const SimplexIndex< Dim-1 > &face , const double x[Dim][Lanes] , double det[Lanes] ) const;
+	};
+
+	template< unsigned int Dim , unsigned int Lanes >
+	SimpleHullBatch< Dim , Lanes >::SimpleHullBatch( void )
+	{
+		for( unsigned int p=0 ; p<Dim+2 ; p++ ) for( unsigned int d=0 ; d<Dim ; d++ ) for( unsigned int l=0 ; l<Lanes ; l++ ) coordinates[p][d][l] = 0;
+		for( unsigned int l=0 ; l<Lanes ; l++ ) hullMask[l] = flipMask[l] = 0;
+
+		// The faces of the initial simplex
+		for( unsigned int d=0 ; d<=Dim ; d++ ) candidates[d] = SimplexIndex< Dim >::Face( d );
+
+		// The faces joining the boundaries of the faces of the initial simplex to the last point
+		unsigned int idx = Dim+1;
+		for( unsigned int d=0 ; d<=Dim ; d++ ) for( unsigned int dd=0 ; dd<d ; dd++ )
+		{
+			SimplexIndex< Dim-2 > _si = SimplexIndex< Dim >::Face( d , dd );
+			for( unsigned int i=0 ; i<=Dim-2 ; i++ ) candidates[idx][i] = _si[i];
+			candidates[idx++][Dim-1] = Dim+1;
+		}
+
+		idx = 0;
+		SimplexIndex< Dim >::template ProcessFaces< Dim-1 >( [&]( SimplexIndex< Dim-1 > si ){ simplexFaces[idx++] = si; } );
+
+		// Calibrate the sign of the determinant against the normal of the simplex spanned by the origin and the first Dim-1 axes
+		{
+			Simplex< double , Dim , Dim-1 > s;
+			for( unsigned int d=1 ; d<Dim ; d++ ) s[d][d-1] = 1;
+			_sign = s.normal()[Dim-1]>0 ? 1. : -1.;
+		}
+	}
+
+	template< unsigned int Dim , unsigned int Lanes >
+	void SimpleHullBatch< Dim , Lanes >::set( unsigned int lane , const Point< double , Dim > *points , unsigned int pointCount )
+	{
+		if( pointCount>Dim+2 ) ERROR_OUT( "Number of points exceeds number of points supported by simple hull: " , pointCount , " > " , Dim+2 );
+		for( unsigned int p=0 ; p<pointCount ; p++ ) for( unsigned int d=0 ; d<Dim ; d++ ) coordinates[p][d][lane] = points[p][d];
+	}
+
+	template< unsigned int Dim , unsigned int Lanes >
+	template< unsigned int Row >
+	void SimpleHullBatch< Dim , Lanes >::_Determinant( const double m[Dim][Dim][Lanes] , unsigned int usedColumns , double det[Lanes] )
+	{
+		if constexpr( Row==Dim-1 )
+		{
+			unsigned int c = 0;
+			while( usedColumns & (1<<c) ) c++;
+			for( unsigned int l=0 ; l<Lanes ; l++ ) det[l] = m[Row][c][l];
+		}
+		else
+		{
+			double minor[Lanes] , sign = 1.;
+			for( unsigned int l=0 ; l<Lanes ; l++ ) det[l] = 0;
+			for( unsigned int c=0 ; c<Dim ; c++ ) if( !( usedColumns & (1<<c) ) )
+			{
+				_Determinant< Row+1 >( m , usedColumns | (1<<c) , minor );
+#pragma omp simd
+				for( unsigned int l=0 ; l<Lanes ; l++ ) det[l] += sign * m[Row][c][l] * minor[l];
+				sign = -sign;
+			}
+		}
+	}
+
+	template< unsigned int Dim , unsigned int Lanes >
+	void SimpleHullBatch< Dim , Lanes >::_orientation( const SimplexIndex< Dim-1 > &face , const double x[Dim][Lanes] , double det[Lanes] ) const
+	{
+		double m[Dim][Dim][Lanes];
+		const double ( &origin )[Dim][Lanes] = coordinates[ face[0] ];
+		for( unsigned int k=1 ; k<Dim ; k++ ) for( unsigned int d=0 ; d<Dim ; d++ )
+		{
+#pragma omp simd
+			for( unsigned int l=0 ; l<Lanes ; l++ ) m[k-1][d][l] = coordinates[ face[k] ][d][l] - origin[d][l];
+		}
+		for( unsigned int d=0 ; d<Dim ; d++ )
+		{
+#pragma omp simd
+			for( unsigned int l=0 ; l<Lanes ; l++ ) m[Dim-1][d][l] = x[d][l] - origin[d][l];
+		}
+		_Determinant< 0 >( m , 0 , det );
+	}
+
+	template< unsigned int Dim , unsigned int Lanes >
+	void SimpleHullBatch< Dim , Lanes >::process( unsigned int pointCount )
+	{
+		if( pointCount!=Dim+1 && pointCount!=Dim+2 ) ERROR_OUT( "Batched simple hull requires Dim+1 or Dim+2 points: " , pointCount );
+
+		// Computes the center of the first count points
+		auto SetCenter = [&]( unsigned int count , double center[Dim][Lanes] )
+			{
+				for( unsigned int d=0 ; d<Dim ; d++ )
+				{
+					for( unsigned int l=0 ; l<Lanes ; l++ ) center[d][l] = 0;
+					for( unsigned int p=0 ; p<count ; p++ )
+#pragma omp simd
+						for( unsigned int l=0 ; l<Lanes ; l++ ) center[d][l] += coordinates[p][d][l];
+					for( unsigned int l=0 ; l<Lanes ; l++ ) center[d][l] /= (double)count;
+				}
+			};
+
+		double center[Dim][Lanes] , det[Lanes];
+		SetCenter( pointCount , center );
+		for( unsigned int l=0 ; l<Lanes ; l++ ) hullMask[l] = flipMask[l] = 0;
+
+		if( pointCount==Dim+1 )
+		{
+			for( unsigned int f=0 ; f<=Dim ; f++ )
+			{
+				_orientation( simplexFaces[f] , center , det );
+				for( unsigned int l=0 ; l<Lanes ; l++ )
+				{
+					hullMask[l] |= 1ull<<f;
+					if( _sign*det[l]>0 ) flipMask[l] |= 1ull<<f;
+				}
+			}
+		}
+		else
+		{
+			// The center of the initial simplex
+			double simplexCenter[Dim][Lanes];
+			SetCenter( Dim+1 , simplexCenter );
+
+			// Identify which faces contain the remaining point in their shadow
+			unsigned char faceFlags[Dim+1][Lanes];
+			for( unsigned int d=0 ; d<=Dim ; d++ )
+			{
+				SimplexIndex< Dim-1 > face;
+				for( unsigned int i=0 , _i=0 ; i<=Dim ; i++ ) if( i!=d ) face[ _i++ ] = i;
+
+				double _det[Lanes];
+				_orientation( face , simplexCenter , det );
+				_orientation( face , coordinates[Dim+1] , _det );
+				for( unsigned int l=0 ; l<Lanes ; l++ )
+				{
+					faceFlags[d][l] = det[l] * _det[l]>0;
+					if( faceFlags[d][l] ) hullMask[l] |= 1ull<<d;
+				}
+			}
+
+			// Identify the edges that are shadow crossing
+			unsigned int idx = Dim+1;
+			for( unsigned int d=0 ; d<=Dim ; d++ ) for( unsigned int dd=0 ; dd<d ; dd++ , idx++ )
+				for( unsigned int l=0 ; l<Lanes ; l++ )
+					if( faceFlags[ this->incident[d][dd][0] ][l]!=faceFlags[ this->incident[d][dd][1] ][l] ) hullMask[l] |= 1ull<<idx;
+
+			// Orient the candidate faces
+			for( unsigned int c=0 ; c<CandidateNum ; c++ )
+			{
+				_orientation( candidates[c] , center , det );
+				for( unsigned int l=0 ; l<Lanes ; l++ ) if( _sign*det[l]>0 ) flipMask[l] |= 1ull<<c;
+			}
+		}
+	}
+
+	template< unsigned int Dim , unsigned int Lanes >
+	void SimpleHullBatch< Dim , Lanes >::hull( unsigned int lane , unsigned int pointCount , std::vector< SimplexIndex< Dim-1 > > &hull ) const
+	{
+		SimpleHullCount.add();
+		const SimplexIndex< Dim-1 > *faces = pointCount==Dim+1 ? simplexFaces : candidates;
+		unsigned int faceNum = pointCount==Dim+1 ? Dim+1 : CandidateNum;
+
+		hull.resize( 0 );
+		for( unsigned int f=0 ; f<faceNum ; f++ ) if( hullMask[lane] & (1ull<<f) )
+		{
+			SimplexIndex< Dim-1 > si = faces[f];
+			if( flipMask[lane] & (1ull<<f) ) std::swap( si[0] , si[1] );
+			hull.push_back( si );
+		}
+	}
+#endif // FAST_SIMPLE_INCREMENTAL
+
 	template< unsigned int Dim >
 	void Orient( const std::vector< Point< double , Dim > > &points , std::vector< SimplexIndex< Dim-1> > &hull )
 	{
@@ -256,6 +488,7 @@ namespace ConvexHull
 	template< unsigned int Dim >
 	std::vector< SimplexIndex< Dim-1 > > QHull( const std::vector< Point< double , Dim > > &points )
 	{
+		QHullCount.add();
 		std::vector< SimplexIndex< Dim-1 > > hull;
 #ifdef USE_CPP_QHULL
 		// Code adapted from: https://stackoverflow.com/questions/19530731/qhull-library-c-interface
@@ -380,10 +613,11 @@ namespace ConvexHull
 	template< unsigned int Dim , unsigned int MaxN >
 	std::vector< SimplexIndex< Dim-1 > > IncrementalHull( const std::vector< Point< double , Dim > > &points , IncrementalHullScratch< Dim , MaxN > &scratch )
 	{
+		IncrementalHullCount.add();
 		// [DEFINITON] A face is "in shadow" w.r.t. to a point if it is back-facing to the point
 		// Need to remove the faces that are not "in shadow" and replace with new faces
 
-		if constexpr( MaxN!=-1 ) if( points.size()>MaxN ) ERROR_OUT( "Point size mismatch: " , points.size() , " <= " , MaxN );
+		if constexpr( MaxN!=(unsigned int)-1 ) if( points.size()>MaxN ) ERROR_OUT( "Point size mismatch: " , points.size() , " <= " , MaxN );
 
 		if( points.size()<=Dim ) ERROR_OUT( "not enough points" );
 
@@ -445,7 +679,7 @@ namespace ConvexHull
 				for( unsigned int _d=0 ; _d<=Dim-2 ; _d++ ) fi[_d] = faces[f].si[ _fi[_d] ];
 				MultiIndex< Dim-1 , MaxN > mi( &fi[0] );
 				typename IncrementalHullScratch< Dim , MaxN >::BoundaryInfo &bi = boundaryInfo[ mi ];
-				if( bi[0]==-1 ) bi[0] = f , bi.fi = fi;
+				if( bi[0]==(unsigned int)-1 ) bi[0] = f , bi.fi = fi;
 				else            bi[1] = f;
 			}
 
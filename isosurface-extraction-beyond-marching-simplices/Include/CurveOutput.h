@@ -0,0 +1,94 @@
+#ifndef CURVE_OUTPUT_INCLUDED
+#define CURVE_OUTPUT_INCLUDED
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include "Misha/Miscellany.h"
+#include "Misha/CmdLineParser.h"
+#include "Misha/Ply.h"
+#include "Misha/PlyVertexData.h"
+#include "CurveSmoother.h"
+#include "CurveTube.h"
+#include "Instrumentation.h"
+
+// The stage shared by the curve extractors that post-processes the (world-space) level-set in memory,
+// smoothing it and/or converting it to a tube, so that only the final geometry is written
+namespace CurveOutput
+{
+	// The command-line parameters controlling the stage
+	struct Parameters
+	{
+		Misha::CmdLineParameter< double > diffusionTime , tubularRadius;
+		Misha::CmdLineParameter< unsigned int > angularResolution;
+
+		Parameters( void ) : diffusionTime( "diffusion" , 0. ) , tubularRadius( "radius" , 0. ) , angularResolution( "angularRes" , 8 ) {}
+
+		// Prints the usage lines for the parameters
+		void showUsage( void ) const;
+
+		// Exits if the parameters are invalid
+		// [NOTE] This should be called once before processing, so that invalid parameters are not reported as per-job failures in batch mode
+		void validate( void ) const;
+	};
+
+	// Smooths the curve in place and, if a radius is set, converts it to a tube.
+	// The tube (if generated) or the curve is written out if an output file name is given.
+	inline void Process( const Parameters &parameters , std::vector< Point< double , 2 > > &curveVertices , const std::vector< SimplexIndex< 1 > > &curveEdges , std::vector< Point< double , 3 > > &tubeVertices , std::vector< SimplexIndex< 2 > > &tubeTriangles , std::string out , bool ascii , bool verbose );
+
+	/////////////////
+	// Definitions //
+	/////////////////
+
+	inline void Parameters::showUsage( void ) const
+	{
+		std::cout << "\t[--" << diffusionTime.name << " <diffusion time>]" << std::endl;
+		std::cout << "\t[--" << tubularRadius.name << " <tubular radius>]" << std::endl;
+		std::cout << "\t[--" << angularResolution.name << " <angular resolution>=" << angularResolution.value << "]" << std::endl;
+	}
+
+	inline void Parameters::validate( void ) const
+	{
+		if( tubularRadius.set && angularResolution.value<3 ) ERROR_OUT( "Angular resolution must be at least three: " , angularResolution.value );
+	}
+
+	inline void Process( const Parameters &parameters , std::vector< Point< double , 2 > > &curveVertices , const std::vector< SimplexIndex< 1 > > &curveEdges , std::vector< Point< double , 3 > > &tubeVertices , std::vector< SimplexIndex< 2 > > &tubeTriangles , std::string out , bool ascii , bool verbose )
+	{
+		Miscellany::Timer timer;
+
+		if( parameters.diffusionTime.set )
+		{
+			Instrumentation::Scope scope( "smooth" );
+			timer.reset();
+			CurveSmoother< 2 >::Smooth( curveVertices , curveEdges , parameters.diffusionTime.value );
+			if( verbose ) std::cout << "Smoothed level-set: " << timer() << std::endl;
+		}
+
+		if( parameters.tubularRadius.set )
+		{
+			timer.reset();
+			{
+				Instrumentation::Scope scope( "tube" );
+				CurveTube::Generate( curveVertices , curveEdges , parameters.angularResolution.value , parameters.tubularRadius.value , tubeVertices , tubeTriangles );
+			}
+			if( verbose )
+			{
+				std::cout << "Got tube: " << timer() << std::endl;
+				std::cout << "Vertices/triangles: " << tubeVertices.size() << " / " << tubeTriangles.size() << std::endl;
+			}
+			if( out.size() )
+			{
+				Instrumentation::Scope scope( "write" );
+				VertexFactory::PositionFactory< double , 3 > vertexFactory;
+				PLY::WriteSimplices( out , vertexFactory , tubeVertices , tubeTriangles , ascii ? PLY_ASCII : PLY_BINARY_NATIVE );
+			}
+		}
+		else if( out.size() )
+		{
+			Instrumentation::Scope scope( "write" );
+			VertexFactory::PositionFactory< double , 2 > vertexFactory;
+			PLY::WriteSimplices( out , vertexFactory , curveVertices , curveEdges , ascii ? PLY_ASCII : PLY_BINARY_NATIVE );
+		}
+	}
+}
+#endif // CURVE_OUTPUT_INCLUDED
@@ -0,0 +1,228 @@
+#ifndef CURVE_SIMPLIFIER_INCLUDED
+#define CURVE_SIMPLIFIER_INCLUDED
+
+#include <vector>
+#include <algorithm>
+#include <set>
+#include "Misha/Geometry.h"
+#include "Instrumentation.h"
+
+// Functionality for simplifying a curve to within a prescribed Hausdorff distance of the input.
+// The curve is decomposed into chains, joining break vertices through vertices of degree two, and each chain is simplified using the Douglas-Peucker algorithm.
+// A vertex is a break vertex if it does not have degree two or if its two edges have different labels (e.g. the pair of labels separated by the edge of a multi-level-set),
+// so end-points and junctions are retained and chains of different labels are never merged.
+// Since every removed vertex is within the tolerance of the segment replacing it, and the replaced part of the chain is piece-wise linear and spans the segment,
+// the (symmetric) Hausdorff distance between the input and output chains is at most the tolerance.
+// To preserve the topology:
+//		closed chains (cycles, or loops through a single break vertex) are split into three arcs, so that they retain at least three vertices, and
+//		if two chains would be replaced by segments with the same end-points, the second retains its farthest interior vertex.
+// [NOTE] The orientation of the edges is preserved, with each output edge oriented as the first input edge it replaces
+namespace CurveSimplifier
+{
+	//////////////////
+	// Declarations //
+	//////////////////
+
+	// The index marking a vertex that is unset or has been removed
+	static const unsigned int NoVertex = (unsigned int)-1;
+
+	// Replaces the edges with those of the simplified curve, and returns the flags indicating which vertices are retained
+	// The positions are used to measure distances, and the edge labels (if given) prevent chains of different labels from being merged
+	// [NOTE] The vertices are not removed, so that the edges still index the input vertices
+	template< unsigned int Dim >
+	std::vector< bool > Simplify( const std::vector< Point< double , Dim > > &positions , std::vector< SimplexIndex< 1 > > &edges , double tolerance , const std::vector< unsigned int > *edgeLabels=NULL );
+
+	// Removes the vertices that are not retained and re-indexes the edges
+	template< typename Vertex >
+	void Compact( std::vector< Vertex > &vertices , std::vector< SimplexIndex< 1 > > &edges , const std::vector< bool > &retained );
+
+	/////////////////
+	// Definitions //
+	/////////////////
+
+	// Returns the squared distance from the point to the segment
+	template< unsigned int Dim >
+	double _SquareDistance( Point< double , Dim > p , Point< double , Dim > s0 , Point< double , Dim > s1 )
+	{
+		Point< double , Dim > d = s1 - s0;
+		double len2 = d.squareNorm();
+		double t = len2 ? Point< double , Dim >::Dot( p - s0 , d ) / len2 : 0;
+		t = std::max< double >( 0. , std::min< double >( 1. , t ) );
+		return ( p - ( s0 + d * t ) ).squareNorm();
+	}
+
+	struct _Chain
+	{
+		// The vertices along the chain, with the k-th edge joining the k-th and (k+1)-st vertices
+		std::vector< unsigned int > vertices , edges;
+		// The indices (into the chain) of the retained vertices
+		std::vector< unsigned int > retained;
+	};
+
+	// Marks the vertices of the chain, in the range [first,last], that are retained by the Douglas-Peucker algorithm
+	template< unsigned int Dim >
+	void _DouglasPeucker( const std::vector< Point< double , Dim > > &positions , const _Chain &chain , unsigned int first , unsigned int last , double tolerance2 , std::vector< bool > &retained , std::vector< std::pair< unsigned int , unsigned int > > &stack )
+	{
+		stack.resize( 0 );
+		stack.push_back( std::pair< unsigned int , unsigned int >( first , last ) );
+		while( stack.size() )
+		{
+			std::pair< unsigned int , unsigned int > range = stack.back();
+			stack.pop_back();
+			const Point< double , Dim > &p0 = positions[ chain.vertices[range.first] ] , &p1 = positions[ chain.vertices[range.second] ];
+			unsigned int farthest = NoVertex;
+			double maxDistance2 = tolerance2;
+			for( unsigned int k=range.first+1 ; k<range.second ; k++ )
+			{
+				double distance2 = _SquareDistance( positions[ chain.vertices[k] ] , p0 , p1 );
+				if( distance2>maxDistance2 ) maxDistance2 = distance2 , farthest = k;
+			}
+			if( farthest!=NoVertex )
+			{
+				retained[farthest] = true;
+				stack.push_back( std::pair< unsigned int , unsigned int >( range.first , farthest ) );
+				stack.push_back( std::pair< unsigned int , unsigned int >( farthest , range.second ) );
+			}
+		}
+	}
+
+	template< unsigned int Dim >
+	std::vector< bool > Simplify( const std::vector< Point< double , Dim > > &positions , std::vector< SimplexIndex< 1 > > &edges , double tolerance , const std::vector< unsigned int > *edgeLabels )
+	{
+		Instrumentation::Scope scope( "simplify" );
+		if( edgeLabels && edgeLabels->size()!=edges.size() ) ERROR_OUT( "Label and edge counts don't match: " , edgeLabels->size() , " != " , edges.size() );
+
+		// Compute the vertex-to-edge incidence, in compressed row format
+		std::vector< size_t > offsets( positions.size()+1 , 0 );
+		std::vector< unsigned int > incidence( 2*edges.size() );
+		for( size_t i=0 ; i<edges.size() ; i++ ) offsets[ edges[i][0]+1 ]++ , offsets[ edges[i][1]+1 ]++;
+		for( size_t i=0 ; i<positions.size() ; i++ ) offsets[i+1] += offsets[i];
+		{
+			std::vector< size_t > _offsets( offsets.begin() , offsets.end()-1 );
+			for( size_t i=0 ; i<edges.size() ; i++ ) incidence[ _offsets[ edges[i][0] ]++ ] = (unsigned int)i , incidence[ _offsets[ edges[i][1] ]++ ] = (unsigned int)i;
+		}
+		auto Opposite = [&]( unsigned int e , unsigned int v ){ return edges[e][0]==v ? edges[e][1] : edges[e][0]; };
+
+		// Identify the break vertices
+		std::vector< bool > isBreak( positions.size() , false );
+		for( unsigned int v=0 ; v<positions.size() ; v++ )
+		{
+			if( offsets[v+1]-offsets[v]!=2 ) isBreak[v] = true;
+			else
+			{
+				unsigned int e0 = incidence[ offsets[v] ] , e1 = incidence[ offsets[v]+1 ];
+				if( e0==e1 || ( edgeLabels && (*edgeLabels)[e0]!=(*edgeLabels)[e1] ) ) isBreak[v] = true;
+			}
+		}
+
+		// Gather the chains, first those starting at break vertices and then the cycles
+		std::vector< _Chain > chains;
+		std::vector< bool > edgeVisited( edges.size() , false );
+		auto Walk = [&]( unsigned int v , unsigned int e )
+			{
+				_Chain chain;
+				chain.vertices.push_back( v );
+				while( true )
+				{
+					edgeVisited[e] = true;
+					chain.edges.push_back( e );
+					v = Opposite( e , v );
+					chain.vertices.push_back( v );
+					if( isBreak[v] || v==chain.vertices[0] ) break;
+					e = incidence[ offsets[v] ]==e ? incidence[ offsets[v]+1 ] : incidence[ offsets[v] ];
+				}
+				chains.push_back( chain );
+			};
+		for( unsigned int v=0 ; v<positions.size() ; v++ ) if( isBreak[v] )
+			for( size_t j=offsets[v] ; j<offsets[v+1] ; j++ ) if( !edgeVisited[ incidence[j] ] ) Walk( v , incidence[j] );
+		for( unsigned int e=0 ; e<edges.size() ; e++ ) if( !edgeVisited[e] ) Walk( edges[e][0] , e );
+
+		// Simplify the chains
+#pragma omp parallel
+		{
+			std::vector< bool > retained;
+			std::vector< std::pair< unsigned int , unsigned int > > stack;
+#pragma omp for schedule( dynamic )
+			for( long long c=0 ; c<(long long)chains.size() ; c++ )
+			{
+				_Chain &chain = chains[c];
+				unsigned int n = (unsigned int)chain.vertices.size()-1;
+				retained.resize( 0 );
+				retained.resize( n+1 , false );
+				retained[0] = retained[n] = true;
+				if( chain.vertices[0]==chain.vertices[n] && n<3 ) for( unsigned int k=0 ; k<=n ; k++ ) retained[k] = true;
+				else if( chain.vertices[0]==chain.vertices[n] )
+				{
+					retained[n/3] = retained[(2*n)/3] = true;
+					_DouglasPeucker( positions , chain , 0 , n/3 , tolerance*tolerance , retained , stack );
+					_DouglasPeucker( positions , chain , n/3 , (2*n)/3 , tolerance*tolerance , retained , stack );
+					_DouglasPeucker( positions , chain , (2*n)/3 , n , tolerance*tolerance , retained , stack );
+				}
+				else _DouglasPeucker( positions , chain , 0 , n , tolerance*tolerance , retained , stack );
+				for( unsigned int k=0 ; k<=n ; k++ ) if( retained[k] ) chain.retained.push_back( k );
+			}
+		}
+
+		// Ensure that no two chains are replaced by segments with the same end-points, processing the chains that are already single edges first
+		{
+			std::set< std::pair< unsigned int , unsigned int > > segments;
+			auto Key = [&]( const _Chain &chain )
+				{
+					unsigned int v0 = chain.vertices.front() , v1 = chain.vertices.back();
+					return std::pair< unsigned int , unsigned int >( std::min< unsigned int >( v0 , v1 ) , std::max< unsigned int >( v0 , v1 ) );
+				};
+			for( size_t c=0 ; c<chains.size() ; c++ ) if( chains[c].edges.size()==1 ) segments.insert( Key( chains[c] ) );
+			for( size_t c=0 ; c<chains.size() ; c++ ) if( chains[c].edges.size()>1 && chains[c].retained.size()==2 && !segments.insert( Key( chains[c] ) ).second )
+			{
+				_Chain &chain = chains[c];
+				const Point< double , Dim > &p0 = positions[ chain.vertices.front() ] , &p1 = positions[ chain.vertices.back() ];
+				unsigned int farthest = 1;
+				double maxDistance2 = -1;
+				for( unsigned int k=1 ; k+1<chain.vertices.size() ; k++ )
+				{
+					double distance2 = _SquareDistance( positions[ chain.vertices[k] ] , p0 , p1 );
+					if( distance2>maxDistance2 ) maxDistance2 = distance2 , farthest = k;
+				}
+				chain.retained.insert( chain.retained.begin()+1 , farthest );
+			}
+		}
+
+		// Set the retained vertices (including isolated ones) and the simplified edges
+		std::vector< bool > retained( positions.size() , true );
+		std::vector< SimplexIndex< 1 > > _edges;
+		_edges.reserve( edges.size() );
+		for( size_t c=0 ; c<chains.size() ; c++ )
+		{
+			const _Chain &chain = chains[c];
+			for( unsigned int k=1 ; k+1<chain.vertices.size() ; k++ ) retained[ chain.vertices[k] ] = false;
+			for( unsigned int k=0 ; k+1<chain.retained.size() ; k++ )
+			{
+				unsigned int k0 = chain.retained[k] , k1 = chain.retained[k+1];
+				SimplexIndex< 1 > edge;
+				edge[0] = chain.vertices[k0] , edge[1] = chain.vertices[k1];
+				if( edges[ chain.edges[k0] ][0]!=chain.vertices[k0] ) std::swap( edge[0] , edge[1] );
+				_edges.push_back( edge );
+			}
+		}
+		for( size_t c=0 ; c<chains.size() ; c++ ) for( unsigned int k=0 ; k<chains[c].retained.size() ; k++ ) retained[ chains[c].vertices[ chains[c].retained[k] ] ] = true;
+		edges = _edges;
+		return retained;
+	}
+
+	template< typename Vertex >
+	void Compact( std::vector< Vertex > &vertices , std::vector< SimplexIndex< 1 > > &edges , const std::vector< bool > &retained )
+	{
+		if( retained.size()!=vertices.size() ) ERROR_OUT( "Flag and vertex counts don't match: " , retained.size() , " != " , vertices.size() );
+		std::vector< unsigned int > map( vertices.size() , NoVertex );
+		unsigned int count = 0;
+		for( size_t i=0 ; i<vertices.size() ; i++ ) if( retained[i] ) map[i] = count , vertices[count++] = vertices[i];
+		vertices.resize( count );
+		for( size_t i=0 ; i<edges.size() ; i++ ) for( unsigned int j=0 ; j<2 ; j++ )
+		{
+			edges[i][j] = map[ edges[i][j] ];
+			if( edges[i][j]==NoVertex ) ERROR_OUT( "Edge references removed vertex" );
+		}
+	}
+}
+
+#endif // CURVE_SIMPLIFIER_INCLUDED
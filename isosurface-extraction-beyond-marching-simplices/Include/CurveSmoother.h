@@ -0,0 +1,285 @@
+#ifndef CURVE_SMOOTHER_INCLUDED
+#define CURVE_SMOOTHER_INCLUDED
+
+#include <vector>
+#include <Eigen/Sparse>
+#include "Misha/Geometry.h"
+#include "Instrumentation.h"
+
+// Smooths a curve by solving the (implicit) diffusion equation ( M + t * S ) x = M x_0, with M and S the piecewise-linear mass and stiffness matrices.
+// The curve is decomposed into connected components, each of which is:
+//		an isolated vertex, which is left unchanged,
+//		a path, whose system is tridiagonal and is solved using the Thomas algorithm,
+//		a cycle, whose system is cyclic-tridiagonal and is solved using the Thomas algorithm with a Sherman-Morrison correction, or
+//		a general graph (e.g. one with a junction vertex), whose system is solved using a sparse LDL^t factorization.
+// Paths and cycles are solved in parallel, and all general components are gathered into a single sparse system.
+// [NOTE] The system matrix is strictly diagonally dominant so the Thomas algorithm is stable without pivoting.
+template< unsigned int Dim >
+struct CurveSmoother
+{
+	enum ComponentType
+	{
+		POINT ,
+		PATH ,
+		CYCLE ,
+		GENERAL ,
+		COMPONENT_TYPE_COUNT
+	};
+	static const std::string ComponentTypeNames[];
+
+	// Analyzes the curve, with edge lengths given by the positions of the vertices
+	CurveSmoother( const std::vector< Point< double , Dim > > &vertices , const std::vector< SimplexIndex< 1 > > &edges );
+
+	// Sets the output vertices to the result of diffusing the input vertices for the prescribed time
+	// [NOTE] The input and output vertices can be the same
+	void smooth( const std::vector< Point< double , Dim > > &in , double diffusionTime , std::vector< Point< double , Dim > > &out );
+
+	// Smooths the curve in place, first re-scaling it to have unit length so that the diffusion time is consistent across curves
+	static void Smooth( std::vector< Point< double , Dim > > &vertices , const std::vector< SimplexIndex< 1 > > &edges , double diffusionTime );
+
+	// The number of components of the prescribed type
+	size_t components( ComponentType type ) const { return _componentCount[type]; }
+
+protected:
+	struct _Component
+	{
+		ComponentType type;
+		// For paths and cycles, the vertices are ordered along the chain and the k-th edge joins the k-th and (k+1)-st vertices (modulo the vertex count)
+		std::vector< unsigned int > vertices , edges;
+	};
+
+	std::vector< _Component > _components;
+	std::vector< double > _lengths;
+	size_t _componentCount[ COMPONENT_TYPE_COUNT ];
+
+	// The vertices of the general components and the associated mass and stiffness matrices
+	std::vector< unsigned int > _generalVertices;
+	Eigen::SparseMatrix< double > _M , _S;
+	Eigen::SimplicialLDLT< Eigen::SparseMatrix< double > > _solver;
+
+	// Solves the symmetric tridiagonal system with diagonal entries diag[k] and off-diagonal entries off[k] (coupling k and k+1), overwriting the right-hand side
+	template< typename Value >
+	static void _SolveTridiagonal( size_t n , const double *diag , const double *off , Value *x , std::vector< double > &scratch );
+
+	void _smoothChain( const _Component &component , const std::vector< Point< double , Dim > > &in , double diffusionTime , std::vector< Point< double , Dim > > &out ) const;
+};
+
+template< unsigned int Dim >
+const std::string CurveSmoother< Dim >::ComponentTypeNames[] = { "point" , "path" , "cycle" , "general" };
+
+template< unsigned int Dim >
+CurveSmoother< Dim >::CurveSmoother( const std::vector< Point< double , Dim > > &vertices , const std::vector< SimplexIndex< 1 > > &edges )
+{
+	Instrumentation::Scope scope( "analyze curve" );
+	for( unsigned int t=0 ; t<COMPONENT_TYPE_COUNT ; t++ ) _componentCount[t] = 0;
+
+	_lengths.resize( edges.size() );
+	for( size_t i=0 ; i<edges.size() ; i++ ) _lengths[i] = sqrt( ( vertices[ edges[i][0] ] - vertices[ edges[i][1] ] ).squareNorm() );
+
+	// Compute the vertex-to-edge incidence, in compressed row format
+	std::vector< size_t > offsets( vertices.size()+1 , 0 );
+	std::vector< unsigned int > incidence( 2*edges.size() );
+	for( size_t i=0 ; i<edges.size() ; i++ ) offsets[ edges[i][0]+1 ]++ , offsets[ edges[i][1]+1 ]++;
+	for( size_t i=0 ; i<vertices.size() ; i++ ) offsets[i+1] += offsets[i];
+	{
+		std::vector< size_t > _offsets( offsets.begin() , offsets.end()-1 );
+		for( size_t i=0 ; i<edges.size() ; i++ ) incidence[ _offsets[ edges[i][0] ]++ ] = (unsigned int)i , incidence[ _offsets[ edges[i][1] ]++ ] = (unsigned int)i;
+	}
+	auto Degree = [&]( unsigned int v ){ return offsets[v+1] - offsets[v]; };
+	auto Opposite = [&]( unsigned int e , unsigned int v ){ return edges[e][0]==v ? edges[e][1] : edges[e][0]; };
+
+	// Gather the connected components and classify them
+	std::vector< bool > vertexVisited( vertices.size() , false ) , edgeVisited( edges.size() , false );
+	std::vector< unsigned int > stack;
+	for( unsigned int v=0 ; v<vertices.size() ; v++ ) if( !vertexVisited[v] )
+	{
+		_Component component;
+		bool simple = true;
+		size_t endCount = 0;
+
+		vertexVisited[v] = true;
+		stack.push_back( v );
+		while( stack.size() )
+		{
+			unsigned int w = stack.back();
+			stack.pop_back();
+			component.vertices.push_back( w );
+			if( Degree(w)>2 ) simple = false;
+			else if( Degree(w)==1 ) endCount++;
+			for( size_t j=offsets[w] ; j<offsets[w+1] ; j++ )
+			{
+				unsigned int e = incidence[j];
+				if( edges[e][0]==edges[e][1] ) simple = false;
+				if( !edgeVisited[e] ) edgeVisited[e] = true , component.edges.push_back( e );
+				unsigned int _w = Opposite( e , w );
+				if( !vertexVisited[_w] ) vertexVisited[_w] = true , stack.push_back( _w );
+			}
+		}
+
+		size_t vNum = component.vertices.size() , eNum = component.edges.size();
+		if( !eNum ) component.type = POINT;
+		else if( simple && eNum==vNum-1 && endCount==2 ) component.type = PATH;
+		// [NOTE] Two vertices joined by two edges are treated as a general component
+		else if( simple && eNum==vNum && !endCount && vNum>2 ) component.type = CYCLE;
+		else component.type = GENERAL;
+
+		// Re-order the vertices and edges of paths and cycles along the chain
+		if( component.type==PATH || component.type==CYCLE )
+		{
+			unsigned int start = component.vertices[0];
+			if( component.type==PATH ) for( unsigned int i=0 ; i<vNum ; i++ ) if( Degree( component.vertices[i] )==1 ){ start = component.vertices[i] ; break; }
+			component.vertices.resize( 0 ) , component.edges.resize( 0 );
+
+			unsigned int w = start , e = (unsigned int)-1;
+			while( true )
+			{
+				component.vertices.push_back( w );
+				unsigned int _e = (unsigned int)-1;
+				for( size_t j=offsets[w] ; j<offsets[w+1] ; j++ ) if( incidence[j]!=e ) _e = incidence[j];
+				if( _e==(unsigned int)-1 ) break;
+				e = _e;
+				component.edges.push_back( e );
+				w = Opposite( e , w );
+				if( w==start ) break;
+			}
+			if( component.vertices.size()!=vNum || component.edges.size()!=eNum ) ERROR_OUT( "Failed to traverse chain: " , component.vertices.size() , " / " , vNum , " , " , component.edges.size() , " / " , eNum );
+		}
+		_componentCount[ component.type ]++;
+		_components.push_back( component );
+	}
+
+	// Assemble the mass and stiffness matrices of the general components and analyze the sparsity pattern
+	{
+		std::vector< unsigned int > localIndex( vertices.size() , (unsigned int)-1 );
+		std::vector< Eigen::Triplet< double > > M_triplets , S_triplets;
+		for( size_t c=0 ; c<_components.size() ; c++ ) if( _components[c].type==GENERAL )
+		{
+			for( size_t i=0 ; i<_components[c].vertices.size() ; i++ )
+			{
+				localIndex[ _components[c].vertices[i] ] = (unsigned int)_generalVertices.size();
+				_generalVertices.push_back( _components[c].vertices[i] );
+			}
+			for( size_t i=0 ; i<_components[c].edges.size() ; i++ )
+			{
+				unsigned int e = _components[c].edges[i] , v0 = localIndex[ edges[e][0] ] , v1 = localIndex[ edges[e][1] ];
+				double len = _lengths[e];
+				M_triplets.emplace_back( v0 , v0 , len/3. );
+				M_triplets.emplace_back( v1 , v1 , len/3. );
+				M_triplets.emplace_back( v0 , v1 , len/6. );
+				M_triplets.emplace_back( v1 , v0 , len/6. );
+
+				S_triplets.emplace_back( v0 , v0 ,  1/len );
+				S_triplets.emplace_back( v1 , v1 ,  1/len );
+				S_triplets.emplace_back( v0 , v1 , -1/len );
+				S_triplets.emplace_back( v1 , v0 , -1/len );
+			}
+		}
+		if( _generalVertices.size() )
+		{
+			_M.resize( _generalVertices.size() , _generalVertices.size() );
+			_S.resize( _generalVertices.size() , _generalVertices.size() );
+			_M.setFromTriplets( M_triplets.begin() , M_triplets.end() );
+			_S.setFromTriplets( S_triplets.begin() , S_triplets.end() );
+			_solver.analyzePattern( _M + _S );
+		}
+	}
+}
+
+template< unsigned int Dim >
+void CurveSmoother< Dim >::Smooth( std::vector< Point< double , Dim > > &vertices , const std::vector< SimplexIndex< 1 > > &edges , double diffusionTime )
+{
+	double scale = 0;
+	for( size_t i=0 ; i<edges.size() ; i++ ) scale += sqrt( ( vertices[ edges[i][0] ] - vertices[ edges[i][1] ] ).squareNorm() );
+	if( !scale ) return;
+	for( size_t i=0 ; i<vertices.size() ; i++ ) vertices[i] /= scale;
+	CurveSmoother smoother( vertices , edges );
+	smoother.smooth( vertices , diffusionTime , vertices );
+	for( size_t i=0 ; i<vertices.size() ; i++ ) vertices[i] *= scale;
+}
+
+template< unsigned int Dim >
+template< typename Value >
+void CurveSmoother< Dim >::_SolveTridiagonal( size_t n , const double *diag , const double *off , Value *x , std::vector< double > &scratch )
+{
+	scratch.resize( n );
+	double m = diag[0];
+	x[0] *= 1./m;
+	for( size_t k=1 ; k<n ; k++ )
+	{
+		scratch[k-1] = off[k-1] / m;
+		m = diag[k] - off[k-1] * scratch[k-1];
+		x[k] = ( x[k] - x[k-1] * off[k-1] ) * ( 1./m );
+	}
+	for( size_t k=n-1 ; k>0 ; k-- ) x[k-1] -= x[k] * scratch[k-1];
+}
+
+template< unsigned int Dim >
+void CurveSmoother< Dim >::_smoothChain( const _Component &component , const std::vector< Point< double , Dim > > &in , double diffusionTime , std::vector< Point< double , Dim > > &out ) const
+{
+	size_t n = component.vertices.size();
+	// For a path there are n-1 edges, for a cycle the last edge couples the last vertex to the first
+	std::vector< double > diag( n , 0 ) , off( n , 0 ) , scratch;
+	std::vector< Point< double , Dim > > x( n );
+
+	for( size_t k=0 ; k<component.edges.size() ; k++ )
+	{
+		size_t k0 = k , k1 = (k+1)%n;
+		double len = _lengths[ component.edges[k] ];
+		const Point< double , Dim > &p0 = in[ component.vertices[k0] ] , &p1 = in[ component.vertices[k1] ];
+		diag[k0] += len/3. + diffusionTime/len;
+		diag[k1] += len/3. + diffusionTime/len;
+		off[k] = len/6. - diffusionTime/len;
+		x[k0] += p0 * ( len/3. ) + p1 * ( len/6. );
+		x[k1] += p1 * ( len/3. ) + p0 * ( len/6. );
+	}
+
+	if( component.type==PATH ) _SolveTridiagonal( n , &diag[0] , &off[0] , &x[0] , scratch );
+	else
+	{
+		// Write the cyclic system as a tridiagonal system plus the rank-one matrix u v^t, with u = ( gamma , 0 , ... , 0 , beta ) and v = ( 1 , 0 , ... , 0 , beta/gamma )
+		double beta = off[n-1] , gamma = -diag[0];
+		diag[0] -= gamma;
+		diag[n-1] -= beta * beta / gamma;
+
+		std::vector< double > z( n , 0 );
+		z[0] = gamma , z[n-1] = beta;
+		_SolveTridiagonal( n , &diag[0] , &off[0] , &x[0] , scratch );
+		_SolveTridiagonal( n , &diag[0] , &off[0] , &z[0] , scratch );
+
+		// Apply the Sherman-Morrison correction
+		Point< double , Dim > vx = x[0] + x[n-1] * ( beta / gamma );
+		double vz = 1. + z[0] + z[n-1] * ( beta / gamma );
+		for( size_t k=0 ; k<n ; k++ ) x[k] -= vx * ( z[k] / vz );
+	}
+
+	for( size_t k=0 ; k<n ; k++ ) out[ component.vertices[k] ] = x[k];
+}
+
+template< unsigned int Dim >
+void CurveSmoother< Dim >::smooth( const std::vector< Point< double , Dim > > &in , double diffusionTime , std::vector< Point< double , Dim > > &out )
+{
+	if( &out!=&in ) out = in;
+
+	// Solve the general components first, since the chains overwrite the output vertices in place
+	Eigen::MatrixXd b( _generalVertices.size() , Dim );
+	if( _generalVertices.size() )
+	{
+		Instrumentation::Scope scope( "solve general" );
+		for( size_t i=0 ; i<_generalVertices.size() ; i++ ) for( unsigned int d=0 ; d<Dim ; d++ ) b(i,d) = in[ _generalVertices[i] ][d];
+		_solver.factorize( _M + _S * diffusionTime );
+		if( _solver.info()!=Eigen::Success ) THROW( "Failed to factor system matrix" );
+		b = _solver.solve( _M * b );
+	}
+
+#pragma omp parallel
+	{
+		Instrumentation::Scope scope( "solve chains" );
+#pragma omp for schedule( dynamic )
+		for( long long c=0 ; c<(long long)_components.size() ; c++ )
+			if( _components[c].type==PATH || _components[c].type==CYCLE ) _smoothChain( _components[c] , in , diffusionTime , out );
+	}
+
+	for( size_t i=0 ; i<_generalVertices.size() ; i++ ) for( unsigned int d=0 ; d<Dim ; d++ ) out[ _generalVertices[i] ][d] = b(i,d);
+}
+
+#endif // CURVE_SMOOTHER_INCLUDED
@@ -0,0 +1,172 @@
+#ifndef CURVE_TUBE_INCLUDED
+#define CURVE_TUBE_INCLUDED
+
+#include <vector>
+#include <algorithm>
+#include "Misha/Geometry.h"
+#include "Instrumentation.h"
+
+// Functionality for generating a tube around a curve in the plane.
+// Each curve vertex is replaced by a ring of vertices in the plane spanned by the (averaged) curve normal and the z-axis,
+// and each curve edge by a band of triangles joining the rings of its end-points.
+// Rings can have different resolutions, in which case the band is obtained by "zipping" the two rings together in order of angle.
+// Since a ring is shared by all the edges incident on its vertex, the tube is watertight regardless of the resolutions.
+// [NOTE] The triangles are stored in a flat, fixed-width buffer, with the triangles of the i-th edge stored contiguously after those of the (i-1)-st
+namespace CurveTube
+{
+	// Generates the tube with the prescribed number of vertices per ring and radius
+	inline void Generate( const std::vector< Point< double , 2 > > &curveVertices , const std::vector< SimplexIndex< 1 > > &curveEdges , unsigned int angularResolution , double radius , std::vector< Point< double , 3 > > &tubeVertices , std::vector< SimplexIndex< 2 > > &tubeTriangles );
+
+	// Generates the tube with the prescribed number of vertices per ring (for each curve vertex) and radius
+	inline void Generate( const std::vector< Point< double , 2 > > &curveVertices , const std::vector< SimplexIndex< 1 > > &curveEdges , const std::vector< unsigned int > &angularResolutions , double radius , std::vector< Point< double , 3 > > &tubeVertices , std::vector< SimplexIndex< 2 > > &tubeTriangles );
+
+	// Returns the smallest number of vertices per ring, in the range [minResolution,maxResolution], for which the ring is within the prescribed distance of the circle.
+	// A ring with r vertices is within radius * ( 1 - cos( pi/r ) ) of the circle.
+	// The tolerance is scaled down by ( 1 + k * radius ), with k the curvature of the curve at the vertex, since on the inside of a bend the tube's surface curves more sharply.
+	// [NOTE] Vertices which are not interior to a chain (end-points and junctions) are assigned at least the largest resolution of their interior neighbors
+	// [NOTE] A tolerance that is not positive is met only by the maximum resolution
+	inline std::vector< unsigned int > AngularResolutions( const std::vector< Point< double , 2 > > &curveVertices , const std::vector< SimplexIndex< 1 > > &curveEdges , double radius , double tolerance , unsigned int minResolution , unsigned int maxResolution );
+
+	/////////////////
+	// Definitions //
+	/////////////////
+
+	inline void Generate( const std::vector< Point< double , 2 > > &curveVertices , const std::vector< SimplexIndex< 1 > > &curveEdges , unsigned int angularResolution , double radius , std::vector< Point< double , 3 > > &tubeVertices , std::vector< SimplexIndex< 2 > > &tubeTriangles )
+	{
+		Generate( curveVertices , curveEdges , std::vector< unsigned int >( curveVertices.size() , angularResolution ) , radius , tubeVertices , tubeTriangles );
+	}
+
+	inline void Generate( const std::vector< Point< double , 2 > > &curveVertices , const std::vector< SimplexIndex< 1 > > &curveEdges , const std::vector< unsigned int > &angularResolutions , double radius , std::vector< Point< double , 3 > > &tubeVertices , std::vector< SimplexIndex< 2 > > &tubeTriangles )
+	{
+		if( angularResolutions.size()!=curveVertices.size() ) ERROR_OUT( "Resolution and vertex counts don't match: " , angularResolutions.size() , " != " , curveVertices.size() );
+		unsigned int maxResolution = 0;
+		for( size_t i=0 ; i<angularResolutions.size() ; i++ )
+		{
+			if( angularResolutions[i]<3 ) ERROR_OUT( "Angular resolution must be at least three: " , angularResolutions[i] );
+			maxResolution = std::max< unsigned int >( maxResolution , angularResolutions[i] );
+		}
+
+		std::vector< Point< double , 2 > > normals( curveVertices.size() );
+		for( size_t i=0 ; i<curveEdges.size() ; i++ )
+		{
+			Point< double , 2 > dir = curveVertices[ curveEdges[i][1] ] - curveVertices[ curveEdges[i][0] ];
+
+			Point< double , 2 > n = Point< double , 2 >::CrossProduct( dir );
+			normals[ curveEdges[i][0] ] += n;
+			normals[ curveEdges[i][1] ] += n;
+		}
+
+		// The (scaled) unit rings, shared by all vertices with the same resolution
+		std::vector< std::vector< std::pair< double , double > > > rings( maxResolution+1 );
+		for( size_t i=0 ; i<angularResolutions.size() ; i++ ) if( !rings[ angularResolutions[i] ].size() )
+		{
+			unsigned int res = angularResolutions[i];
+			rings[res].resize( res );
+			for( unsigned int j=0 ; j<res ; j++ )
+			{
+				double theta = ( 2. * M_PI * j ) / res;
+				rings[res][j] = std::pair< double , double >( sin( theta ) * radius , cos( theta ) * radius );
+			}
+		}
+
+		// The offsets of the rings and of the edges' triangles
+		std::vector< size_t > vertexOffsets( curveVertices.size()+1 , 0 ) , triangleOffsets( curveEdges.size()+1 , 0 );
+		for( size_t i=0 ; i<curveVertices.size() ; i++ ) vertexOffsets[i+1] = vertexOffsets[i] + angularResolutions[i];
+		for( size_t i=0 ; i<curveEdges.size() ; i++ ) triangleOffsets[i+1] = triangleOffsets[i] + angularResolutions[ curveEdges[i][0] ] + angularResolutions[ curveEdges[i][1] ];
+
+		tubeVertices.resize( vertexOffsets.back() );
+#pragma omp parallel
+		{
+			Instrumentation::Scope scope( "tube rings" );
+#pragma omp for
+			for( long long i=0 ; i<(long long)curveVertices.size() ; i++ )
+			{
+				Point< double , 2 > n = normals[i] / sqrt( normals[i].squareNorm() );
+				const std::vector< std::pair< double , double > > &ring = rings[ angularResolutions[i] ];
+				Point< double , 3 > *_tubeVertices = &tubeVertices[ vertexOffsets[i] ];
+				for( unsigned int j=0 ; j<ring.size() ; j++ )
+				{
+					_tubeVertices[j][0] = curveVertices[i][0] + n[0] * ring[j].second;
+					_tubeVertices[j][1] = curveVertices[i][1] + n[1] * ring[j].second;
+					_tubeVertices[j][2] = ring[j].first;
+				}
+			}
+		}
+
+		tubeTriangles.resize( triangleOffsets.back() );
+#pragma omp parallel
+		{
+			Instrumentation::Scope scope( "tube bands" );
+#pragma omp for
+			for( long long i=0 ; i<(long long)curveEdges.size() ; i++ )
+			{
+				unsigned int i1 = (unsigned int)vertexOffsets[ curveEdges[i][0] ] , i2 = (unsigned int)vertexOffsets[ curveEdges[i][1] ];
+				unsigned int r1 = angularResolutions[ curveEdges[i][0] ] , r2 = angularResolutions[ curveEdges[i][1] ];
+				SimplexIndex< 2 > *_tubeTriangles = &tubeTriangles[ triangleOffsets[i] ];
+
+				// Advance along whichever ring has the next vertex with the smaller angle, j1/r1 < j2/r2, emitting one triangle per step
+				// [NOTE] When the resolutions agree, this gives two triangles per quad of the band
+				unsigned int j1 = 0 , j2 = 0;
+				for( unsigned int t=0 ; t<r1+r2 ; t++ )
+					if( j2==r2 || ( j1<r1 && (unsigned long long)(j1+1)*r2 < (unsigned long long)(j2+1)*r1 ) )
+					{
+						_tubeTriangles[t] = SimplexIndex< 2 >( i1+j1 , i2+(j2%r2) , i1+((j1+1)%r1) );
+						j1++;
+					}
+					else
+					{
+						_tubeTriangles[t] = SimplexIndex< 2 >( i1+(j1%r1) , i2+j2 , i2+((j2+1)%r2) );
+						j2++;
+					}
+			}
+		}
+	}
+
+	inline std::vector< unsigned int > AngularResolutions( const std::vector< Point< double , 2 > > &curveVertices , const std::vector< SimplexIndex< 1 > > &curveEdges , double radius , double tolerance , unsigned int minResolution , unsigned int maxResolution )
+	{
+		minResolution = std::max< unsigned int >( minResolution , 3 );
+		maxResolution = std::max< unsigned int >( maxResolution , minResolution );
+
+		// The (up to two) neighbors of each vertex, and the number of incident edges
+		std::vector< unsigned int > valences( curveVertices.size() , 0 ) , neighbors( 2*curveVertices.size() );
+		for( size_t i=0 ; i<curveEdges.size() ; i++ ) for( unsigned int k=0 ; k<2 ; k++ )
+		{
+			unsigned int v = curveEdges[i][k];
+			if( valences[v]<2 ) neighbors[ 2*v + valences[v] ] = curveEdges[i][1-k];
+			valences[v]++;
+		}
+
+		std::vector< unsigned int > resolutions( curveVertices.size() , minResolution );
+		// The smallest resolution whose ring is within the tolerance
+		auto Resolution = [&]( double tolerance )
+			{
+				if( tolerance>=radius ) return minResolution;
+				if( !( tolerance>0 ) ) return maxResolution;
+				double res = M_PI / acos( 1. - tolerance / radius );
+				return res>=maxResolution ? maxResolution : std::max< unsigned int >( minResolution , (unsigned int)ceil( res ) );
+			};
+
+#pragma omp parallel for
+		for( long long i=0 ; i<(long long)curveVertices.size() ; i++ ) if( valences[i]==2 )
+		{
+			Point< double , 2 > t1 = curveVertices[ neighbors[2*i+0] ] - curveVertices[i] , t2 = curveVertices[ neighbors[2*i+1] ] - curveVertices[i];
+			double l1 = sqrt( t1.squareNorm() ) , l2 = sqrt( t2.squareNorm() );
+			double curvature = 0;
+			if( l1>0 && l2>0 )
+			{
+				double c = Point< double , 2 >::Dot( t1 , t2 ) / ( l1 * l2 );
+				curvature = ( M_PI - acos( std::max< double >( -1. , std::min< double >( 1. , c ) ) ) ) / ( ( l1 + l2 ) / 2. );
+			}
+			resolutions[i] = Resolution( tolerance / ( 1. + curvature * radius ) );
+		}
+		for( size_t i=0 ; i<curveVertices.size() ; i++ ) if( valences[i]!=2 ) resolutions[i] = Resolution( tolerance );
+		for( size_t i=0 ; i<curveEdges.size() ; i++ ) for( unsigned int k=0 ; k<2 ; k++ )
+		{
+			unsigned int v = curveEdges[i][k] , w = curveEdges[i][1-k];
+			if( valences[v]!=2 && valences[w]==2 ) resolutions[v] = std::max< unsigned int >( resolutions[v] , resolutions[w] );
+		}
+		return resolutions;
+	}
+}
+
+#endif // CURVE_TUBE_INCLUDED
@@ -0,0 +1,276 @@
+#ifndef GRID_GENERATOR_INCLUDED
+#define GRID_GENERATOR_INCLUDED
+
+#include <string>
+#include <vector>
+#include <limits>
+#include <sstream>
+#include <type_traits>
+#include "Misha/Geometry.h"
+#include "Misha/RegularGrid.h"
+#include "Philox.h"
+#include "TiledGrid.h"
+
+// Functionality for generating grids of analytic fields, sampled over the unit cube, for testing at scale without large files.
+// The fields are functions of the seed alone (the samples are computed in parallel, with the randomness drawn from a counter-based generator),
+// so a grid is reproduced exactly by its description, regardless of the number of threads.
+// A description can be given in place of a file name, in the form:
+//		procedural:<field>[:<key>=<value>]*
+// with the field one of "noise", "sdf", or "voronoi", and the keys those of the Description (e.g. "procedural:voronoi:res=1025:channels=4:seed=3").
+namespace GridGenerator
+{
+	//////////////////
+	// Declarations //
+	//////////////////
+
+	enum Field
+	{
+		NOISE ,		// Fractal value noise in [-1,1], with each channel independent
+		SDF ,		// The signed distance to a union of spheres and boxes, with each channel a different union
+		VORONOI ,	// The negated (soft) distance to the nearest site of the channel's label, so the largest channel gives the label of the nearest site
+		FIELD_COUNT
+	};
+	const std::string FieldNames[] = { "noise" , "sdf" , "voronoi" };
+
+	static const std::string Prefix = "procedural:";
+
+	struct Description
+	{
+		Field field = NOISE;
+		// The dimension of the grid, the number of samples along each dimension, and the number of values per sample
+		unsigned int dim = 2 , res = 257 , channels = 1;
+		unsigned int seed = 0;
+		// The number of lattice cells along each dimension (for the coarsest octave of noise) and the number of octaves
+		unsigned int frequency = 8 , octaves = 4;
+		// The number of primitives (for signed distances) or sites per label (for Voronoi fields)
+		unsigned int count = 16;
+		// The width over which the distances to the nearest sites are blended (zero for the exact distance)
+		double softness = 0;
+		// If non-zero, values are snapped to multiples of 1/levels, so that many samples are exactly zero and (for Voronoi fields) many labels tie
+		unsigned int levels = 0;
+
+		// Parses the description from a string of the form "procedural:<field>[:<key>=<value>]*"
+		static Description Parse( std::string str );
+
+		// Returns the description as a string of the form "procedural:<field>[:<key>=<value>]*"
+		std::string toString( void ) const;
+	};
+
+	// Returns true if the string is the description of a procedural grid rather than the name of a file
+	inline bool IsProcedural( std::string fileName );
+
+	// Generates the field, together with the transformation taking grid coordinates to the unit cube
+	// [NOTE] For integer data types, the values are scaled before they are rounded (and clamped to the range of the type)
+	template< unsigned int Dim , typename Data , typename Real >
+	void Generate( const Description &description , RegularGrid< Dim , Data > &grid , XForm< Real , Dim+1 > &gridToWorld , double scale=1. );
+
+	/////////////////
+	// Definitions //
+	/////////////////
+
+	inline bool IsProcedural( std::string fileName ){ return fileName.compare( 0 , Prefix.size() , Prefix )==0; }
+
+	inline Description Description::Parse( std::string str )
+	{
+		if( !IsProcedural( str ) ) THROW( "Not a procedural grid: " , str );
+		std::vector< std::string > tokens;
+		{
+			std::stringstream ss( str.substr( Prefix.size() ) );
+			std::string token;
+			while( std::getline( ss , token , ':' ) ) tokens.push_back( token );
+		}
+		if( !tokens.size() ) THROW( "Expected field: " , str );
+
+		Description description;
+		unsigned int f = 0;
+		while( f<FIELD_COUNT && FieldNames[f]!=tokens[0] ) f++;
+		if( f==FIELD_COUNT ) THROW( "Unrecognized field: " , tokens[0] );
+		description.field = (Field)f;
+
+		for( unsigned int i=1 ; i<tokens.size() ; i++ )
+		{
+			size_t pos = tokens[i].find( '=' );
+			if( pos==std::string::npos ) THROW( "Expected <key>=<value>: " , tokens[i] );
+			std::string key = tokens[i].substr( 0 , pos ) , value = tokens[i].substr( pos+1 );
+			if     ( key=="dim"       ) description.dim       = std::stoi( value );
+			else if( key=="res"       ) description.res       = std::stoi( value );
+			else if( key=="channels"  ) description.channels  = std::stoi( value );
+			else if( key=="seed"      ) description.seed      = (unsigned int)std::stoul( value );
+			else if( key=="frequency" ) description.frequency = std::stoi( value );
+			else if( key=="octaves"   ) description.octaves   = std::stoi( value );
+			else if( key=="count"     ) description.count     = std::stoi( value );
+			else if( key=="softness"  ) description.softness  = std::stod( value );
+			else if( key=="levels"    ) description.levels    = std::stoi( value );
+			else THROW( "Unrecognized key: " , key );
+		}
+		return description;
+	}
+
+	inline std::string Description::toString( void ) const
+	{
+		std::stringstream ss;
+		ss << Prefix << FieldNames[field] << ":dim=" << dim << ":res=" << res << ":channels=" << channels << ":seed=" << seed;
+		switch( field )
+		{
+			case NOISE:   ss << ":frequency=" << frequency << ":octaves=" << octaves ; break;
+			case SDF:     ss << ":count=" << count                                   ; break;
+			case VORONOI: ss << ":count=" << count << ":softness=" << softness        ; break;
+			default: ERROR_OUT( "Unrecognized field: " , field );
+		}
+		if( levels ) ss << ":levels=" << levels;
+		return ss.str();
+	}
+
+	// Returns value noise at the position, interpolating pseudo-random values at the corners of a lattice with the prescribed number of cells along each dimension
+	template< unsigned int Dim >
+	double _ValueNoise( Point< double , Dim > p , unsigned int frequency , Philox::Key key , unsigned int channel )
+	{
+		long long cell[Dim];
+		double t[Dim];
+		for( unsigned int d=0 ; d<Dim ; d++ )
+		{
+			double x = p[d] * frequency;
+			cell[d] = std::max< long long >( 0 , std::min< long long >( (long long)floor( x ) , (long long)frequency-1 ) );
+			t[d] = x - cell[d];
+			t[d] = t[d] * t[d] * ( 3. - 2. * t[d] );
+		}
+
+		double value = 0;
+		for( unsigned int c=0 ; c<(1u<<Dim) ; c++ )
+		{
+			double weight = 1.;
+			unsigned long long index = 0;
+			for( int d=Dim-1 ; d>=0 ; d-- )
+			{
+				unsigned int b = ( c>>d ) & 1;
+				weight *= b ? t[d] : 1.-t[d];
+				index = index * ( frequency+1 ) + cell[d] + b;
+			}
+			value += weight * ( 2. * Philox::Uniform( key , index , channel ) - 1. );
+		}
+		return value;
+	}
+
+	template< unsigned int Dim >
+	struct _Primitive
+	{
+		bool sphere;
+		Point< double , Dim > center , size;
+
+		double distance( Point< double , Dim > p ) const
+		{
+			if( sphere ) return sqrt( ( p - center ).squareNorm() ) - size[0];
+			// The distance to a box is the length of the positive part of the offsets outside the slabs plus the (non-positive) largest offset
+			double outside = 0 , inside = -std::numeric_limits< double >::infinity();
+			for( unsigned int d=0 ; d<Dim ; d++ )
+			{
+				double q = fabs( p[d] - center[d] ) - size[d];
+				if( q>0 ) outside += q * q;
+				inside = std::max< double >( inside , q );
+			}
+			return sqrt( outside ) + std::min< double >( inside , 0. );
+		}
+	};
+
+	template< unsigned int Dim , typename Data , typename Real >
+	void Generate( const Description &description , RegularGrid< Dim , Data > &grid , XForm< Real , Dim+1 > &gridToWorld , double scale )
+	{
+		using Traits = TiledGrid::_DataTraits< Data >;
+		using Scalar = typename Traits::Real;
+		static const unsigned int N = Traits::Channels;
+
+		if( description.dim!=Dim ) THROW( "Dimensions don't match: " , description.dim , " != " , Dim );
+		if( description.channels!=N ) THROW( "Channel counts don't match: " , description.channels , " != " , N );
+		if( description.res<2 ) THROW( "Resolution must be at least two: " , description.res );
+		const unsigned int res = description.res;
+
+		gridToWorld = XForm< Real , Dim+1 >::Identity();
+		for( unsigned int d=0 ; d<Dim ; d++ ) gridToWorld(d,d) = (Real)( 1. / ( res-1 ) );
+
+		// The primitives (for signed distances) or sites (for Voronoi fields) of each channel
+		std::vector< _Primitive< Dim > > primitives[N];
+		if( description.field==SDF || description.field==VORONOI ) for( unsigned int n=0 ; n<N ; n++ )
+		{
+			Philox::Key key = Philox::MakeKey( description.seed , n );
+			primitives[n].resize( description.count );
+			for( unsigned int i=0 ; i<description.count ; i++ )
+			{
+				_Primitive< Dim > &primitive = primitives[n][i];
+				primitive.sphere = Philox::Uniform( key , i , 0 )<0.5;
+				for( unsigned int d=0 ; d<Dim ; d++ )
+				{
+					primitive.center[d] = Philox::Uniform( key , i , 1+d );
+					primitive.size[d] = 0.05 + 0.15 * Philox::Uniform( key , i , 1+Dim+d );
+				}
+			}
+		}
+
+		// The value of the n-th channel at the position
+		auto Value = [&]( Point< double , Dim > p , unsigned int n )
+			{
+				double value = 0;
+				switch( description.field )
+				{
+				case NOISE:
+				{
+					double amplitude = 1. , totalAmplitude = 0;
+					for( unsigned int o=0 ; o<description.octaves ; o++ , amplitude /= 2 )
+					{
+						value += amplitude * _ValueNoise< Dim >( p , description.frequency<<o , Philox::MakeKey( description.seed , o ) , n );
+						totalAmplitude += amplitude;
+					}
+					if( totalAmplitude ) value /= totalAmplitude;
+					break;
+				}
+				case SDF:
+					value = std::numeric_limits< double >::infinity();
+					for( unsigned int i=0 ; i<primitives[n].size() ; i++ ) value = std::min< double >( value , primitives[n][i].distance( p ) );
+					break;
+				case VORONOI:
+				{
+					// The soft minimum of the distances, min - s * log( sum exp( -( d - min ) / s ) ), computed relative to the minimum for stability
+					double minDistance = std::numeric_limits< double >::infinity();
+					for( unsigned int i=0 ; i<primitives[n].size() ; i++ ) minDistance = std::min< double >( minDistance , sqrt( ( p - primitives[n][i].center ).squareNorm() ) );
+					value = minDistance;
+					if( description.softness>0 )
+					{
+						double sum = 0;
+						for( unsigned int i=0 ; i<primitives[n].size() ; i++ ) sum += exp( -( sqrt( ( p - primitives[n][i].center ).squareNorm() ) - minDistance ) / description.softness );
+						value -= description.softness * log( sum );
+					}
+					value = -value;
+					break;
+				}
+				default: ERROR_OUT( "Unrecognized field: " , description.field );
+				}
+				if( description.levels ) value = std::round( value * description.levels ) / description.levels;
+				return value;
+			};
+
+		// Converts the value to the scalar type of the grid
+		auto Convert = [&]( double value )
+			{
+				if constexpr( std::is_integral_v< Scalar > )
+				{
+					value = std::round( value * scale );
+					value = std::max< double >( (double)std::numeric_limits< Scalar >::lowest() , std::min< double >( (double)std::numeric_limits< Scalar >::max() , value ) );
+				}
+				return (Scalar)value;
+			};
+
+		unsigned int _res[Dim];
+		for( unsigned int d=0 ; d<Dim ; d++ ) _res[d] = res;
+		grid.resize( _res );
+#pragma omp parallel for
+		for( long long i=0 ; i<(long long)grid.resolution() ; i++ )
+		{
+			// The position of the sample in the unit cube, with the first dimension varying fastest
+			Point< double , Dim > p;
+			long long _i = i;
+			for( unsigned int d=0 ; d<Dim ; d++ ) p[d] = (double)( _i % res ) / ( res-1 ) , _i /= res;
+			for( unsigned int n=0 ; n<N ; n++ ) Traits::Channel( grid[i] , n ) = Convert( Value( p , n ) );
+		}
+	}
+}
+
+#endif // GRID_GENERATOR_INCLUDED
@@ -0,0 +1,323 @@
+#ifndef GRID_OPERATORS_INCLUDED
+#define GRID_OPERATORS_INCLUDED
+
+#include <cmath>
+#include <vector>
+#include <limits>
+#include "Misha/Geometry.h"
+#include "Misha/RegularGrid.h"
+#include "Philox.h"
+#include "BlockedGrid.h"
+#include "Instrumentation.h"
+
+// Operators applied to grids of N-dimensional values, shared by the grid processing tools
+namespace GridOperators
+{
+	//////////////////
+	// Declarations //
+	//////////////////
+
+	// Scales the value so that its coordinates sum to one
+	template< unsigned int N > void Normalize( Point< double , N > &v );
+
+	// Adds uniform noise in the range [-magnitude,magnitude] to each coordinate of the value
+	// [NOTE] The noise is a function of the key, the index of the sample, and the coordinate, so it does not depend on the order in which samples are processed
+	template< unsigned int N > void Jitter( Point< double , N > &v , double magnitude , Philox::Key key , size_t index );
+
+	// Returns the index of the largest coordinate of the value
+	template< unsigned int N > unsigned int Discretize( const Point< double , N > &v );
+
+	// Returns the (normalized) binomial kernel of radius r
+	// [NOTE] The kernel of radius r is the r-fold convolution of the kernel { 1/4 , 1/2 , 1/4 }
+	inline std::vector< double > BinomialKernel( unsigned int r );
+
+	// Convolves the grid along the prescribed dimension, renormalizing the kernel where it overlaps the boundary
+	// [NOTE] The lines along the dimension are processed in parallel
+	template< unsigned int Dim , unsigned int N >
+	void Smooth( const RegularGrid< Dim , Point< double , N > > &in , RegularGrid< Dim , Point< double , N > > &out , unsigned int d , const std::vector< double > &kernel );
+
+	// Smooths the grid by applying the separable kernel the prescribed number of times, one dimension at a time
+	// [NOTE] The passes ping-pong between the grid and a single scratch grid
+	template< unsigned int Dim , unsigned int N >
+	void Smooth( RegularGrid< Dim , Point< double , N > > &grid , const std::vector< double > &kernel , unsigned int iterations );
+
+	// Convolves the blocked grid along the prescribed dimension, renormalizing the kernel where it overlaps the boundary
+	// [NOTE] The blocks are processed in parallel, so the samples read are in the block or in its neighbors along the dimension
+	template< unsigned int Dim , unsigned int N >
+	void Smooth( const BlockedGrid::Grid< Dim , Point< double , N > > &in , BlockedGrid::Grid< Dim , Point< double , N > > &out , unsigned int d , const std::vector< double > &kernel );
+
+	// Smooths the grid as above, storing the grid block by block while smoothing
+	template< unsigned int Dim , unsigned int N >
+	void Smooth( RegularGrid< Dim , Point< double , N > > &grid , const std::vector< double > &kernel , unsigned int iterations , unsigned int blockSize );
+
+	// Returns the distances between adjacent samples along each dimension, in world coordinates
+	// [NOTE] If the transformation is degenerate (e.g. that of a discretized grid, whose entries were truncated to integers) unit spacing is returned
+	template< unsigned int Dim >
+	void Spacing( const XForm< double , Dim+1 > &xForm , double spacing[Dim] );
+
+	// Replaces each value by the squared Euclidean distance to the nearest sample with zero value (or infinity if there is none)
+	// [NOTE] The input values are expected to be either zero or infinity
+	// [NOTE] This is the separable, linear-time, transform of Felzenszwalb and Huttenlocher, with the lines along each dimension processed in parallel
+	template< unsigned int Dim >
+	void SquaredDistanceTransform( RegularGrid< Dim , double > &grid , const double spacing[Dim] );
+
+	// Returns the signed Euclidean distance from each sample to the nearest sample on the other side, negative on the inside
+	// [NOTE] The functor takes the linear index of a sample and returns true if it is inside
+	template< unsigned int Dim , typename InsideFunctor /* = std::function< bool ( size_t ) > */ >
+	RegularGrid< Dim , double > SignedDistance( const unsigned int res[Dim] , InsideFunctor inside , const double spacing[Dim] );
+
+	/////////////////
+	// Definitions //
+	/////////////////
+
+	// Returns the starting indices of the lines along the prescribed dimension and the offset between consecutive samples on a line
+	template< unsigned int Dim , typename Data >
+	std::vector< typename RegularGrid< Dim >::Index > _Lines( const RegularGrid< Dim , Data > &grid , unsigned int d , ptrdiff_t &stride )
+	{
+		typename RegularGrid< Dim >::Range lineRange;
+		for( unsigned int dd=0 ; dd<Dim ; dd++ ) lineRange.first[dd] = 0 , lineRange.second[dd] = grid.res(dd);
+		lineRange.second[d] = 1;
+		std::vector< typename RegularGrid< Dim >::Index > lines;
+		lines.reserve( lineRange.size() );
+		lineRange.process( [&]( typename RegularGrid< Dim >::Index I ){ lines.push_back( I ); } );
+
+		typename RegularGrid< Dim >::Index I , e;
+		e[d] = 1;
+		stride = grid.res(d)>1 ? &grid( I+e ) - &grid( I ) : 0;
+		return lines;
+	}
+
+	template< unsigned int N >
+	void Normalize( Point< double , N > &v )
+	{
+		double sum = 0;
+		for( unsigned int n=0 ; n<N ; n++ ) sum += v[n];
+		for( unsigned int n=0 ; n<N ; n++ ) v[n] /= sum;
+	}
+
+	template< unsigned int N >
+	void Jitter( Point< double , N > &v , double magnitude , Philox::Key key , size_t index )
+	{
+		const double m = fabs(magnitude);
+#pragma omp simd
+		for( unsigned int n=0 ; n<N ; n++ ) v[n] += m * ( 2. * Philox::Uniform( key , index , n ) - 1. );
+	}
+
+	template< unsigned int N >
+	unsigned int Discretize( const Point< double , N > &v )
+	{
+		unsigned int n=0;
+		for( unsigned int _n=0 ; _n<N ; _n++ ) if( v[_n]>v[n] ) n = _n;
+		return n;
+	}
+
+	inline std::vector< double > BinomialKernel( unsigned int r )
+	{
+		// The weights are Choose( 2r , i ) / 4^r, computed through the logarithm of the Gamma function since the binomial coefficients overflow a double for r>514
+		std::vector< double > kernel( 2*r+1 );
+		double sum = 0 , logNormalization = std::lgamma( 2.*r+1 ) - 2.*r*std::log( 2. );
+		for( unsigned int i=0 ; i<=2*r ; i++ ) kernel[i] = std::exp( logNormalization - std::lgamma( i+1. ) - std::lgamma( 2.*r-i+1 ) );
+		for( unsigned int i=0 ; i<=2*r ; i++ ) sum += kernel[i];
+		for( unsigned int i=0 ; i<=2*r ; i++ ) kernel[i] /= sum;
+		return kernel;
+	}
+
+	template< unsigned int Dim , unsigned int N >
+	void Smooth( const RegularGrid< Dim , Point< double , N > > &in , RegularGrid< Dim , Point< double , N > > &out , unsigned int d , const std::vector< double > &kernel )
+	{
+		int r = (int)kernel.size()/2 , res = in.res(d);
+		if( res==1 )
+		{
+			for( size_t i=0 ; i<in.resolution() ; i++ ) out[i] = in[i];
+			return;
+		}
+
+		ptrdiff_t stride;
+		std::vector< typename RegularGrid< Dim >::Index > lines = _Lines( in , d , stride );
+
+#pragma omp parallel
+		{
+			Instrumentation::Scope scope( "smooth pass" );
+#pragma omp for
+			for( int l=0 ; l<(int)lines.size() ; l++ )
+			{
+				const Point< double , N > *_in = &in( lines[l] );
+				Point< double , N > *_out = &out( lines[l] );
+				for( int i=0 ; i<res ; i++ )
+				{
+					int start = std::max< int >( 0 , i-r ) , end = std::min< int >( res-1 , i+r );
+					double sum[N] , wSum = 0;
+					for( unsigned int n=0 ; n<N ; n++ ) sum[n] = 0;
+					for( int j=start ; j<=end ; j++ )
+					{
+						const double w = kernel[j-i+r];
+						const Point< double , N > &p = _in[ j*stride ];
+#pragma omp simd
+						for( unsigned int n=0 ; n<N ; n++ ) sum[n] += p[n] * w;
+						wSum += w;
+					}
+					Point< double , N > &q = _out[ i*stride ];
+					for( unsigned int n=0 ; n<N ; n++ ) q[n] = sum[n] / wSum;
+				}
+			}
+		}
+	}
+
+	template< unsigned int Dim , unsigned int N >
+	void Smooth( RegularGrid< Dim , Point< double , N > > &grid , const std::vector< double > &kernel , unsigned int iterations )
+	{
+		RegularGrid< Dim , Point< double , N > > scratch;
+		scratch.resize( grid.res() );
+		RegularGrid< Dim , Point< double , N > > *in = &grid , *out = &scratch;
+		for( unsigned int i=0 ; i<iterations ; i++ ) for( unsigned int d=0 ; d<Dim ; d++ )
+		{
+			Smooth( *in , *out , d , kernel );
+			std::swap( in , out );
+		}
+		if( in!=&grid )
+		{
+#pragma omp parallel for
+			for( long long i=0 ; i<(long long)grid.resolution() ; i++ ) grid[i] = (*in)[i];
+		}
+	}
+
+	template< unsigned int Dim , unsigned int N >
+	void Smooth( const BlockedGrid::Grid< Dim , Point< double , N > > &in , BlockedGrid::Grid< Dim , Point< double , N > > &out , unsigned int d , const std::vector< double > &kernel )
+	{
+		int r = (int)kernel.size()/2 , res = in.res(d);
+		std::vector< typename RegularGrid< Dim >::Range > blocks = in.blocks();
+
+#pragma omp parallel
+		{
+			Instrumentation::Scope scope( "smooth pass" );
+#pragma omp for schedule( dynamic )
+			for( long long b=0 ; b<(long long)blocks.size() ; b++ ) BlockedGrid::ProcessRange< Dim >( blocks[b] , [&]( typename RegularGrid< Dim >::Index I )
+				{
+					int i = I[d] , start = std::max< int >( 0 , i-r ) , end = std::min< int >( res-1 , i+r );
+					double sum[N] , wSum = 0;
+					for( unsigned int n=0 ; n<N ; n++ ) sum[n] = 0;
+					typename RegularGrid< Dim >::Index J = I;
+					for( int j=start ; j<=end ; j++ )
+					{
+						J[d] = j;
+						const double w = kernel[j-i+r];
+						const Point< double , N > &p = in( J );
+#pragma omp simd
+						for( unsigned int n=0 ; n<N ; n++ ) sum[n] += p[n] * w;
+						wSum += w;
+					}
+					Point< double , N > &q = out( I );
+					for( unsigned int n=0 ; n<N ; n++ ) q[n] = sum[n] / wSum;
+				} );
+		}
+	}
+
+	template< unsigned int Dim , unsigned int N >
+	void Smooth( RegularGrid< Dim , Point< double , N > > &grid , const std::vector< double > &kernel , unsigned int iterations , unsigned int blockSize )
+	{
+		BlockedGrid::Grid< Dim , Point< double , N > > blocked , scratch;
+		blocked.set( grid , blockSize );
+		scratch.resize( grid.res() , blockSize );
+		BlockedGrid::Grid< Dim , Point< double , N > > *in = &blocked , *out = &scratch;
+		for( unsigned int i=0 ; i<iterations ; i++ ) for( unsigned int d=0 ; d<Dim ; d++ )
+		{
+			Smooth( *in , *out , d , kernel );
+			std::swap( in , out );
+		}
+		in->get( grid );
+	}
+
+	template< unsigned int Dim >
+	void Spacing( const XForm< double , Dim+1 > &xForm , double spacing[Dim] )
+	{
+		for( unsigned int d=0 ; d<Dim ; d++ )
+		{
+			spacing[d] = 0;
+			for( unsigned int dd=0 ; dd<Dim ; dd++ ) spacing[d] += xForm(d,dd) * xForm(d,dd);
+			spacing[d] = sqrt( spacing[d] );
+		}
+		bool degenerate = false;
+		for( unsigned int d=0 ; d<Dim ; d++ ) if( !( spacing[d]>0 ) || !std::isfinite( spacing[d] ) ) degenerate = true;
+		if( degenerate )
+		{
+			WARN( "Degenerate grid-to-world transformation, using unit spacing" );
+			for( unsigned int d=0 ; d<Dim ; d++ ) spacing[d] = 1.;
+		}
+	}
+
+	template< unsigned int Dim >
+	void SquaredDistanceTransform( RegularGrid< Dim , double > &grid , const double spacing[Dim] )
+	{
+		const double Infinity = std::numeric_limits< double >::infinity();
+		for( unsigned int d=0 ; d<Dim ; d++ ) if( !( spacing[d]>0 ) ) ERROR_OUT( "Spacing must be positive: " , spacing[d] );
+		for( unsigned int d=0 ; d<Dim ; d++ )
+		{
+			const int res = grid.res(d);
+			const double w = spacing[d] * spacing[d];
+			ptrdiff_t stride;
+			std::vector< typename RegularGrid< Dim >::Index > lines = _Lines( grid , d , stride );
+
+#pragma omp parallel
+			{
+				Instrumentation::Scope scope( "distance transform pass" );
+				// The values on the line, the sites of the parabolas in the lower envelope, and the boundaries between them
+				std::vector< double > f( res ) , z( res+1 );
+				std::vector< int > v( res );
+#pragma omp for
+				for( int l=0 ; l<(int)lines.size() ; l++ )
+				{
+					double *values = &grid( lines[l] );
+					for( int q=0 ; q<res ; q++ ) f[q] = values[ q*stride ];
+
+					// Compute the lower envelope of the parabolas rooted at the samples with finite values
+					int k = -1;
+					for( int q=0 ; q<res ; q++ ) if( f[q]!=Infinity )
+					{
+						double s = -Infinity;
+						while( k>=0 )
+						{
+							s = ( ( f[q] + w*q*q ) - ( f[ v[k] ] + w*v[k]*v[k] ) ) / ( 2. * w * ( q - v[k] ) );
+							if( s<=z[k] ) k--;
+							else break;
+						}
+						if( k<0 ) s = -Infinity;
+						k++;
+						v[k] = q , z[k] = s , z[k+1] = Infinity;
+					}
+					if( k<0 ) continue;
+
+					// Evaluate the lower envelope
+					for( int q=0 , j=0 ; q<res ; q++ )
+					{
+						while( z[j+1]<q ) j++;
+						values[ q*stride ] = w * ( q - v[j] ) * ( q - v[j] ) + f[ v[j] ];
+					}
+				}
+			}
+		}
+	}
+
+	template< unsigned int Dim , typename InsideFunctor >
+	RegularGrid< Dim , double > SignedDistance( const unsigned int res[Dim] , InsideFunctor inside , const double spacing[Dim] )
+	{
+		const double Infinity = std::numeric_limits< double >::infinity();
+		RegularGrid< Dim , double > in , out;
+		in.resize( res ) , out.resize( res );
+
+		// Compute the squared distances to the nearest inside and outside samples
+		size_t insideCount = 0;
+#pragma omp parallel for reduction( + : insideCount )
+		for( long long i=0 ; i<(long long)in.resolution() ; i++ )
+			if( inside( (size_t)i ) ) in[i] = 0 , out[i] = Infinity , insideCount++;
+			else                      in[i] = Infinity , out[i] = 0;
+		if( !insideCount || insideCount==in.resolution() ) WARN( "Signed distance is unbounded: " , insideCount , " / " , in.resolution() , " samples inside" );
+		SquaredDistanceTransform( in , spacing );
+		SquaredDistanceTransform( out , spacing );
+
+#pragma omp parallel for
+		for( long long i=0 ; i<(long long)in.resolution() ; i++ ) in[i] = in[i] ? sqrt( in[i] ) : -sqrt( out[i] );
+		return in;
+	}
+}
+
+#endif // GRID_OPERATORS_INCLUDED
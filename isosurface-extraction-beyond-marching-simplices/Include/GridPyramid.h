@@ -0,0 +1,299 @@
+#ifndef GRID_PYRAMID_INCLUDED
+#define GRID_PYRAMID_INCLUDED
+
+#include <stdio.h>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include "Misha/RegularGrid.h"
+#include "TiledGrid.h"
+
+// A multi-resolution pyramid of a scalar grid, together with bounds on the values within each cell.
+// Level l+1 is obtained by taking every other sample of level l (always keeping the last), so that the samples of every level are samples of the finest grid.
+// The bounds of a cell at level l>0 are the minimum and maximum of the samples of the finest grid covered by the cell,
+// and hence also bound the piecewise-linear interpolant of the finest grid over the cell.
+// The file consists of a text header:
+//		P<Dim>
+//		<number of levels>
+//		<resolution of the finest level along dimension 0> ... <resolution of the finest level along dimension Dim-1>
+//		<(Dim+1) lines giving the grid-to-world transformation of the finest level>
+// followed, for each level from coarsest to finest, by the binary (min,max) cell bounds (for levels l>0) and then the binary samples.
+// Since the levels are stored coarse-to-fine, reading the samples of one level only requires reading the bounds of the coarser levels, and skipping their samples.
+namespace GridPyramid
+{
+	// Returns true if the file is a grid pyramid
+	inline bool IsPyramid( std::string fileName )
+	{
+		TiledGrid::_InputFile file( fileName );
+		FILE *fp = file.fp;
+		bool isPyramid = fgetc( fp )=='P';
+		file.close();
+		return isPyramid;
+	}
+
+	// Reads the dimension of the grid
+	inline void ReadDimension( std::string fileName , unsigned int &dim )
+	{
+		TiledGrid::_InputFile file( fileName );
+		FILE *fp = file.fp;
+		if( fscanf( fp , " P%u" , &dim )!=1 ) THROW( "Not a grid pyramid: " , fileName );
+		file.close();
+	}
+
+	template< unsigned int Dim >
+	struct Pyramid
+	{
+		// The samples at each level
+		std::vector< RegularGrid< Dim , double > > values;
+		// The (min,max) bounds of the cells at each level
+		// [NOTE] The bounds are not stored for the finest level
+		std::vector< RegularGrid< Dim , Point< double , 2 > > > bounds;
+
+		Pyramid( void ){}
+
+		// Builds the pyramid, coarsening until there is at most one cell along each dimension
+		Pyramid( const RegularGrid< Dim , double > &grid );
+
+		unsigned int levels( void ) const { return (unsigned int)_res.size(); }
+
+		// The resolution of the samples at the prescribed level
+		unsigned int res( unsigned int l , unsigned int d ) const { return _res[l][d]; }
+
+		// Returns the position, in the coordinates of the finest grid, of a sample at the prescribed level
+		Point< double , Dim > position( unsigned int l , typename RegularGrid< Dim >::Index I ) const
+		{
+			Point< double , Dim > p;
+			for( unsigned int d=0 ; d<Dim ; d++ ) p[d] = std::min< int >( I[d]<<l , _res[0][d]-1 );
+			return p;
+		}
+
+		// Returns the coarsest level whose cells are no larger than the tolerance (in world coordinates)
+		unsigned int level( const XForm< double , Dim+1 > &xForm , double tolerance ) const;
+
+		// Calls the functor for each cell at the prescribed level whose ancestors' bounds contain the iso-value, refining from the coarsest level
+		// [NOTE] Only the bounds of the levels coarser than the prescribed one are used
+		template< typename CellFunctor /* = std::function< void ( typename RegularGrid< Dim >::Index ) > */ >
+		void processActiveCells( unsigned int level , double isoValue , CellFunctor f ) const;
+
+		void write( std::string fileName , const XForm< double , Dim+1 > &xForm ) const;
+
+		// Reads the number of levels, their resolutions, and the transformation, without reading the samples or bounds
+		void readHeader( std::string fileName , XForm< double , Dim+1 > &xForm );
+
+		// Reads the samples of the prescribed level and the bounds of the coarser levels (as needed by processActiveCells)
+		// [NOTE] The samples of the other levels and the bounds of the prescribed and finer levels are left empty
+		void read( std::string fileName , XForm< double , Dim+1 > &xForm , unsigned int level=0 );
+
+	protected:
+		std::vector< typename RegularGrid< Dim >::Index > _res;
+
+		// The range of cells at level l-1 covered by a cell at level l
+		typename RegularGrid< Dim >::Range _children( unsigned int l , typename RegularGrid< Dim >::Index I ) const
+		{
+			typename RegularGrid< Dim >::Range r;
+			for( unsigned int d=0 ; d<Dim ; d++ ) r.first[d] = 2*I[d] , r.second[d] = std::min< int >( 2*I[d]+2 , _res[l-1][d]-1 );
+			return r;
+		}
+
+		void _setLevel( unsigned int l );
+		void _readHeader( FILE *fp , std::string fileName , XForm< double , Dim+1 > &xForm );
+	};
+
+	////////////////////////////
+	// Pyramid Implementation //
+	////////////////////////////
+
+	template< unsigned int Dim >
+	Pyramid< Dim >::Pyramid( const RegularGrid< Dim , double > &grid )
+	{
+		typename RegularGrid< Dim >::Index res;
+		for( unsigned int d=0 ; d<Dim ; d++ ) res[d] = grid.res(d);
+		_res.push_back( res );
+		values.push_back( grid );
+		bounds.push_back( RegularGrid< Dim , Point< double , 2 > >() );
+
+		auto Coarsen = [&]( void )
+			{
+				bool coarsen = false;
+				for( unsigned int d=0 ; d<Dim ; d++ ) if( res[d]>2 ) coarsen = true;
+				for( unsigned int d=0 ; d<Dim ; d++ ) res[d] = res[d]/2 + 1;
+				return coarsen;
+			};
+		while( Coarsen() )
+		{
+			_res.push_back( res );
+			_setLevel( (unsigned int)_res.size()-1 );
+		}
+	}
+
+	template< unsigned int Dim >
+	void Pyramid< Dim >::_setLevel( unsigned int l )
+	{
+		unsigned int res[Dim] , cellRes[Dim];
+		for( unsigned int d=0 ; d<Dim ; d++ ) res[d] = _res[l][d] , cellRes[d] = std::max< int >( _res[l][d]-1 , 0 );
+		values.resize( l+1 ) , bounds.resize( l+1 );
+		values[l].resize( res );
+		bounds[l].resize( cellRes );
+
+		std::vector< typename RegularGrid< Dim >::Index > samples , cells;
+		typename RegularGrid< Dim >::Range sampleRange , cellRange;
+		for( unsigned int d=0 ; d<Dim ; d++ ) sampleRange.first[d] = cellRange.first[d] = 0 , sampleRange.second[d] = res[d] , cellRange.second[d] = cellRes[d];
+		sampleRange.process( [&]( typename RegularGrid< Dim >::Index I ){ samples.push_back( I ); } );
+		cellRange.process( [&]( typename RegularGrid< Dim >::Index I ){ cells.push_back( I ); } );
+
+		// Take every other sample of the finer level
+#pragma omp parallel for
+		for( long long i=0 ; i<(long long)samples.size() ; i++ )
+		{
+			typename RegularGrid< Dim >::Index I = samples[i] , _I;
+			for( unsigned int d=0 ; d<Dim ; d++ ) _I[d] = std::min< int >( 2*I[d] , _res[l-1][d]-1 );
+			values[l]( I ) = values[l-1]( _I );
+		}
+
+		// Merge the bounds of the finer cells (or the samples of the finest level)
+#pragma omp parallel for
+		for( long long i=0 ; i<(long long)cells.size() ; i++ )
+		{
+			typename RegularGrid< Dim >::Range children = _children( l , cells[i] );
+			Point< double , 2 > b;
+			b[0] = std::numeric_limits< double >::infinity() , b[1] = -std::numeric_limits< double >::infinity();
+			if( l==1 )
+			{
+				typename RegularGrid< Dim >::Range corners = children;
+				for( unsigned int d=0 ; d<Dim ; d++ ) corners.second[d]++;
+				corners.process( [&]( typename RegularGrid< Dim >::Index J ){ b[0] = std::min< double >( b[0] , values[0](J) ) , b[1] = std::max< double >( b[1] , values[0](J) ); } );
+			}
+			else children.process( [&]( typename RegularGrid< Dim >::Index J ){ b[0] = std::min< double >( b[0] , bounds[l-1](J)[0] ) , b[1] = std::max< double >( b[1] , bounds[l-1](J)[1] ); } );
+			bounds[l]( cells[i] ) = b;
+		}
+	}
+
+	template< unsigned int Dim >
+	unsigned int Pyramid< Dim >::level( const XForm< double , Dim+1 > &xForm , double tolerance ) const
+	{
+		// The largest distance between adjacent samples of the finest level
+		double spacing = 0;
+		for( unsigned int d=0 ; d<Dim ; d++ )
+		{
+			double s = 0;
+			for( unsigned int dd=0 ; dd<Dim ; dd++ ) s += xForm(d,dd) * xForm(d,dd);
+			spacing = std::max< double >( spacing , sqrt(s) );
+		}
+		unsigned int l = 0;
+		while( l+1<levels() && spacing * ( 1<<(l+1) )<=tolerance ) l++;
+		return l;
+	}
+
+	template< unsigned int Dim >
+	template< typename CellFunctor >
+	void Pyramid< Dim >::processActiveCells( unsigned int level , double isoValue , CellFunctor f ) const
+	{
+		if( level>=levels() ) ERROR_OUT( "Level out of bounds: " , level , " >= " , levels() );
+
+		auto Process = [&]( auto &Process , unsigned int l , typename RegularGrid< Dim >::Index I ) -> void
+			{
+				if( l==level ) f( I );
+				else if( bounds[l](I)[0]<=isoValue && bounds[l](I)[1]>=isoValue )
+					_children( l , I ).process( [&]( typename RegularGrid< Dim >::Index J ){ Process( Process , l-1 , J ); } );
+			};
+
+		unsigned int top = levels()-1;
+		typename RegularGrid< Dim >::Range cellRange;
+		for( unsigned int d=0 ; d<Dim ; d++ ) cellRange.first[d] = 0 , cellRange.second[d] = std::max< int >( _res[top][d]-1 , 0 );
+		cellRange.process( [&]( typename RegularGrid< Dim >::Index I ){ Process( Process , top , I ); } );
+	}
+
+	template< unsigned int Dim >
+	void Pyramid< Dim >::write( std::string fileName , const XForm< double , Dim+1 > &xForm ) const
+	{
+		FILE *fp = fopen( fileName.c_str() , "wb" );
+		if( !fp ) ERROR_OUT( "Could not open file for writing: " , fileName );
+		fprintf( fp , "P%u\n" , Dim );
+		fprintf( fp , "%u\n" , levels() );
+		for( unsigned int d=0 ; d<Dim ; d++ ) fprintf( fp , d ? " %u" : "%u" , (unsigned int)_res[0][d] );
+		fprintf( fp , "\n" );
+		for( unsigned int j=0 ; j<=Dim ; j++ )
+		{
+			for( unsigned int i=0 ; i<=Dim ; i++ ) fprintf( fp , i ? " %.17g" : "%.17g" , xForm(i,j) );
+			fprintf( fp , "\n" );
+		}
+		for( int l=(int)levels()-1 ; l>=0 ; l-- )
+		{
+			if( l && bounds[l].resolution() && fwrite( &bounds[l][0] , sizeof( Point< double , 2 > ) , bounds[l].resolution() , fp )!=bounds[l].resolution() ) ERROR_OUT( "Failed to write bounds: " , l );
+			if( values[l].resolution() && fwrite( &values[l][0] , sizeof(double) , values[l].resolution() , fp )!=values[l].resolution() ) ERROR_OUT( "Failed to write samples: " , l );
+		}
+		fclose( fp );
+	}
+
+	template< unsigned int Dim >
+	void Pyramid< Dim >::_readHeader( FILE *fp , std::string fileName , XForm< double , Dim+1 > &xForm )
+	{
+		unsigned int dim , levels;
+		if( fscanf( fp , " P%u" , &dim )!=1 ) THROW( "Not a grid pyramid: " , fileName );
+		if( dim!=Dim ) THROW( "Grid dimensions don't match: " , dim , " != " , Dim );
+		if( fscanf( fp , " %u" , &levels )!=1 || !levels ) THROW( "Failed to read the number of levels: " , fileName );
+		typename RegularGrid< Dim >::Index res;
+		for( unsigned int d=0 ; d<Dim ; d++ ) if( fscanf( fp , " %d" , &res[d] )!=1 ) THROW( "Failed to read the resolution: " , fileName );
+		for( unsigned int j=0 ; j<=Dim ; j++ ) for( unsigned int i=0 ; i<=Dim ; i++ ) if( fscanf( fp , " %lf" , &xForm(i,j) )!=1 ) THROW( "Failed to read the transformation: " , fileName );
+		// Consume the new-line preceding the binary data
+		if( fgetc( fp )!='\n' ) THROW( "Malformed header: " , fileName );
+
+		_res.resize( levels );
+		for( unsigned int l=0 ; l<levels ; l++ )
+		{
+			if( l ) for( unsigned int d=0 ; d<Dim ; d++ ) res[d] = res[d]/2 + 1;
+			_res[l] = res;
+		}
+		values.resize( 0 ) , bounds.resize( 0 );
+		values.resize( levels ) , bounds.resize( levels );
+	}
+
+	template< unsigned int Dim >
+	void Pyramid< Dim >::readHeader( std::string fileName , XForm< double , Dim+1 > &xForm )
+	{
+		TiledGrid::_InputFile file( fileName );
+		FILE *fp = file.fp;
+		_readHeader( fp , fileName , xForm );
+		file.close();
+	}
+
+	template< unsigned int Dim >
+	void Pyramid< Dim >::read( std::string fileName , XForm< double , Dim+1 > &xForm , unsigned int level )
+	{
+		TiledGrid::_InputFile file( fileName );
+		FILE *fp = file.fp;
+		_readHeader( fp , fileName , xForm );
+		if( level>=levels() ) THROW( "Level out of bounds: " , level , " >= " , levels() );
+
+		long long position = TiledGrid::_Tell( fp );
+		if( position<0 ) THROW( "Failed to get file position: " , fileName );
+		for( unsigned int l=levels()-1 ; l>=level ; l-- )
+		{
+			unsigned int res[Dim] , cellRes[Dim];
+			size_t sampleCount = 1 , cellCount = l ? 1 : 0;
+			for( unsigned int d=0 ; d<Dim ; d++ ) res[d] = _res[l][d] , cellRes[d] = std::max< int >( _res[l][d]-1 , 0 ) , sampleCount *= res[d] , cellCount *= cellRes[d];
+
+			// Read the bounds of the coarser levels and skip those of the prescribed level
+			if( l>level )
+			{
+				bounds[l].resize( cellRes );
+				if( cellCount && fread( &bounds[l][0] , sizeof( Point< double , 2 > ) , cellCount , fp )!=cellCount ) THROW( "Failed to read bounds: " , l );
+			}
+			position += (long long)( cellCount * sizeof( Point< double , 2 > ) );
+
+			// Read the samples of the prescribed level and skip those of the coarser levels
+			if( l==level )
+			{
+				if( !TiledGrid::_Seek( fp , position ) ) THROW( "Failed to seek samples: " , l );
+				values[l].resize( res );
+				if( sampleCount && fread( &values[l][0] , sizeof(double) , sampleCount , fp )!=sampleCount ) THROW( "Failed to read samples: " , l );
+				break;
+			}
+			position += (long long)( sampleCount * sizeof(double) );
+			if( !TiledGrid::_Seek( fp , position ) ) THROW( "Failed to seek bounds: " , l-1 );
+		}
+		file.close();
+	}
+}
+
+#endif // GRID_PYRAMID_INCLUDED
@@ -2,37 +2,139 @@
 #define GRID_READER_INCLUDED
 
 #include "Misha/RegularGrid.h"
+#include "TiledGrid.h"
+#include "QuantizedGrid.h"
+#include "GridPyramid.h"
+#include "GridGenerator.h"
 
 template< unsigned int Dim , unsigned int ... Ns > struct GridReader;
 
+// Reads the dimension of the grid, for dense, tiled, quantized, pyramid, and procedural grids
+inline void ReadGridDimension( std::string fileName , unsigned int &dim )
+{
+	if     ( GridGenerator::IsProcedural( fileName ) ) dim = GridGenerator::Description::Parse( fileName ).dim;
+	else if( TiledGrid::IsTiled( fileName ) ) TiledGrid::ReadDimension( fileName , dim );
+	else if( QuantizedGrid::IsQuantized( fileName ) ) QuantizedGrid::ReadDimension( fileName , dim );
+	else if( GridPyramid::IsPyramid( fileName ) ) GridPyramid::ReadDimension( fileName , dim );
+	else RegularGrid< 0 >::ReadDimension( fileName , dim );
+}
+
 template< unsigned int Dim >
 struct GridReader< Dim >
 {
-	static RegularGrid< Dim , double > Read( std::string fileName , XForm< double , Dim+1 > &xForm )
+	// Reads the number of values per sample and the name of the value type, for dense, tiled, quantized, pyramid, and procedural grids
+	// [NOTE] Procedural grids are generated with double-precision values
+	static void ReadHeader( std::string fileName , unsigned int &dataDim , std::string &dataName )
+	{
+		if( GridGenerator::IsProcedural( fileName ) ) dataDim = GridGenerator::Description::Parse( fileName ).channels , dataName = RegularGridDataType< double >::Name;
+		else if( TiledGrid::IsTiled( fileName ) ) TiledGrid::ReadHeader< Dim >( fileName , dataDim , dataName );
+		else if( GridPyramid::IsPyramid( fileName ) ) dataDim = 1 , dataName = RegularGridDataType< double >::Name;
+		else if( QuantizedGrid::IsQuantized( fileName ) )
+		{
+			double scale , offset;
+			QuantizedGrid::ReadHeader< Dim >( fileName , dataDim , dataName , scale , offset );
+		}
+		else RegularGrid< Dim >::ReadHeader( fileName , dataDim , dataName );
+	}
+
+	// Reads the samples of a quantized grid without converting them, together with the scale and offset mapping samples to values
+	template< typename Data , typename Real >
+	static void ReadQuantized( std::string fileName , RegularGrid< Dim , Data > &grid , XForm< Real , Dim+1 > &xForm , double &scale , double &offset , const typename RegularGrid< Dim >::Range *bbox=NULL )
+	{
+		QuantizedGrid::Read( fileName , grid , xForm , scale , offset , bbox );
+	}
+
+	// Reads a quantized grid and converts the samples to values
+	template< typename Quantized , typename Data >
+	static void ReadAndDequantize( std::string fileName , RegularGrid< Dim , Data > &grid , XForm< double , Dim+1 > &xForm , const typename RegularGrid< Dim >::Range *bbox )
+	{
+		using Traits = TiledGrid::_DataTraits< Data >;
+		using QuantizedData = std::conditional_t< Traits::Channels==1 , Quantized , Point< Quantized , Traits::Channels > >;
+		double scale , offset;
+		RegularGrid< Dim , QuantizedData > _grid;
+		ReadQuantized( fileName , _grid , xForm , scale , offset , bbox );
+		grid.resize( _grid.res() );
+#pragma omp parallel for
+		for( long long i=0 ; i<(long long)grid.resolution() ; i++ ) for( unsigned int n=0 ; n<Traits::Channels ; n++ )
+			Traits::Channel( grid[i] , n ) = offset + scale * TiledGrid::_DataTraits< QuantizedData >::Channel( _grid[i] , n );
+	}
+
+	// Restricts the grid to the bounding box, adjusting the transformation so that the sub-grid has the same world coordinates
+	template< typename Data , typename Real >
+	static void Crop( RegularGrid< Dim , Data > &grid , XForm< Real , Dim+1 > &xForm , const typename RegularGrid< Dim >::Range &bbox )
+	{
+		typename RegularGrid< Dim >::Range range;
+		for( unsigned int d=0 ; d<Dim ; d++ ) range.first[d] = 0 , range.second[d] = grid.res(d);
+		range = RegularGrid< Dim >::Range::Intersect( range , bbox );
+		if( range.empty() ) THROW( "Bounding box does not intersect the grid" );
+
+		RegularGrid< Dim , Data > _grid;
+		unsigned int res[Dim];
+		for( unsigned int d=0 ; d<Dim ; d++ ) res[d] = range.second[d] - range.first[d];
+		_grid.resize( res );
+		range.process( [&]( typename RegularGrid< Dim >::Index I ){ _grid( I - range.first ) = grid(I); } );
+		grid = _grid;
+
+		XForm< Real , Dim+1 > translate = XForm< Real , Dim+1 >::Identity();
+		for( unsigned int d=0 ; d<Dim ; d++ ) translate(Dim,d) = (Real)range.first[d];
+		xForm = xForm * translate;
+	}
+
+	// Reads the grid, restricted to the bounding box (of sample indices, with the upper bound exclusive) if one is provided
+	// [NOTE] For tiled grids only the tiles overlapping the bounding box are read
+	// [NOTE] For procedural grids the grid is generated in memory
+	template< typename Data , typename Real >
+	static void Read( std::string fileName , RegularGrid< Dim , Data > &grid , XForm< Real , Dim+1 > &xForm , const typename RegularGrid< Dim >::Range *bbox=NULL )
+	{
+		if( GridGenerator::IsProcedural( fileName ) )
+		{
+			GridGenerator::Generate( GridGenerator::Description::Parse( fileName ) , grid , xForm );
+			if( bbox ) Crop( grid , xForm , *bbox );
+		}
+		else if( TiledGrid::IsTiled( fileName ) ) TiledGrid::Read( fileName , grid , xForm , bbox );
+		else
+		{
+			grid.read( fileName , xForm );
+			if( bbox ) Crop( grid , xForm , *bbox );
+		}
+	}
+
+	// Reads the finest level of a grid pyramid, restricted to the bounding box if one is provided
+	static void ReadPyramid( std::string fileName , RegularGrid< Dim , double > &grid , XForm< double , Dim+1 > &xForm , const typename RegularGrid< Dim >::Range *bbox=NULL )
+	{
+		GridPyramid::Pyramid< Dim > pyramid;
+		pyramid.read( fileName , xForm );
+		grid = pyramid.values[0];
+		if( bbox ) Crop( grid , xForm , *bbox );
+	}
+
+	static RegularGrid< Dim , double > Read( std::string fileName , XForm< double , Dim+1 > &xForm , const typename RegularGrid< Dim >::Range *bbox=NULL )
 	{
 		std::string dataName;
 		unsigned int dataDim;
-		RegularGrid< Dim >::ReadHeader( fileName , dataDim , dataName );
-		if( dataDim!=1 ) ERROR_OUT( "Only one-dimensional values per cell supported: " , dataDim );
+		ReadHeader( fileName , dataDim , dataName );
+		if( dataDim!=1 ) THROW( "Only one-dimensional values per cell supported: " , dataDim );
 		RegularGrid< Dim , double > grid;
 
 		auto ReadAndConvertGrid = [&]< typename InType >( void )
 		{
 			XForm< InType , Dim+1 > _xForm;
 			RegularGrid< Dim , InType > _grid;
-			_grid.read( fileName , _xForm );
+			Read( fileName , _grid , _xForm , bbox );
 			grid.resize( _grid.res() );
-			typename RegularGrid< Dim >::Range cornerRange;
-			for( unsigned int d=0 ; d<Dim ; d++ ) cornerRange.first[d] = 0 , grid.res(d) , cornerRange.second[d] = grid.res(d)+1;
-
-			cornerRange.process( [&]( typename RegularGrid< Dim >::Index I ){ grid(I) = (double)_grid(I); } );
+			for( size_t i=0 ; i<grid.resolution() ; i++ ) grid[i] = (double)_grid[i];
 			for( unsigned int i=0 ; i<=Dim ; i++ ) for( unsigned int j=0 ; j<=Dim ; j++ ) xForm(i,j) = (double)_xForm(i,j);
 		};
 
-		if     ( dataName==RegularGridDataType< double >::Name ) grid.read( fileName , xForm );
+		if( GridGenerator::IsProcedural( fileName ) ) Read( fileName , grid , xForm , bbox );
+		else if( GridPyramid::IsPyramid( fileName ) ) ReadPyramid( fileName , grid , xForm , bbox );
+		else if( dataName==QuantizedGrid::Type< unsigned char  >::Name ) ReadAndDequantize< unsigned char  >( fileName , grid , xForm , bbox );
+		else if( dataName==QuantizedGrid::Type< unsigned short >::Name ) ReadAndDequantize< unsigned short >( fileName , grid , xForm , bbox );
+		else if( dataName==RegularGridDataType< double >::Name ) Read( fileName , grid , xForm , bbox );
 		else if( dataName==RegularGridDataType< float  >::Name ) ReadAndConvertGrid.template operator()< float >();
 		else if( dataName==RegularGridDataType< int    >::Name ) ReadAndConvertGrid.template operator()< int   >();
-		else ERROR_OUT( "Only float, double, and int type grids supported: " , dataName );
+		else if( dataName==RegularGridDataType< unsigned int >::Name ) ReadAndConvertGrid.template operator()< unsigned int >();
+		else THROW( "Only float, double, int, unsigned int, and quantized type grids supported: " , dataName );
 		return grid;
 	}
 };
@@ -40,33 +142,33 @@ struct GridReader< Dim >
 template< unsigned int Dim , unsigned int N >
 struct GridReader< Dim , N >
 {
-	static RegularGrid< Dim , Point< double , N > > Read( std::string fileName , XForm< double , Dim+1 > &xForm )
+	static RegularGrid< Dim , Point< double , N > > Read( std::string fileName , XForm< double , Dim+1 > &xForm , const typename RegularGrid< Dim >::Range *bbox=NULL )
 	{
 		std::string dataName;
 		unsigned int dataDim;
-		RegularGrid< Dim >::ReadHeader( fileName , dataDim , dataName );
-		if( dataDim!=N ) ERROR_OUT( "Only one-dimensional values per cell supported: " , dataDim );
+		GridReader< Dim >::ReadHeader( fileName , dataDim , dataName );
+		if( dataDim!=N ) THROW( "Only one-dimensional values per cell supported: " , dataDim );
 		RegularGrid< Dim , Point< double , N > > grid;
 
 		auto ReadAndConvertGrid = [&]< typename InType >( void )
 		{
 			XForm< InType , Dim+1 > _xForm;
 			RegularGrid< Dim , Point< InType , N > > _grid;
-			_grid.read( fileName , _xForm );
+			GridReader< Dim >::Read( fileName , _grid , _xForm , bbox );
 			grid.resize( _grid.res() );
-			typename RegularGrid< Dim >::Range cornerRange;
-			for( unsigned int d=0 ; d<Dim ; d++ ) cornerRange.first[d] = 0 , grid.res(d) , cornerRange.second[d] = grid.res(d)+1;
-
-			cornerRange.process( [&]( typename RegularGrid< Dim >::Index I ){ grid(I) = Point< double , N >( _grid(I) ); } );
+			for( size_t i=0 ; i<grid.resolution() ; i++ ) grid[i] = Point< double , N >( _grid[i] );
 			for( unsigned int i=0 ; i<=Dim ; i++ ) for( unsigned int j=0 ; j<=Dim ; j++ ) xForm(i,j) = (double)_xForm(i,j);
 		};
 
-		if     ( dataName==RegularGridDataType< double >::Name ) grid.read( fileName , xForm );
+		if     ( dataName==QuantizedGrid::Type< unsigned char  >::Name ) GridReader< Dim >::template ReadAndDequantize< unsigned char  >( fileName , grid , xForm , bbox );
+		else if( dataName==QuantizedGrid::Type< unsigned short >::Name ) GridReader< Dim >::template ReadAndDequantize< unsigned short >( fileName , grid , xForm , bbox );
+		else if( dataName==RegularGridDataType< double >::Name ) GridReader< Dim >::Read( fileName , grid , xForm , bbox );
 		else if( dataName==RegularGridDataType< float  >::Name ) ReadAndConvertGrid.template operator()< float >();
 		else if( dataName==RegularGridDataType< int    >::Name ) ReadAndConvertGrid.template operator()< int   >();
-		else ERROR_OUT( "Only float, double, and int type grids supported: " , dataName );
+		else if( dataName==RegularGridDataType< unsigned int >::Name ) ReadAndConvertGrid.template operator()< unsigned int >();
+		else THROW( "Only float, double, int, unsigned int, and quantized type grids supported: " , dataName );
 		return grid;
 	}
 };
 
-#endif // GRID_READER_INCLUDED
\ No newline at end of file
+#endif // GRID_READER_INCLUDED
@@ -0,0 +1,242 @@
+#ifndef INSTRUMENTATION_INCLUDED
+#define INSTRUMENTATION_INCLUDED
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+#include "Misha/Miscellany.h"
+
+// A light-weight layer for recording where the tools spend their time.
+// Scopes record (named) spans on the calling thread and counters accumulate (named) per-thread totals.
+// The records can be written out as a JSON summary, with per-phase totals and counter values, or as a trace in the Chrome trace-event format
+// (which can be loaded into chrome://tracing or Perfetto).
+// [NOTE] Nothing is recorded unless instrumentation is enabled, in which case the cost of a counter increment is that of an increment of a thread-private integer
+// (or of an atomic one, for threads started while MaxThreads others are running)
+namespace Instrumentation
+{
+	//////////////////
+	// Declarations //
+	//////////////////
+
+	// Whether or not events are recorded
+	inline bool Enabled = false;
+
+	// The maximum number of (concurrently running) threads whose events are recorded separately
+	static const unsigned int MaxThreads = 256;
+
+	struct _Span
+	{
+		const char *name;
+		double start , end;
+	};
+
+	inline std::mutex &_Mutex( void ){ static std::mutex mutex ; return mutex; }
+
+	// The slot of a thread, assigned on first use and released when the thread exits so that it can be re-used by a later thread.
+	// If all slots are taken, the thread is assigned the (shared) overflow slot, MaxThreads, whose records are synchronized.
+	struct _ThreadSlot
+	{
+		unsigned int index;
+
+		_ThreadSlot( void )
+		{
+			std::lock_guard< std::mutex > lock( _Mutex() );
+			if( _Free().size() ) index = _Free().back() , _Free().pop_back();
+			else if( _Next()<MaxThreads ) index = _Next()++;
+			else index = MaxThreads;
+		}
+
+		~_ThreadSlot( void )
+		{
+			if( index==MaxThreads ) return;
+			std::lock_guard< std::mutex > lock( _Mutex() );
+			_Free().push_back( index );
+		}
+
+	protected:
+		static std::vector< unsigned int > &_Free( void ){ static std::vector< unsigned int > free ; return free; }
+		static unsigned int &_Next( void ){ static unsigned int next = 0 ; return next; }
+	};
+
+	// The slot of the calling thread
+	inline unsigned int _Thread( void )
+	{
+		static thread_local _ThreadSlot slot;
+		return slot.index;
+	}
+
+	// The time, in microseconds, since the start of the process
+	inline double _Now( void )
+	{
+		static const std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+		return std::chrono::duration< double , std::micro >( std::chrono::steady_clock::now() - origin ).count();
+	}
+
+	// The spans recorded in each slot (including the overflow slot)
+	inline std::vector< std::unique_ptr< std::vector< _Span > > > &_Spans( void ){ static std::vector< std::unique_ptr< std::vector< _Span > > > spans( MaxThreads+1 ) ; return spans; }
+
+	inline void _Record( const char *name , double start , double end )
+	{
+		unsigned int thread = _Thread();
+		if( thread==MaxThreads )
+		{
+			std::lock_guard< std::mutex > lock( _Mutex() );
+			if( !_Spans()[thread] ) _Spans()[thread] = std::make_unique< std::vector< _Span > >();
+			_Spans()[thread]->push_back( _Span{ name , start , end } );
+			return;
+		}
+		static thread_local std::vector< _Span > *spans = NULL;
+		if( !spans )
+		{
+			std::lock_guard< std::mutex > lock( _Mutex() );
+			if( !_Spans()[thread] ) _Spans()[thread] = std::make_unique< std::vector< _Span > >();
+			spans = _Spans()[thread].get();
+		}
+		spans->push_back( _Span{ name , start , end } );
+	}
+
+	// A counter, accumulated separately on each thread
+	// [NOTE] Counters register themselves when they are constructed, so they should have static storage duration
+	struct Counter
+	{
+		const std::string name;
+
+		Counter( std::string name );
+		void add( size_t count=1 );
+		size_t value( void ) const;
+
+	protected:
+		struct alignas( 64 ) _Count{ size_t count = 0; };
+		_Count _counts[ MaxThreads ];
+		std::atomic< size_t > _overflow = 0;
+	};
+
+	// Records the time between its construction and destruction as a span on the calling thread
+	struct Scope
+	{
+		Scope( const char *name ) : _name( name ) , _start( Enabled ? _Now() : 0 ){}
+		~Scope( void ){ if( Enabled ) _Record( _name , _start , _Now() ); }
+
+	protected:
+		const char *_name;
+		double _start;
+	};
+
+	// Enables recording, with times measured from the call
+	inline void Enable( void ){ _Now() ; Enabled = true; }
+
+	// Writes a JSON summary of the phases (spans aggregated by name) and counters
+	inline void WriteStats( std::string fileName , std::string tool );
+
+	// Writes the spans and counters in the Chrome trace-event format
+	inline void WriteTrace( std::string fileName , std::string tool );
+
+	/////////////////
+	// Definitions //
+	/////////////////
+
+	inline std::vector< Counter * > &_Counters( void ){ static std::vector< Counter * > counters ; return counters; }
+
+	inline Counter::Counter( std::string name ) : name( name )
+	{
+		std::lock_guard< std::mutex > lock( _Mutex() );
+		_Counters().push_back( this );
+	}
+
+	inline void Counter::add( size_t count )
+	{
+		if( !Enabled ) return;
+		unsigned int thread = _Thread();
+		if( thread<MaxThreads ) _counts[thread].count += count;
+		else _overflow.fetch_add( count , std::memory_order_relaxed );
+	}
+
+	inline size_t Counter::value( void ) const
+	{
+		size_t count = _overflow.load();
+		for( unsigned int t=0 ; t<MaxThreads ; t++ ) count += _counts[t].count;
+		return count;
+	}
+
+	// Returns the string as a JSON string literal
+	inline std::string _JSON( std::string str )
+	{
+		std::string _str = "\"";
+		for( size_t i=0 ; i<str.size() ; i++ )
+			if( str[i]=='"' || str[i]=='\\' ) _str += std::string( "\\" ) + str[i];
+			else if( (unsigned char)str[i]<0x20 ) _str += ' ';
+			else _str += str[i];
+		return _str + "\"";
+	}
+
+	inline void WriteStats( std::string fileName , std::string tool )
+	{
+		struct Phase{ size_t count = 0 ; double total = 0 , max = 0; std::vector< bool > threads = std::vector< bool >( MaxThreads+1 , false ); };
+		std::map< std::string , Phase > phases;
+		double end = _Now();
+		unsigned int threadCount = 0;
+		for( unsigned int t=0 ; t<=MaxThreads ; t++ ) if( _Spans()[t] )
+		{
+			threadCount++;
+			for( size_t i=0 ; i<_Spans()[t]->size() ; i++ )
+			{
+				const _Span &span = (*_Spans()[t])[i];
+				Phase &phase = phases[ span.name ];
+				double duration = ( span.end - span.start ) / 1e6;
+				phase.count++ , phase.total += duration , phase.max = std::max< double >( phase.max , duration ) , phase.threads[t] = true;
+			}
+		}
+
+		FILE *fp = fopen( fileName.c_str() , "w" );
+		if( !fp ) ERROR_OUT( "Could not open file for writing: " , fileName );
+		fprintf( fp , "{\n" );
+		fprintf( fp , "\t\"tool\": %s,\n" , _JSON( tool ).c_str() );
+		fprintf( fp , "\t\"time\": %.6f,\n" , end / 1e6 );
+		fprintf( fp , "\t\"peak memory (MB)\": %.3f,\n" , (double)Miscellany::MemoryInfo::PeakMemoryUsageMB() );
+		fprintf( fp , "\t\"threads\": %u,\n" , threadCount );
+		fprintf( fp , "\t\"phases\":\n\t{" );
+		for( auto iter=phases.begin() ; iter!=phases.end() ; iter++ )
+		{
+			unsigned int threads = 0;
+			for( unsigned int t=0 ; t<=MaxThreads ; t++ ) if( iter->second.threads[t] ) threads++;
+			fprintf( fp , "%s\n\t\t%s: { \"count\": %zu, \"total\": %.6f, \"max\": %.6f, \"threads\": %u }" , iter==phases.begin() ? "" : "," , _JSON( iter->first ).c_str() , iter->second.count , iter->second.total , iter->second.max , threads );
+		}
+		fprintf( fp , "\n\t},\n" );
+		fprintf( fp , "\t\"counters\":\n\t{" );
+		for( size_t i=0 ; i<_Counters().size() ; i++ ) fprintf( fp , "%s\n\t\t%s: %zu" , i ? "," : "" , _JSON( _Counters()[i]->name ).c_str() , _Counters()[i]->value() );
+		fprintf( fp , "\n\t}\n" );
+		fprintf( fp , "}\n" );
+		fclose( fp );
+	}
+
+	inline void WriteTrace( std::string fileName , std::string tool )
+	{
+		double end = _Now();
+		FILE *fp = fopen( fileName.c_str() , "w" );
+		if( !fp ) ERROR_OUT( "Could not open file for writing: " , fileName );
+		fprintf( fp , "{\n\"displayTimeUnit\": \"ms\",\n\"traceEvents\":\n[\n" );
+		fprintf( fp , "{ \"name\": \"process_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": 0, \"args\": { \"name\": %s } }" , _JSON( tool ).c_str() );
+		for( unsigned int t=0 ; t<=MaxThreads ; t++ ) if( _Spans()[t] )
+		{
+			fprintf( fp , ",\n{ \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": %u, \"args\": { \"name\": \"%s %u\" } }" , t , t==MaxThreads ? "overflow" : "thread" , t );
+			for( size_t i=0 ; i<_Spans()[t]->size() ; i++ )
+			{
+				const _Span &span = (*_Spans()[t])[i];
+				fprintf( fp , ",\n{ \"name\": %s, \"ph\": \"X\", \"pid\": 0, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f }" , _JSON( span.name ).c_str() , t , span.start , span.end - span.start );
+			}
+		}
+		// The counter totals are recorded as a single counter event at the end of the trace
+		fprintf( fp , ",\n{ \"name\": \"counters\", \"ph\": \"C\", \"pid\": 0, \"tid\": 0, \"ts\": %.3f, \"args\": {" , end );
+		for( size_t i=0 ; i<_Counters().size() ; i++ ) fprintf( fp , "%s %s: %zu" , i ? "," : "" , _JSON( _Counters()[i]->name ).c_str() , _Counters()[i]->value() );
+		fprintf( fp , " } }\n]\n}\n" );
+		fclose( fp );
+	}
+}
+
+#endif // INSTRUMENTATION_INCLUDED
@@ -12,14 +12,23 @@ struct ChooseTable
 		else return ( ChooseTable< N-1 , K-1 >::Choose() * N ) / K;
 	}
 
-	static unsigned int Choose( unsigned int n , unsigned int k )
+	static constexpr unsigned int Choose( unsigned int n , unsigned int k )
 	{
-		if( k==0 ) return 1;
-		else return ( Choose( n-1 , k-1 ) * n ) / k;
+		if( k>n ) return 0;
+		unsigned long long c = 1;
+		for( unsigned int i=1 ; i<=k ; i++ ) c = ( c * ( n-k+i ) ) / i;
+		return (unsigned int)c;
 	}
 
-	ChooseTable( void ){ for( unsigned int n=0 ; n<N ; n++ ) for( unsigned int k=0 ; k<K ; k++ ) _values[n][k] = Choose( n , k ); }
-	const unsigned int operator()( unsigned int n , unsigned int k ) const { return _values[n][k]; }
+	// Fills in the table at compile time using Pascal's rule
+	constexpr ChooseTable( void ) : _values{}
+	{
+		for( unsigned int n=0 ; n<N ; n++ ) for( unsigned int k=0 ; k<K ; k++ )
+			if     ( k==0 ) _values[n][k] = 1;
+			else if( n==0 ) _values[n][k] = 0;
+			else            _values[n][k] = _values[n-1][k-1] + _values[n-1][k];
+	}
+	constexpr unsigned int operator()( unsigned int n , unsigned int k ) const { return _values[n][k]; }
 protected:
 	unsigned int _values[N][K];
 };
@@ -47,7 +56,11 @@ struct MultiIndex
 		}
 		return false;
 	}
-	bool operator == ( const MultiIndex &idx ) const { return !( (*this)<idx ) && !( idx<(*this) ); }
+	bool operator == ( const MultiIndex &idx ) const
+	{
+		for( unsigned int i=0 ; i<K ; i++ ) if( _indices[i]!=idx._indices[i] ) return false;
+		return true;
+	}
 	const unsigned int &operator[] ( unsigned int idx ) const { return _indices[idx]; }
 
 	MultiIndex &operator ++( void )
@@ -72,23 +85,49 @@ struct MultiIndex
 	}
 
 
-	static unsigned int Choose( unsigned int n , unsigned int k )
+	// Computes the binomial coefficient iteratively, returning zero if k exceeds n
+	static constexpr unsigned int Choose( unsigned int n , unsigned int k )
 	{
-		if( k==0 ) return 1;
-		else return ( Choose( n-1 , k-1 ) * n ) / k;
+		if( k>n ) return 0;
+		unsigned long long c = 1;
+		for( unsigned int i=1 ; i<=k ; i++ ) c = ( c * ( n-k+i ) ) / i;
+		return (unsigned int)c;
 	}
 
-	static unsigned int Size( unsigned int N ){ return Choose( N , K ); }
+	static constexpr unsigned int Size( unsigned int N ){ return Choose( N , K ); }
 
 	unsigned int operator()( void ) const
 	{
 		// If the k-th index have value x_i, then there are choose( x_i-1 , i ) possible preceeding values
 		unsigned int idx = 0;
-		if constexpr( MaxN==-1 ) for( int k=(int)K-1 ; k>=0 ; k-- ) idx += Choose( _indices[k] , k+1 );
+		if constexpr( MaxN==(unsigned int)-1 ) for( int k=(int)K-1 ; k>=0 ; k-- ) idx += Choose( _indices[k] , k+1 );
 		else                     for( int k=(int)K-1 ; k>=0 ; k-- ) idx += _ChooseTable( _indices[k] , k+1 );
 		return idx;
 	}
 
+	// Returns the multi-index with the prescribed rank, inverting operator()
+	static MultiIndex Unrank( unsigned int idx )
+	{
+		MultiIndex mi;
+		for( int k=(int)K-1 ; k>=0 ; k-- )
+		{
+			// Find the largest value x with Choose( x , k+1 )<=idx, bracketing it by doubling and then bisecting
+			// [NOTE] Since Choose( k , k+1 )=0 the search can start at k
+			unsigned int lo = k , step = 1;
+			while( _Choose( lo+step , k+1 )<=idx ) lo += step , step <<= 1;
+			unsigned int hi = lo+step;
+			while( hi-lo>1 )
+			{
+				unsigned int mid = lo + ( hi-lo ) / 2;
+				if( _Choose( mid , k+1 )<=idx ) lo = mid;
+				else hi = mid;
+			}
+			mi._indices[k] = lo;
+			idx -= (unsigned int)_Choose( lo , k+1 );
+		}
+		return mi;
+	}
+
 	template< unsigned int _K >
 	bool contains( const MultiIndex< _K > &mi ) const
 	{
@@ -102,13 +141,19 @@ struct MultiIndex
 		return j==_K;
 	}
 
+	// A hash function mixing the bits of all the indices
+	// [NOTE] Unlike the product of the indices, this does not vanish when one of the indices is zero
 	struct Hash
 	{
 		size_t operator() ( const MultiIndex &mi ) const
 		{
-			size_t val = 1;
-			for( unsigned int s=0 ; s<K ; s++ ) val *= mi[s];
-			return val;
+			unsigned long long val = K;
+			for( unsigned int s=0 ; s<K ; s++ ) val = ( val ^ mi[s] ) * 0x9E3779B97F4A7C15ull , val ^= val>>32;
+			// The finalizer of MurmurHash3
+			val ^= val>>33 , val *= 0xFF51AFD7ED558CCDull;
+			val ^= val>>33 , val *= 0xC4CEB9FE1A85EC53ull;
+			val ^= val>>33;
+			return (size_t)val;
 		}
 	};
 
@@ -161,8 +206,68 @@ struct MultiIndex
 		std::vector< unsigned int > _indices;
 	};
 
+	// A hash map, using open addressing with linear probing, whose entries are stored in a single flat array
+	// [NOTE] Unlike Map, the storage is proportional to the number of entries rather than to the number of possible multi-indices
+	template< typename Data >
+	struct HashMap
+	{
+		HashMap( void ) : _size(0) , _stamp(1) {}
+
+		// Allocates enough slots to store the prescribed number of entries without re-hashing
+		void reserve( size_t size );
+
+		// Removes all entries without releasing the memory
+		void clear( void );
+
+		size_t size( void ) const { return _size; }
+
+		// Returns a pointer to the data associated with the multi-index, or NULL if there is none
+		Data *find( const MultiIndex &mi );
+		const Data *find( const MultiIndex &mi ) const;
+
+		// Returns the data associated with the multi-index, inserting a value-initialized entry if there is none
+		// [NOTE] Inserting can re-hash, invalidating pointers and references to data returned earlier
+		Data &insert( const MultiIndex &mi , bool &inserted );
+		Data &operator[]( const MultiIndex &mi ){ bool inserted ; return insert( mi , inserted ); }
+
+		// Applies the functor, taking the multi-index and the data, to all the entries
+		template< typename F > void process( F f );
+		template< typename F > void process( F f ) const;
+
+	protected:
+		// An entry is occupied if its stamp matches the stamp of the map
+		struct _Entry
+		{
+			MultiIndex key;
+			unsigned int stamp = 0;
+			Data data;
+		};
+		std::vector< _Entry > _entries;
+		size_t _size;
+		unsigned int _stamp;
+
+		// Returns the slot containing the multi-index, or the empty slot where it should be inserted
+		size_t _slot( const MultiIndex &mi ) const;
+		void _rehash( size_t slotNum );
+	};
+
 protected:
-	static std::conditional_t< MaxN==-1 , char , ChooseTable< MaxN , K+1 > > _ChooseTable;
+	static constexpr std::conditional_t< MaxN==(unsigned int)-1 , char , ChooseTable< MaxN , K+1 > > _ChooseTable = {};
+
+	// Returns the binomial coefficient, from the table when it is available, saturating instead of overflowing
+	static unsigned long long _Choose( unsigned int n , unsigned int k )
+	{
+		if constexpr( MaxN!=(unsigned int)-1 ) if( n<MaxN ) return _ChooseTable( n , k );
+		if( k>n ) return 0;
+		// The partial products Choose( n-k+i , i ) are increasing, so the iteration can stop once they overflow
+		unsigned long long c = 1;
+		for( unsigned int i=1 ; i<=k ; i++ )
+		{
+			c = ( c * ( n-k+i ) ) / i;
+			if( c>(unsigned int)-1 ) return (unsigned long long)-1;
+		}
+		return c;
+	}
 
 	void _init( const unsigned int indices[] )
 	{
@@ -173,7 +278,103 @@ protected:
 };
 
 template< unsigned int K , unsigned int MaxN >
-std::conditional_t< MaxN==-1 , char , ChooseTable< MaxN , K+1 > > MultiIndex< K , MaxN >::_ChooseTable;
+template< typename Data >
+void MultiIndex< K , MaxN >::HashMap< Data >::reserve( size_t size )
+{
+	// Keep the load factor at or below 1/2
+	size_t slotNum = 16;
+	while( slotNum<2*size ) slotNum <<= 1;
+	if( slotNum>_entries.size() ) _rehash( slotNum );
+}
+
+template< unsigned int K , unsigned int MaxN >
+template< typename Data >
+void MultiIndex< K , MaxN >::HashMap< Data >::clear( void )
+{
+	_size = 0;
+	// Advancing the stamp marks all the entries as unoccupied
+	if( !++_stamp )
+	{
+		for( size_t i=0 ; i<_entries.size() ; i++ ) _entries[i].stamp = 0;
+		_stamp = 1;
+	}
+}
+
+template< unsigned int K , unsigned int MaxN >
+template< typename Data >
+size_t MultiIndex< K , MaxN >::HashMap< Data >::_slot( const MultiIndex &mi ) const
+{
+	size_t mask = _entries.size()-1;
+	size_t slot = typename MultiIndex::Hash()( mi ) & mask;
+	while( _entries[slot].stamp==_stamp && !( _entries[slot].key==mi ) ) slot = ( slot+1 ) & mask;
+	return slot;
+}
+
+template< unsigned int K , unsigned int MaxN >
+template< typename Data >
+void MultiIndex< K , MaxN >::HashMap< Data >::_rehash( size_t slotNum )
+{
+	std::vector< _Entry > entries( slotNum );
+	std::swap( entries , _entries );
+	for( size_t i=0 ; i<entries.size() ; i++ ) if( entries[i].stamp==_stamp )
+	{
+		_Entry &entry = _entries[ _slot( entries[i].key ) ];
+		entry.key = entries[i].key;
+		entry.stamp = _stamp;
+		entry.data = std::move( entries[i].data );
+	}
+}
+
+template< unsigned int K , unsigned int MaxN >
+template< typename Data >
+Data *MultiIndex< K , MaxN >::HashMap< Data >::find( const MultiIndex &mi )
+{
+	if( !_size ) return NULL;
+	_Entry &entry = _entries[ _slot( mi ) ];
+	return entry.stamp==_stamp ? &entry.data : NULL;
+}
+
+template< unsigned int K , unsigned int MaxN >
+template< typename Data >
+const Data *MultiIndex< K , MaxN >::HashMap< Data >::find( const MultiIndex &mi ) const
+{
+	if( !_size ) return NULL;
+	const _Entry &entry = _entries[ _slot( mi ) ];
+	return entry.stamp==_stamp ? &entry.data : NULL;
+}
+
+template< unsigned int K , unsigned int MaxN >
+template< typename Data >
+Data &MultiIndex< K , MaxN >::HashMap< Data >::insert( const MultiIndex &mi , bool &inserted )
+{
+	if( 2*(_size+1)>_entries.size() ) reserve( 2*(_size+1) );
+	_Entry &entry = _entries[ _slot( mi ) ];
+	inserted = entry.stamp!=_stamp;
+	if( inserted )
+	{
+		entry.key = mi;
+		entry.stamp = _stamp;
+		entry.data = {};
+		_size++;
+	}
+	return entry.data;
+}
+
+template< unsigned int K , unsigned int MaxN >
+template< typename Data >
+template< typename F >
+void MultiIndex< K , MaxN >::HashMap< Data >::process( F f )
+{
+	for( size_t i=0 ; i<_entries.size() ; i++ ) if( _entries[i].stamp==_stamp ) f( _entries[i].key , _entries[i].data );
+}
+
+template< unsigned int K , unsigned int MaxN >
+template< typename Data >
+template< typename F >
+void MultiIndex< K , MaxN >::HashMap< Data >::process( F f ) const
+{
+	for( size_t i=0 ; i<_entries.size() ; i++ ) if( _entries[i].stamp==_stamp ) f( _entries[i].key , _entries[i].data );
+}
 
 template< unsigned int K >
 std::ostream &operator << ( std::ostream &os , const MultiIndex< K > &mi )
@@ -0,0 +1,42 @@
+#ifndef PHILOX_INCLUDED
+#define PHILOX_INCLUDED
+
+#include <stdint.h>
+
+// The Philox4x32-10 counter-based random number generator of Salmon et al. [2011]
+// The generator maps a (key,counter) pair to four pseudo-random 32-bit integers, so random values can be computed
+// independently (and in parallel) by using, for example, the index of the sample as the counter.
+namespace Philox
+{
+	struct Key{ uint32_t k[2]; };
+	struct Counter{ uint32_t c[4]; };
+
+	// Returns the key for the seed and the stream
+	inline Key MakeKey( uint32_t seed , uint32_t stream=0 ){ return Key{ { seed , stream } }; }
+
+	// Returns the four pseudo-random integers associated with the counter
+	inline Counter Generate( Key key , Counter counter )
+	{
+		static const uint32_t M0 = 0xD2511F53 , M1 = 0xCD9E8D57;
+		static const uint32_t W0 = 0x9E3779B9 , W1 = 0xBB67AE85;
+		uint32_t *c = counter.c;
+		for( unsigned int r=0 ; r<10 ; r++ )
+		{
+			uint64_t p0 = (uint64_t)M0 * c[0] , p1 = (uint64_t)M1 * c[2];
+			uint32_t _c[] = { (uint32_t)( p1>>32 ) ^ c[1] ^ key.k[0] , (uint32_t)p1 , (uint32_t)( p0>>32 ) ^ c[3] ^ key.k[1] , (uint32_t)p0 };
+			c[0] = _c[0] , c[1] = _c[1] , c[2] = _c[2] , c[3] = _c[3];
+			key.k[0] += W0 , key.k[1] += W1;
+		}
+		return counter;
+	}
+
+	// Returns a pseudo-random double in the range [0,1), with 53 bits of randomness, associated with the (index,channel) pair
+	inline double Uniform( Key key , uint64_t index , uint32_t channel )
+	{
+		Counter c = Generate( key , Counter{ { (uint32_t)index , (uint32_t)( index>>32 ) , channel , 0 } } );
+		uint64_t u = ( ( (uint64_t)c.c[0] )<<32 ) | c.c[1];
+		return (double)( u>>11 ) * ( 1. / 9007199254740992. );
+	}
+}
+
+#endif // PHILOX_INCLUDED
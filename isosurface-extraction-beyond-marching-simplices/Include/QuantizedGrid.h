@@ -0,0 +1,195 @@
+#ifndef QUANTIZED_GRID_INCLUDED
+#define QUANTIZED_GRID_INCLUDED
+
+#include <stdio.h>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include "Misha/RegularGrid.h"
+#include "TiledGrid.h"
+
+// A grid format in which the values are stored as 8- or 16-bit unsigned integers, with the value of a sample given by offset + scale * sample.
+// The file consists of a text header:
+//		Q<Dim>
+//		<values per sample> <value type (UINT8 or UINT16)>
+//		<resolution along dimension 0> ... <resolution along dimension Dim-1>
+//		<scale> <offset>
+//		<(Dim+1) lines giving the grid-to-world transformation>
+// followed by the binary samples, in the order in which they are stored in memory.
+// [NOTE] The scale is positive, so comparisons between samples agree with comparisons between the values they represent.
+namespace QuantizedGrid
+{
+	//////////////////
+	// Declarations //
+	//////////////////
+
+	// The name of the quantized type in the header
+	template< typename Quantized > struct Type;
+	template<> struct Type< unsigned char  >{ static inline const std::string Name = "UINT8"  ; };
+	template<> struct Type< unsigned short >{ static inline const std::string Name = "UINT16" ; };
+
+	// Returns true if the file is a quantized grid
+	inline bool IsQuantized( std::string fileName );
+
+	// Reads the dimension of the grid
+	inline void ReadDimension( std::string fileName , unsigned int &dim );
+
+	// Reads the number of values per sample, the name of the value type, and the scale and offset
+	template< unsigned int Dim >
+	void ReadHeader( std::string fileName , unsigned int &dataDim , std::string &dataName , double &scale , double &offset );
+
+	// Writes the quantized grid
+	template< unsigned int Dim , typename Data , typename Real >
+	void Write( std::string fileName , const RegularGrid< Dim , Data > &grid , XForm< Real , Dim+1 > xForm , double scale , double offset );
+
+	// Reads the quantized grid, restricted to the bounding box (of sample indices, with the upper bound exclusive) if one is provided
+	template< unsigned int Dim , typename Data , typename Real >
+	void Read( std::string fileName , RegularGrid< Dim , Data > &grid , XForm< Real , Dim+1 > &xForm , double &scale , double &offset , const typename RegularGrid< Dim >::Range *bbox=NULL );
+
+	// Quantizes the grid, mapping the range of values (over all samples and channels) to the range of the quantized type
+	template< unsigned int Dim , typename InData , typename OutData >
+	void Quantize( const RegularGrid< Dim , InData > &in , RegularGrid< Dim , OutData > &out , double &scale , double &offset );
+
+	/////////////////
+	// Definitions //
+	/////////////////
+
+	// Reads the text header, leaving the file pointer at the start of the samples
+	template< unsigned int Dim , typename Real >
+	void _ReadHeader( FILE *fp , std::string fileName , unsigned int &dataDim , std::string &dataName , unsigned int res[Dim] , double &scale , double &offset , XForm< Real , Dim+1 > &xForm )
+	{
+		unsigned int dim;
+		char name[1024];
+		if( fscanf( fp , " Q%u" , &dim )!=1 ) THROW( "Not a quantized grid: " , fileName );
+		if( dim!=Dim ) THROW( "Grid dimensions don't match: " , dim , " != " , Dim );
+		if( fscanf( fp , " %u %1023s" , &dataDim , name )!=2 ) THROW( "Failed to read the data type: " , fileName );
+		dataName = std::string( name );
+		for( unsigned int d=0 ; d<Dim ; d++ ) if( fscanf( fp , " %u" , res+d )!=1 ) THROW( "Failed to read the resolution: " , fileName );
+		if( fscanf( fp , " %lf %lf" , &scale , &offset )!=2 ) THROW( "Failed to read the scale and offset: " , fileName );
+		if( !( scale>0 ) ) THROW( "Scale must be positive: " , scale );
+		for( unsigned int j=0 ; j<=Dim ; j++ ) for( unsigned int i=0 ; i<=Dim ; i++ )
+		{
+			double value;
+			if( fscanf( fp , " %lf" , &value )!=1 ) THROW( "Failed to read the transformation: " , fileName );
+			xForm(i,j) = (Real)value;
+		}
+		// Consume the new-line preceding the binary data
+		if( fgetc( fp )!='\n' ) THROW( "Malformed header: " , fileName );
+	}
+
+	inline bool IsQuantized( std::string fileName )
+	{
+		TiledGrid::_InputFile file( fileName );
+		FILE *fp = file.fp;
+		bool isQuantized = fgetc( fp )=='Q';
+		file.close();
+		return isQuantized;
+	}
+
+	inline void ReadDimension( std::string fileName , unsigned int &dim )
+	{
+		TiledGrid::_InputFile file( fileName );
+		FILE *fp = file.fp;
+		if( fscanf( fp , " Q%u" , &dim )!=1 ) THROW( "Not a quantized grid: " , fileName );
+		file.close();
+	}
+
+	template< unsigned int Dim >
+	void ReadHeader( std::string fileName , unsigned int &dataDim , std::string &dataName , double &scale , double &offset )
+	{
+		TiledGrid::_InputFile file( fileName );
+		FILE *fp = file.fp;
+		unsigned int res[Dim];
+		XForm< double , Dim+1 > xForm;
+		_ReadHeader< Dim >( fp , fileName , dataDim , dataName , res , scale , offset , xForm );
+		file.close();
+	}
+
+	template< unsigned int Dim , typename Data , typename Real >
+	void Write( std::string fileName , const RegularGrid< Dim , Data > &grid , XForm< Real , Dim+1 > xForm , double scale , double offset )
+	{
+		using Traits = TiledGrid::_DataTraits< Data >;
+		static_assert( sizeof( Data )==sizeof( typename Traits::Real ) * Traits::Channels , "[ERROR] Samples must be tightly packed" );
+		if( !( scale>0 ) ) ERROR_OUT( "Scale must be positive: " , scale );
+
+		FILE *fp = fopen( fileName.c_str() , "wb" );
+		if( !fp ) ERROR_OUT( "Could not open file for writing: " , fileName );
+		fprintf( fp , "Q%u\n" , Dim );
+		fprintf( fp , "%u %s\n" , Traits::Channels , Type< typename Traits::Real >::Name.c_str() );
+		for( unsigned int d=0 ; d<Dim ; d++ ) fprintf( fp , d ? " %u" : "%u" , grid.res(d) );
+		fprintf( fp , "\n" );
+		fprintf( fp , "%.17g %.17g\n" , scale , offset );
+		for( unsigned int j=0 ; j<=Dim ; j++ )
+		{
+			for( unsigned int i=0 ; i<=Dim ; i++ ) fprintf( fp , i ? " %.17g" : "%.17g" , (double)xForm(i,j) );
+			fprintf( fp , "\n" );
+		}
+		if( grid.resolution() && fwrite( &grid[0] , sizeof( Data ) , grid.resolution() , fp )!=grid.resolution() ) ERROR_OUT( "Failed to write the samples: " , fileName );
+		fclose( fp );
+	}
+
+	template< unsigned int Dim , typename Data , typename Real >
+	void Read( std::string fileName , RegularGrid< Dim , Data > &grid , XForm< Real , Dim+1 > &xForm , double &scale , double &offset , const typename RegularGrid< Dim >::Range *bbox )
+	{
+		using Traits = TiledGrid::_DataTraits< Data >;
+		static_assert( sizeof( Data )==sizeof( typename Traits::Real ) * Traits::Channels , "[ERROR] Samples must be tightly packed" );
+
+		TiledGrid::_InputFile file( fileName );
+		FILE *fp = file.fp;
+
+		unsigned int dataDim , res[Dim];
+		std::string dataName;
+		_ReadHeader< Dim >( fp , fileName , dataDim , dataName , res , scale , offset , xForm );
+		if( dataDim!=Traits::Channels ) THROW( "Data dimensions don't match: " , dataDim , " != " , Traits::Channels );
+		if( dataName!=Type< typename Traits::Real >::Name ) THROW( "Data types don't match: " , dataName , " != " , Type< typename Traits::Real >::Name );
+
+		grid.resize( res );
+		if( grid.resolution() && fread( &grid[0] , sizeof( Data ) , grid.resolution() , fp )!=grid.resolution() ) THROW( "Failed to read the samples: " , fileName );
+		file.close();
+
+		if( bbox )
+		{
+			typename RegularGrid< Dim >::Range range;
+			for( unsigned int d=0 ; d<Dim ; d++ ) range.first[d] = 0 , range.second[d] = res[d];
+			range = RegularGrid< Dim >::Range::Intersect( range , *bbox );
+			if( range.empty() ) THROW( "Bounding box does not intersect the grid" );
+
+			RegularGrid< Dim , Data > _grid;
+			unsigned int _res[Dim];
+			for( unsigned int d=0 ; d<Dim ; d++ ) _res[d] = range.second[d] - range.first[d];
+			_grid.resize( _res );
+			range.process( [&]( typename RegularGrid< Dim >::Index I ){ _grid( I - range.first ) = grid(I); } );
+			grid = _grid;
+
+			XForm< Real , Dim+1 > translate = XForm< Real , Dim+1 >::Identity();
+			for( unsigned int d=0 ; d<Dim ; d++ ) translate(Dim,d) = (Real)range.first[d];
+			xForm = xForm * translate;
+		}
+	}
+
+	template< unsigned int Dim , typename InData , typename OutData >
+	void Quantize( const RegularGrid< Dim , InData > &in , RegularGrid< Dim , OutData > &out , double &scale , double &offset )
+	{
+		using InTraits = TiledGrid::_DataTraits< InData >;
+		using OutTraits = TiledGrid::_DataTraits< OutData >;
+		using Quantized = typename OutTraits::Real;
+		static_assert( InTraits::Channels==OutTraits::Channels , "[ERROR] Channel counts don't match" );
+		static const double QuantizedMax = (double)std::numeric_limits< Quantized >::max();
+
+		double min = std::numeric_limits< double >::infinity() , max = -std::numeric_limits< double >::infinity();
+		for( size_t i=0 ; i<in.resolution() ; i++ ) for( unsigned int n=0 ; n<InTraits::Channels ; n++ )
+		{
+			double v = (double)InTraits::Channel( in[i] , n );
+			min = std::min< double >( min , v ) , max = std::max< double >( max , v );
+		}
+		offset = min;
+		scale = max>min ? ( max-min ) / QuantizedMax : 1.;
+
+		out.resize( in.res() );
+#pragma omp parallel for
+		for( long long i=0 ; i<(long long)in.resolution() ; i++ ) for( unsigned int n=0 ; n<InTraits::Channels ; n++ )
+			OutTraits::Channel( out[i] , n ) = (Quantized)std::min< double >( QuantizedMax , std::max< double >( 0. , std::round( ( (double)InTraits::Channel( in[i] , n ) - offset ) / scale ) ) );
+	}
+}
+
+#endif // QUANTIZED_GRID_INCLUDED
@@ -3,6 +3,8 @@
 
 #include "Misha/Geometry.h"
 
+template< unsigned int Dim , unsigned int N > struct SimplexFunctionBatch;
+
 // A class for representing affine functions on a right Dim-dimensinonal simplex
 template< unsigned int Dim >
 struct SimplexFunction
@@ -26,6 +28,10 @@ struct SimplexFunction
 	// Returns the position at which the (Dim+1) linear functions have the same value
 	static Point< double , Dim > Intersect( const SimplexFunction< Dim > functions[Dim+1] );
 
+	// Returns the position at which the (Dim+1) linear functions have the same value
+	// [NOTE] Does not throw. If there is no unique intersection, success is set to false
+	static Point< double , Dim > TryIntersect( const SimplexFunction< Dim > functions[Dim+1] , bool &success );
+
 	// Returns the position at which the (Dim+1) linear functions have the same value
 	template< typename ... SimplexFunctions >
 	static Point< double , Dim > Intersect( SimplexFunctions ... functions );
@@ -37,6 +43,8 @@ struct SimplexFunction
 	template< unsigned int _Dim >
 	friend std::ostream &operator << ( std::ostream &os , const SimplexFunction< _Dim > &f );
 
+	template< unsigned int _Dim , unsigned int N > friend struct SimplexFunctionBatch;
+
 protected:
 	// Represent the function as F(p) =  c + < v , p >
 	double _c;
@@ -45,6 +53,25 @@ protected:
 	void _set( const double cornerValues[Dim+1] );
 };
 
+// A class for evaluating N affine functions on a right Dim-dimensional simplex together
+template< unsigned int Dim , unsigned int N >
+struct SimplexFunctionBatch
+{
+	// Set the coefficients from those of the functions
+	SimplexFunctionBatch( const SimplexFunction< Dim > functions[N] );
+
+	// Evaluate all the functions at a prescribed point
+	void operator()( Point< double , Dim > p , double values[N] ) const;
+
+	// Returns true if no function is larger, at the prescribed point, than the function indexed by indices[0]
+	// [NOTE] The functions indexed by indices[0] , ... , indices[count-1] are not tested
+	bool isMaximal( Point< double , Dim > p , const unsigned int indices[] , unsigned int count ) const;
+
+protected:
+	// Represent the functions as F_n(p) =  c_n + < v_n , p >, with the coefficients of the different functions stored contiguously
+	double _c[N] , _v[Dim][N];
+};
+
 /////////////////
 // Definitions //
 /////////////////
@@ -78,23 +105,50 @@ Point< double , Dim > SimplexFunction< Dim >::Corner( unsigned int c )
 
 template< unsigned int Dim >
 Point< double , Dim > SimplexFunction< Dim >::Intersect( const SimplexFunction< Dim > functions[Dim+1] )
+{
+	bool success;
+	Point< double , Dim > p = TryIntersect( functions , success );
+	if( !success ) THROW( "No intersection found" );
+	return p;
+}
+
+template< unsigned int Dim >
+Point< double , Dim > SimplexFunction< Dim >::TryIntersect( const SimplexFunction< Dim > functions[Dim+1] , bool &success )
 {
 	// The functions are equal at the point p satisfying:
 	// functions[0](p) = functions[d](p) for all 1 <= d <= Dim
 	// _c[0] + < _v[0] , p > = _c[d] + < _v[d] , p >
 	// _c[0] - _c[d] = < _v[d] - _v[0] , p >
-	SquareMatrix< double , Dim > A;
-	Point< double , Dim > b;
-	for( unsigned int d=1 ; d<=Dim ; d++ )
+	Point< double , Dim > p;
+	if constexpr( Dim==1 )
 	{
-		b[d-1] = functions[0]._c - functions[d]._c;
-		Point< double , Dim > v = functions[d]._v - functions[0]._v;
-		for( unsigned int dd=0 ; dd<Dim ; dd++ ) A( dd , d-1 ) = v[dd];
+		double a = functions[1]._v[0] - functions[0]._v[0];
+		success = a!=0;
+		if( success ) p[0] = ( functions[0]._c - functions[1]._c ) / a;
 	}
-	bool success;
-	b = A.inverse( success ) * b;
-	if( !success ) THROW( "No intersection found" );
-	return b;
+	else if constexpr( Dim==2 )
+	{
+		// Solve the 2x2 system using Cramer's rule
+		double a00 = functions[1]._v[0] - functions[0]._v[0] , a01 = functions[1]._v[1] - functions[0]._v[1];
+		double a10 = functions[2]._v[0] - functions[0]._v[0] , a11 = functions[2]._v[1] - functions[0]._v[1];
+		double b0 = functions[0]._c - functions[1]._c , b1 = functions[0]._c - functions[2]._c;
+		double det = a00 * a11 - a01 * a10;
+		success = det!=0;
+		if( success ) p[0] = ( b0 * a11 - a01 * b1 ) / det , p[1] = ( a00 * b1 - b0 * a10 ) / det;
+	}
+	else
+	{
+		SquareMatrix< double , Dim > A;
+		Point< double , Dim > b;
+		for( unsigned int d=1 ; d<=Dim ; d++ )
+		{
+			b[d-1] = functions[0]._c - functions[d]._c;
+			Point< double , Dim > v = functions[d]._v - functions[0]._v;
+			for( unsigned int dd=0 ; dd<Dim ; dd++ ) A( dd , d-1 ) = v[dd];
+		}
+		p = A.inverse( success ) * b;
+	}
+	return p;
 }
 
 template< unsigned int Dim >
@@ -122,6 +176,40 @@ Point< double , Dim+1 > SimplexFunction< Dim >::dual( void ) const
 	return dual;
 }
 
+template< unsigned int Dim , unsigned int N >
+SimplexFunctionBatch< Dim , N >::SimplexFunctionBatch( const SimplexFunction< Dim > functions[N] )
+{
+	for( unsigned int n=0 ; n<N ; n++ )
+	{
+		_c[n] = functions[n]._c;
+		for( unsigned int d=0 ; d<Dim ; d++ ) _v[d][n] = functions[n]._v[d];
+	}
+}
+
+template< unsigned int Dim , unsigned int N >
+void SimplexFunctionBatch< Dim , N >::operator()( Point< double , Dim > p , double values[N] ) const
+{
+	for( unsigned int n=0 ; n<N ; n++ ) values[n] = _c[n];
+	for( unsigned int d=0 ; d<Dim ; d++ )
+#pragma omp simd
+		for( unsigned int n=0 ; n<N ; n++ ) values[n] += _v[d][n] * p[d];
+}
+
+template< unsigned int Dim , unsigned int N >
+bool SimplexFunctionBatch< Dim , N >::isMaximal( Point< double , Dim > p , const unsigned int indices[] , unsigned int count ) const
+{
+	double values[N];
+	bool skip[N];
+	(*this)( p , values );
+	for( unsigned int n=0 ; n<N ; n++ ) skip[n] = false;
+	for( unsigned int i=0 ; i<count ; i++ ) skip[ indices[i] ] = true;
+
+	double value = values[ indices[0] ];
+	bool isMax = true;
+	for( unsigned int n=0 ; n<N ; n++ ) isMax &= skip[n] || values[n]<=value;
+	return isMax;
+}
+
 template< unsigned int Dim >
 std::ostream &operator << ( std::ostream &os , const SimplexFunction< Dim > &f )
 {
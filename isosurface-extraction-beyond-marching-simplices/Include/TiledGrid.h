@@ -0,0 +1,417 @@
+#ifndef TILED_GRID_INCLUDED
+#define TILED_GRID_INCLUDED
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <string>
+#include <exception>
+#include <type_traits>
+#include "Misha/RegularGrid.h"
+
+// A grid format in which the values are partitioned into tiles that are compressed independently.
+// The file consists of a text header:
+//		T<Dim>
+//		<values per sample> <value type>
+//		<resolution along dimension 0> ... <resolution along dimension Dim-1>
+//		<tile size along dimension 0> ... <tile size along dimension Dim-1>
+//		<(Dim+1) lines giving the grid-to-world transformation>
+// followed by a binary tile index (the (tile count+1) offsets of the compressed tiles, relative to the end of the index),
+// and the compressed tiles, in the order in which RegularGrid< Dim >::Range::process visits the tile indices.
+// Within a tile, the values are compressed losslessly by (1) taking differences between the bit-patterns of consecutive values
+// (2) shuffling the bytes so that the i-th bytes of all the differences are contiguous, and (3) run-length encoding the bytes.
+namespace TiledGrid
+{
+	//////////////////
+	// Declarations //
+	//////////////////
+
+	static const unsigned int DefaultTileSize = 32;
+
+	// Returns true if the file is a tiled grid
+	inline bool IsTiled( std::string fileName );
+
+	// Reads the dimension of the grid
+	inline void ReadDimension( std::string fileName , unsigned int &dim );
+
+	// Reads the number of values per sample and the name of the value type
+	template< unsigned int Dim >
+	void ReadHeader( std::string fileName , unsigned int &dataDim , std::string &dataName );
+
+	// Writes the grid, with tiles of the prescribed size
+	template< unsigned int Dim , typename Data , typename Real >
+	void Write( std::string fileName , const RegularGrid< Dim , Data > &grid , XForm< Real , Dim+1 > xForm , unsigned int tileSize=DefaultTileSize );
+
+	// Reads the grid, decoding the tiles in parallel
+	// If a bounding box (of sample indices, with the upper bound exclusive) is provided, only the tiles overlapping it are read
+	// and the transformation is adjusted so that the returned sub-grid has the same world coordinates
+	template< unsigned int Dim , typename Data , typename Real >
+	void Read( std::string fileName , RegularGrid< Dim , Data > &grid , XForm< Real , Dim+1 > &xForm , const typename RegularGrid< Dim >::Range *bbox=NULL );
+
+	// Losslessly encodes/decodes count values, with the differences taken between values that are stride apart
+	template< typename Real > void Encode( const Real *values , size_t count , unsigned int stride , std::vector< unsigned char > &bytes );
+	template< typename Real > void Decode( const unsigned char *bytes , size_t byteCount , Real *values , size_t count , unsigned int stride );
+
+	/////////////////
+	// Definitions //
+	/////////////////
+
+	// The scalar type and number of scalars in a grid sample
+	template< typename Data >
+	struct _DataTraits
+	{
+		using Real = Data;
+		static constexpr unsigned int Channels = 1;
+		static       Real &Channel(       Data &d , unsigned int ){ return d; }
+		static const Real &Channel( const Data &d , unsigned int ){ return d; }
+	};
+
+	template< typename _Real , unsigned int N >
+	struct _DataTraits< Point< _Real , N > >
+	{
+		using Real = _Real;
+		static constexpr unsigned int Channels = N;
+		static       Real &Channel(       Point< Real , N > &d , unsigned int n ){ return d[n]; }
+		static const Real &Channel( const Point< Real , N > &d , unsigned int n ){ return d[n]; }
+	};
+
+	// Returns/sets the position in the file using 64-bit offsets, since a long is 32 bits on Windows and the offsets into grids larger than 2GB overflow it
+	inline long long _Tell( FILE *fp )
+	{
+#ifdef _WIN32
+		return _ftelli64( fp );
+#else // !_WIN32
+		return ftello( fp );
+#endif // _WIN32
+	}
+
+	inline bool _Seek( FILE *fp , long long offset )
+	{
+#ifdef _WIN32
+		return _fseeki64( fp , offset , SEEK_SET )==0;
+#else // !_WIN32
+		return fseeko( fp , (off_t)offset , SEEK_SET )==0;
+#endif // _WIN32
+	}
+
+	// A file opened for reading, which is closed when it goes out of scope so that it is not leaked when reading throws
+	struct _InputFile
+	{
+		FILE *fp;
+
+		_InputFile( std::string fileName ) : fp( fopen( fileName.c_str() , "rb" ) ){ if( !fp ) THROW( "Could not open file for reading: " , fileName ); }
+		_InputFile( const _InputFile & ) = delete;
+		_InputFile &operator = ( const _InputFile & ) = delete;
+		~_InputFile( void ){ close(); }
+		void close( void ){ if( fp ) fclose( fp ) , fp = NULL; }
+	};
+
+	// The unsigned integer type with the same size as the scalar type
+	template< typename Real >
+	using _UInt = std::conditional_t< sizeof(Real)==1 , unsigned char , std::conditional_t< sizeof(Real)==2 , unsigned short , std::conditional_t< sizeof(Real)==4 , unsigned int , unsigned long long > > >;
+
+	// Returns the rank of the index within the range, in the order in which Range::process visits the indices
+	template< unsigned int Dim >
+	size_t _Linearize( typename RegularGrid< Dim >::Index I , const typename RegularGrid< Dim >::Range &range )
+	{
+		size_t idx = I[0] - range.first[0];
+		for( unsigned int d=1 ; d<Dim ; d++ ) idx = idx * ( range.second[d] - range.first[d] ) + ( I[d] - range.first[d] );
+		return idx;
+	}
+
+	// The tiling of a grid
+	template< unsigned int Dim >
+	struct _Tiling
+	{
+		unsigned int res[Dim] , tileRes[Dim];
+		typename RegularGrid< Dim >::Range tiles;
+
+		_Tiling( const unsigned int res[Dim] , const unsigned int tileRes[Dim] )
+		{
+			for( unsigned int d=0 ; d<Dim ; d++ )
+			{
+				this->res[d] = res[d] , this->tileRes[d] = tileRes[d];
+				tiles.first[d] = 0 , tiles.second[d] = ( res[d] + tileRes[d] - 1 ) / tileRes[d];
+			}
+		}
+
+		size_t size( void ) const { return tiles.size(); }
+
+		// Returns the range of sample indices covered by a tile
+		typename RegularGrid< Dim >::Range range( typename RegularGrid< Dim >::Index T ) const
+		{
+			typename RegularGrid< Dim >::Range r;
+			for( unsigned int d=0 ; d<Dim ; d++ ) r.first[d] = T[d] * tileRes[d] , r.second[d] = std::min< int >( ( T[d]+1 ) * tileRes[d] , res[d] );
+			return r;
+		}
+
+		// Returns the tile indices, in file order
+		std::vector< typename RegularGrid< Dim >::Index > indices( void ) const
+		{
+			std::vector< typename RegularGrid< Dim >::Index > _indices;
+			_indices.reserve( size() );
+			tiles.process( [&]( typename RegularGrid< Dim >::Index T ){ _indices.push_back( T ); } );
+			return _indices;
+		}
+	};
+
+	// Reads the text header, leaving the file pointer at the start of the tile index
+	template< unsigned int Dim , typename Real >
+	void _ReadHeader( FILE *fp , std::string fileName , unsigned int &dataDim , std::string &dataName , unsigned int res[Dim] , unsigned int tileRes[Dim] , XForm< Real , Dim+1 > &xForm )
+	{
+		unsigned int dim;
+		char name[1024];
+		if( fscanf( fp , " T%u" , &dim )!=1 ) THROW( "Not a tiled grid: " , fileName );
+		if( dim!=Dim ) THROW( "Grid dimensions don't match: " , dim , " != " , Dim );
+		if( fscanf( fp , " %u %1023s" , &dataDim , name )!=2 ) THROW( "Failed to read the data type: " , fileName );
+		dataName = std::string( name );
+		for( unsigned int d=0 ; d<Dim ; d++ ) if( fscanf( fp , " %u" , res+d )!=1 ) THROW( "Failed to read the resolution: " , fileName );
+		for( unsigned int d=0 ; d<Dim ; d++ ) if( fscanf( fp , " %u" , tileRes+d )!=1 || !tileRes[d] ) THROW( "Failed to read the tile size: " , fileName );
+		for( unsigned int j=0 ; j<=Dim ; j++ ) for( unsigned int i=0 ; i<=Dim ; i++ )
+		{
+			double value;
+			if( fscanf( fp , " %lf" , &value )!=1 ) THROW( "Failed to read the transformation: " , fileName );
+			xForm(i,j) = (Real)value;
+		}
+		// Consume the new-line preceding the binary data
+		if( fgetc( fp )!='\n' ) THROW( "Malformed header: " , fileName );
+	}
+
+	inline bool IsTiled( std::string fileName )
+	{
+		_InputFile file( fileName );
+		FILE *fp = file.fp;
+		bool isTiled = fgetc( fp )=='T';
+		file.close();
+		return isTiled;
+	}
+
+	inline void ReadDimension( std::string fileName , unsigned int &dim )
+	{
+		_InputFile file( fileName );
+		FILE *fp = file.fp;
+		if( fscanf( fp , " T%u" , &dim )!=1 ) THROW( "Not a tiled grid: " , fileName );
+		file.close();
+	}
+
+	template< unsigned int Dim >
+	void ReadHeader( std::string fileName , unsigned int &dataDim , std::string &dataName )
+	{
+		_InputFile file( fileName );
+		FILE *fp = file.fp;
+		unsigned int res[Dim] , tileRes[Dim];
+		XForm< double , Dim+1 > xForm;
+		_ReadHeader< Dim >( fp , fileName , dataDim , dataName , res , tileRes , xForm );
+		file.close();
+	}
+
+	template< typename Real >
+	void Encode( const Real *values , size_t count , unsigned int stride , std::vector< unsigned char > &bytes )
+	{
+		using UInt = _UInt< Real >;
+		static const unsigned int Size = sizeof( UInt );
+
+		// Take the differences of the bit-patterns and shuffle the bytes
+		std::vector< unsigned char > shuffled( count * Size );
+		for( size_t i=0 ; i<count ; i++ )
+		{
+			UInt u , _u = 0;
+			memcpy( &u , values+i , Size );
+			if( i>=stride ) memcpy( &_u , values+i-stride , Size );
+			u -= _u;
+			for( unsigned int b=0 ; b<Size ; b++ ) shuffled[ b*count+i ] = (unsigned char)( u>>(8*b) );
+		}
+
+		// Run-length encode the bytes:
+		// A control byte c<128 is followed by c+1 literal bytes, and a control byte c>=128 by a single byte that is repeated c-128+3 times
+		bytes.resize( 0 );
+		size_t i = 0 , n = shuffled.size();
+		auto RunLength = [&]( size_t i )
+			{
+				size_t r = 1;
+				while( i+r<n && r<130 && shuffled[i+r]==shuffled[i] ) r++;
+				return r;
+			};
+		while( i<n )
+		{
+			size_t r = RunLength( i );
+			if( r>=3 )
+			{
+				bytes.push_back( (unsigned char)( 0x80 | ( r-3 ) ) );
+				bytes.push_back( shuffled[i] );
+				i += r;
+			}
+			else
+			{
+				size_t start = i;
+				while( i<n && i-start<128 && RunLength( i )<3 ) i++;
+				bytes.push_back( (unsigned char)( i-start-1 ) );
+				bytes.insert( bytes.end() , shuffled.begin()+start , shuffled.begin()+i );
+			}
+		}
+	}
+
+	template< typename Real >
+	void Decode( const unsigned char *bytes , size_t byteCount , Real *values , size_t count , unsigned int stride )
+	{
+		using UInt = _UInt< Real >;
+		static const unsigned int Size = sizeof( UInt );
+
+		// Undo the run-length encoding
+		std::vector< unsigned char > shuffled( count * Size );
+		size_t i = 0 , n = shuffled.size();
+		for( size_t p=0 ; p<byteCount ; )
+		{
+			unsigned char c = bytes[p++];
+			if( c & 0x80 )
+			{
+				size_t r = ( c & 0x7f ) + 3;
+				if( i+r>n || p>=byteCount ) THROW( "Corrupt tile" );
+				memset( &shuffled[i] , bytes[p++] , r );
+				i += r;
+			}
+			else
+			{
+				size_t r = c+1;
+				if( i+r>n || p+r>byteCount ) THROW( "Corrupt tile" );
+				memcpy( &shuffled[i] , bytes+p , r );
+				i += r , p += r;
+			}
+		}
+		if( i!=n ) THROW( "Corrupt tile: " , i , " != " , n );
+
+		// Unshuffle the bytes and accumulate the differences
+		for( size_t i=0 ; i<count ; i++ )
+		{
+			UInt u = 0 , _u = 0;
+			for( unsigned int b=0 ; b<Size ; b++ ) u |= ( (UInt)shuffled[ b*count+i ] )<<(8*b);
+			if( i>=stride ) memcpy( &_u , values+i-stride , Size );
+			u += _u;
+			memcpy( values+i , &u , Size );
+		}
+	}
+
+	template< unsigned int Dim , typename Data , typename Real >
+	void Write( std::string fileName , const RegularGrid< Dim , Data > &grid , XForm< Real , Dim+1 > xForm , unsigned int tileSize )
+	{
+		using Traits = _DataTraits< Data >;
+		if( !tileSize ) ERROR_OUT( "Tile size must be positive" );
+
+		unsigned int res[Dim] , tileRes[Dim];
+		for( unsigned int d=0 ; d<Dim ; d++ ) res[d] = grid.res(d) , tileRes[d] = tileSize;
+		_Tiling< Dim > tiling( res , tileRes );
+		std::vector< typename RegularGrid< Dim >::Index > tiles = tiling.indices();
+
+		// Encode the tiles in parallel
+		std::vector< std::vector< unsigned char > > encodedTiles( tiles.size() );
+#pragma omp parallel for
+		for( int t=0 ; t<(int)tiles.size() ; t++ )
+		{
+			typename RegularGrid< Dim >::Range range = tiling.range( tiles[t] );
+			std::vector< typename Traits::Real > values( range.size() * Traits::Channels );
+			size_t idx = 0;
+			range.process( [&]( typename RegularGrid< Dim >::Index I ){ for( unsigned int n=0 ; n<Traits::Channels ; n++ ) values[idx++] = Traits::Channel( grid(I) , n ); } );
+			Encode( &values[0] , values.size() , Traits::Channels , encodedTiles[t] );
+		}
+
+		FILE *fp = fopen( fileName.c_str() , "wb" );
+		if( !fp ) ERROR_OUT( "Could not open file for writing: " , fileName );
+		fprintf( fp , "T%u\n" , Dim );
+		fprintf( fp , "%u %s\n" , Traits::Channels , RegularGridDataType< typename Traits::Real >::Name.c_str() );
+		for( unsigned int d=0 ; d<Dim ; d++ ) fprintf( fp , d ? " %u" : "%u" , res[d] );
+		fprintf( fp , "\n" );
+		for( unsigned int d=0 ; d<Dim ; d++ ) fprintf( fp , d ? " %u" : "%u" , tileRes[d] );
+		fprintf( fp , "\n" );
+		for( unsigned int j=0 ; j<=Dim ; j++ )
+		{
+			for( unsigned int i=0 ; i<=Dim ; i++ ) fprintf( fp , i ? " %.17g" : "%.17g" , (double)xForm(i,j) );
+			fprintf( fp , "\n" );
+		}
+
+		std::vector< unsigned long long > offsets( tiles.size()+1 );
+		offsets[0] = 0;
+		for( unsigned int t=0 ; t<tiles.size() ; t++ ) offsets[t+1] = offsets[t] + encodedTiles[t].size();
+		fwrite( &offsets[0] , sizeof(unsigned long long) , offsets.size() , fp );
+		for( unsigned int t=0 ; t<tiles.size() ; t++ ) if( encodedTiles[t].size() ) fwrite( &encodedTiles[t][0] , 1 , encodedTiles[t].size() , fp );
+		fclose( fp );
+	}
+
+	template< unsigned int Dim , typename Data , typename Real >
+	void Read( std::string fileName , RegularGrid< Dim , Data > &grid , XForm< Real , Dim+1 > &xForm , const typename RegularGrid< Dim >::Range *bbox )
+	{
+		using Traits = _DataTraits< Data >;
+
+		_InputFile file( fileName );
+		FILE *fp = file.fp;
+
+		unsigned int dataDim , res[Dim] , tileRes[Dim];
+		std::string dataName;
+		_ReadHeader< Dim >( fp , fileName , dataDim , dataName , res , tileRes , xForm );
+		if( dataDim!=Traits::Channels ) THROW( "Data dimensions don't match: " , dataDim , " != " , Traits::Channels );
+		if( dataName!=RegularGridDataType< typename Traits::Real >::Name ) THROW( "Data types don't match: " , dataName , " != " , RegularGridDataType< typename Traits::Real >::Name );
+
+		_Tiling< Dim > tiling( res , tileRes );
+		std::vector< typename RegularGrid< Dim >::Index > tiles = tiling.indices();
+		std::vector< unsigned long long > offsets( tiles.size()+1 );
+		if( fread( &offsets[0] , sizeof(unsigned long long) , offsets.size() , fp )!=offsets.size() ) THROW( "Failed to read the tile index: " , fileName );
+		long long dataStart = _Tell( fp );
+		if( dataStart<0 ) THROW( "Failed to get file position: " , fileName );
+
+		// The range of samples to read
+		typename RegularGrid< Dim >::Range range;
+		for( unsigned int d=0 ; d<Dim ; d++ ) range.first[d] = 0 , range.second[d] = res[d];
+		if( bbox )
+		{
+			range = RegularGrid< Dim >::Range::Intersect( range , *bbox );
+			if( range.empty() ) THROW( "Bounding box does not intersect the grid" );
+		}
+
+		unsigned int _res[Dim];
+		for( unsigned int d=0 ; d<Dim ; d++ ) _res[d] = range.second[d] - range.first[d];
+		grid.resize( _res );
+
+		// Read the compressed tiles overlapping the range
+		std::vector< unsigned int > _tiles;
+		for( unsigned int t=0 ; t<tiles.size() ; t++ ) if( !RegularGrid< Dim >::Range::Intersect( tiling.range( tiles[t] ) , range ).empty() ) _tiles.push_back( t );
+		std::vector< std::vector< unsigned char > > encodedTiles( _tiles.size() );
+		for( unsigned int i=0 ; i<_tiles.size() ; i++ )
+		{
+			unsigned int t = _tiles[i];
+			encodedTiles[i].resize( offsets[t+1]-offsets[t] );
+			if( !encodedTiles[i].size() ) continue;
+			if( ( !i || _tiles[i-1]!=t-1 ) && !_Seek( fp , dataStart + (long long)offsets[t] ) ) THROW( "Failed to seek tile: " , t );
+			if( fread( &encodedTiles[i][0] , 1 , encodedTiles[i].size() , fp )!=encodedTiles[i].size() ) THROW( "Failed to read tile: " , t );
+		}
+		file.close();
+
+		// Decode the tiles in parallel and copy the values in the range into the grid
+		// [NOTE] Since exceptions cannot propagate out of a parallel region, a decoding failure is recorded and re-thrown after the loop
+		std::string error;
+#pragma omp parallel for
+		for( int i=0 ; i<(int)_tiles.size() ; i++ )
+		{
+			typename RegularGrid< Dim >::Range tileRange = tiling.range( tiles[ _tiles[i] ] );
+			std::vector< typename Traits::Real > values( tileRange.size() * Traits::Channels );
+			try{ Decode( encodedTiles[i].size() ? &encodedTiles[i][0] : NULL , encodedTiles[i].size() , &values[0] , values.size() , Traits::Channels ); }
+			catch( const std::exception &e )
+			{
+#pragma omp critical
+				error = e.what();
+				continue;
+			}
+			RegularGrid< Dim >::Range::Intersect( tileRange , range ).process( [&]( typename RegularGrid< Dim >::Index I )
+				{
+					size_t idx = _Linearize< Dim >( I , tileRange ) * Traits::Channels;
+					for( unsigned int n=0 ; n<Traits::Channels ; n++ ) Traits::Channel( grid( I - range.first ) , n ) = values[idx+n];
+				} );
+		}
+		if( error.size() ) THROW( error );
+
+		// Offset the transformation by the corner of the range
+		XForm< Real , Dim+1 > translate = XForm< Real , Dim+1 >::Identity();
+		for( unsigned int d=0 ; d<Dim ; d++ ) translate(Dim,d) = (Real)range.first[d];
+		xForm = xForm * translate;
+	}
+}
+
+#endif // TILED_GRID_INCLUDED
@@ -0,0 +1,108 @@
+#ifndef TIMINGS_INCLUDED
+#define TIMINGS_INCLUDED
+
+#include <stdio.h>
+#include <map>
+#include <tuple>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include "Misha/Miscellany.h"
+
+// Functionality shared by the benchmarks for writing out timings as CSV and comparing them against a baseline.
+// A timing is keyed by a tuple of (unsigned) integers and strings, which make up the leading columns of a CSV row, followed by the measured values.
+// A baseline is a CSV file previously written out by the same benchmark, of which only the key and the first value (the time) are read.
+namespace Timings
+{
+	// Writes the header followed by a row for each entry, with the values obtained by applying the functor to the entry's value
+	// [NOTE] The functor should return a tuple of numbers
+	template< typename Key , typename Value , typename ValueFunctor >
+	void Write( std::string fileName , std::string header , const std::map< Key , Value > &timings , ValueFunctor values );
+
+	// Reads the (first) timing value for each key from the baseline file
+	template< typename Key >
+	std::map< Key , double > ReadBaseline( std::string fileName );
+
+	// Returns false (and reports a regression) if any of the times, obtained by applying the functor to the entry's value, exceeds the baseline time by more than the prescribed slack factor
+	template< typename Key , typename Value , typename TimeFunctor >
+	bool CheckBaseline( std::string fileName , const std::map< Key , Value > &timings , double slack , TimeFunctor time );
+
+	// Returns the fields of the key, separated by spaces
+	template< typename Key >
+	std::string ToString( const Key &key );
+
+	/////////////////
+	// Definitions //
+	/////////////////
+
+	inline std::string _ToString( const std::string &value ){ return value; }
+	inline std::string _ToString( unsigned int value ){ return std::to_string( value ); }
+	inline std::string _ToString( int value ){ return std::to_string( value ); }
+	inline std::string _ToString( double value ){ char str[64] ; snprintf( str , sizeof(str) , "%g" , value ) ; return str; }
+
+	inline void _FromString( const std::string &str , std::string &value ){ value = str; }
+	inline void _FromString( const std::string &str , unsigned int &value ){ value = (unsigned int)std::stoul( str ); }
+	inline void _FromString( const std::string &str , int &value ){ value = std::stoi( str ); }
+	inline void _FromString( const std::string &str , double &value ){ value = std::stod( str ); }
+
+	template< typename Tuple >
+	std::string _Join( const Tuple &tuple , std::string separator )
+	{
+		std::string str;
+		std::apply( [&]( const auto & ... fields ){ ( ( str += ( str.size() ? separator : std::string() ) + _ToString( fields ) ) , ... ); } , tuple );
+		return str;
+	}
+
+	template< typename Key >
+	std::string ToString( const Key &key ){ return _Join( key , " " ); }
+
+	template< typename Key , typename Value , typename ValueFunctor >
+	void Write( std::string fileName , std::string header , const std::map< Key , Value > &timings , ValueFunctor values )
+	{
+		FILE *fp = fopen( fileName.c_str() , "w" );
+		if( !fp ) ERROR_OUT( "Could not open file for writing: " , fileName );
+		fprintf( fp , "%s\n" , header.c_str() );
+		for( auto iter=timings.begin() ; iter!=timings.end() ; iter++ ) fprintf( fp , "%s,%s\n" , _Join( iter->first , "," ).c_str() , _Join( values( iter->second ) , "," ).c_str() );
+		fclose( fp );
+	}
+
+	template< typename Key >
+	std::map< Key , double > ReadBaseline( std::string fileName )
+	{
+		std::map< Key , double > baseline;
+		std::ifstream stream( fileName );
+		if( !stream.is_open() ) ERROR_OUT( "Could not open baseline for reading: " , fileName );
+
+		std::string line;
+		std::getline( stream , line );	// Skip the header
+		while( std::getline( stream , line ) )
+		{
+			std::stringstream ss( line );
+			Key key;
+			bool success = true;
+			std::apply( [&]( auto & ... fields ){ ( [&]( auto &field ){ std::string str ; if( success && std::getline( ss , str , ',' ) ) _FromString( str , field ) ; else success = false; }( fields ) , ... ); } , key );
+			std::string time;
+			if( success && std::getline( ss , time , ',' ) ) baseline[ key ] = std::stod( time );
+		}
+		return baseline;
+	}
+
+	template< typename Key , typename Value , typename TimeFunctor >
+	bool CheckBaseline( std::string fileName , const std::map< Key , Value > &timings , double slack , TimeFunctor time )
+	{
+		bool success = true;
+		std::map< Key , double > baseline = ReadBaseline< Key >( fileName );
+		for( auto iter=timings.begin() ; iter!=timings.end() ; iter++ )
+		{
+			auto _iter = baseline.find( iter->first );
+			if( _iter!=baseline.end() && time( iter->second )>_iter->second*slack )
+			{
+				std::cerr << "[FAILURE] Regression: " << ToString( iter->first ) << ": " << time( iter->second ) << " > " << _iter->second << " * " << slack << std::endl;
+				success = false;
+			}
+		}
+		return success;
+	}
+}
+#endif // TIMINGS_INCLUDED
@@ -6,17 +6,22 @@
 #include "Misha/CmdLineParser.h"
 #include "Misha/RegularGrid.h"
 #include "Include/GridReader.h"
+#include "Include/TiledGrid.h"
+#include "Include/GridOperators.h"
 
 static const unsigned int Dim = 2;
 
 Misha::CmdLineParameter< std::string > In( "in" ) , Out( "out" );
 Misha::CmdLineParameter< double > Jitter( "jitter" , 0. );
+Misha::CmdLineParameter< unsigned int > TileSize( "tile" , TiledGrid::DefaultTileSize ) , Seed( "seed" , 0 );
 
 Misha::CmdLineReadable* params[] =
 {
 	&In ,
 	&Out ,
 	&Jitter ,
+	&TileSize ,
+	&Seed ,
 	NULL
 };
 
@@ -26,6 +31,8 @@ void ShowUsage( const char* ex )
 	std::cout << "\t --" << In.name << " <input grid>" << std::endl;
 	std::cout << "\t[--" << Out.name << " <output curve>]" << std::endl;
 	std::cout << "\t[--" << Jitter.name << " <jitter magnitude>=" << Jitter.value << "]" << std::endl;
+	std::cout << "\t[--" << TileSize.name << " <output tile size>=" << TileSize.value << "]" << std::endl;
+	std::cout << "\t[--" << Seed.name << " <random seed>]" << std::endl;
 }
 
 template< unsigned int N >
@@ -45,17 +52,25 @@ void Execute( void )
 	for( unsigned int d=0 ; d<Dim ; d++ ) cellRange.first[d] = cornerRange.first[d] = 0 , cellRange.second[d] = grid.res(d)-1 , cornerRange.second[d] = grid.res(d);
 
 	// If the jitter magnitude is non-zero, jitter the input
+	// [NOTE] The noise is keyed on the seed, the sample index, and the channel, so the output does not depend on the number of threads
 	if( Jitter.value!=0 )
 	{
-		std::random_device rand_dev;
-		std::mt19937 generator( rand_dev() );
-		std::uniform_real_distribution< double > distr( -fabs(Jitter.value) , fabs(Jitter.value) );
-
-		cornerRange.process( [&]( RegularGrid< Dim >::Index I ){ for( unsigned int n=0 ; n<N ; n++ ) grid( I )[n] += distr( generator ); } );
-
+		unsigned int seed = Seed.value;
+		if( !Seed.set )
+		{
+			std::random_device rand_dev;
+			seed = rand_dev();
+		}
+		const Philox::Key key = Philox::MakeKey( seed );
+#pragma omp parallel for
+		for( long long i=0 ; i<(long long)grid.resolution() ; i++ ) GridOperators::Jitter( grid[i] , Jitter.value , key , (size_t)i );
 	}
 
-	if( Out.set ) grid.write( Out.value , gridToWorld );
+	if( Out.set )
+	{
+		if( TileSize.set ) TiledGrid::Write( Out.value , grid , gridToWorld , TileSize.value );
+		else grid.write( Out.value , gridToWorld );
+	}
 }
 
 
@@ -68,24 +83,28 @@ int main( int argc , char *argv[] )
 		return EXIT_SUCCESS;
 	}
 
-	unsigned int dataDim;
-	std::string dataName;
-	RegularGrid< Dim >::ReadHeader( In.value , dataDim , dataName );
-
-	switch( dataDim )
+	try
 	{
-	case  1: Execute<  1 >() ; break;
-	case  2: Execute<  2 >() ; break;
-	case  3: Execute<  3 >() ; break;
-	case  4: Execute<  4 >() ; break;
-	case  5: Execute<  5 >() ; break;
-	case  6: Execute<  6 >() ; break;
-	case  7: Execute<  7 >() ; break;
-	case  8: Execute<  8 >() ; break;
-	case  9: Execute<  9 >() ; break;
-	case 10: Execute< 10 >() ; break;
-	default: ERROR_OUT( "Only grid values of dimension 1..10 supported: " , dataDim );
+		unsigned int dataDim;
+		std::string dataName;
+		GridReader< Dim >::ReadHeader( In.value , dataDim , dataName );
+
+		switch( dataDim )
+		{
+		case  1: Execute<  1 >() ; break;
+		case  2: Execute<  2 >() ; break;
+		case  3: Execute<  3 >() ; break;
+		case  4: Execute<  4 >() ; break;
+		case  5: Execute<  5 >() ; break;
+		case  6: Execute<  6 >() ; break;
+		case  7: Execute<  7 >() ; break;
+		case  8: Execute<  8 >() ; break;
+		case  9: Execute<  9 >() ; break;
+		case 10: Execute< 10 >() ; break;
+		default: ERROR_OUT( "Only grid values of dimension 1..10 supported: " , dataDim );
+		}
 	}
+	catch( const std::exception &e ){ ERROR_OUT( e.what() ); }
 
 	return EXIT_SUCCESS;
 }
@@ -1,3 +1,4 @@
+#include <cmath>
 #include <map>
 #include <iostream>
 #include <random>
@@ -10,113 +11,202 @@
 #include "Misha/PlyVertexData.h"
 #include "Include/MultiIndex.h"
 #include "Include/GridReader.h"
+#include "Include/BlockedGrid.h"
 #include "Include/CellSimplices.h"
+#include "Include/CurveOutput.h"
+#include "Include/CurveSimplifier.h"
+#include "Include/Instrumentation.h"
+#include "Include/Batch.h"
 
 static const unsigned int Dim = 2;
 
-Misha::CmdLineParameter< std::string > In( "in" ) , Out( "out" );
-Misha::CmdLineParameter< double > IsoValue( "iso" , 0. );
-Misha::CmdLineReadable Verbose( "verbose" ) , Performance( "performance" ) , ASCII( "ascii" ) , Progress( "progress" );
+Misha::CmdLineParameter< std::string > In( "in" ) , Out( "out" ) , Stats( "stats" ) , Trace( "trace" ) , Manifest( "batch" ) , BatchReport( "report" );
+Misha::CmdLineParameter< double > IsoValue( "iso" , 0. ) , Tolerance( "tolerance" , 0. ) , SimplifyTolerance( "simplify" , 0. );
+Misha::CmdLineParameter< unsigned int > Level( "level" , 0 ) , BlockSize( "block" , 0 );
+Misha::CmdLineParameterArray< int , 2*Dim > BBox( "bbox" );
+CurveOutput::Parameters CurveParameters;
+Misha::CmdLineReadable Verbose( "verbose" ) , Performance( "performance" ) , ASCII( "ascii" ) , Progress( "progress" ) , SimplifyWorld( "simplifyWorld" );
 
 Misha::CmdLineReadable* params[] =
 {
 	&In ,
 	&Out ,
+	&Manifest ,
+	&BatchReport ,
 	&IsoValue ,
+	&BBox ,
+	&Level ,
+	&Tolerance ,
+	&SimplifyTolerance ,
+	&SimplifyWorld ,
+	&CurveParameters.diffusionTime ,
+	&CurveParameters.tubularRadius ,
+	&CurveParameters.angularResolution ,
+	&BlockSize ,
 	&Verbose ,
 	&Performance ,
+	&Stats ,
+	&Trace ,
 	&Progress ,
 	&ASCII ,
 	NULL
 };
 
+// Counters for the extraction
+Instrumentation::Counter CellCount( "cells" ) , ActiveCellCount( "active cells" ) , TriangleCount( "triangles" ) , ActiveTriangleCount( "active triangles" ) , MapLookupCount( "map lookups" ) , MapInsertionCount( "map insertions" );
+
 void ShowUsage( const char* ex )
 {
 	std::cout << "Usage " << std::string( ex ) << ":" << std::endl;
 	std::cout << "\t --" << In.name << " <input grid>" << std::endl;
-	std::cout << "\t[--" << Out.name << " <output curve>]" << std::endl;
+	std::cout << "\t[--" << Out.name << " <output curve (or tube)>]" << std::endl;
+	std::cout << "\t[--" << Manifest.name << " <batch manifest (lines of: <input grid> [<output> [<iso-value>]])>]" << std::endl;
+	std::cout << "\t[--" << BatchReport.name << " <batch report (CSV)>]" << std::endl;
 	std::cout << "\t[--" << IsoValue.name << " <iso-value>=" << IsoValue.value << "]" << std::endl;
+	std::cout << "\t[--" << BBox.name << " <bounding box min corner> <bounding box max corner (exclusive)>]" << std::endl;
+	std::cout << "\t[--" << Level.name << " <pyramid level>]" << std::endl;
+	std::cout << "\t[--" << Tolerance.name << " <largest cell size (world units)>]" << std::endl;
+	std::cout << "\t[--" << SimplifyTolerance.name << " <simplification tolerance (in grid units)>]" << std::endl;
+	std::cout << "\t[--" << SimplifyWorld.name << "]" << std::endl;
+	CurveParameters.showUsage();
 	std::cout << "\t[--" << Performance.name << "]" << std::endl;
+	std::cout << "\t[--" << Stats.name << " <output statistics (JSON)>]" << std::endl;
+	std::cout << "\t[--" << Trace.name << " <output trace (Chrome trace-event JSON)>]" << std::endl;
 	std::cout << "\t[--" << Progress.name << "]" << std::endl;
 	std::cout << "\t[--" << ASCII.name << "]" << std::endl;
+	std::cout << "\t[--" << BlockSize.name << " <cell traversal block size>]" << std::endl;
 	std::cout << "\t[--" << Verbose.name << "]" << std::endl;
 }
 
-int main( int argc , char *argv[] )
+using Factory = VertexFactory::PositionFactory< double , Dim >;
+
+// The buffers used to extract a level-set
+// [NOTE] In batch mode each thread has its own workspace for each grid type, whose buffers are cleared (but not released) between jobs
+template< typename Real >
+struct Workspace
+{
+	// The regular grid of input samples
+	RegularGrid< Dim , Real > grid;
+	// The output level-set vertices and edges
+	std::vector< Factory::VertexType > levelSetVertices;
+	std::vector< SimplexIndex< Dim-1 > > levelSetEdges;
+	// A hash map to track the level-set vertices associated with edges
+	MultiIndex< Dim >::HashMap< unsigned int > levelSetVertexMap;
+	// The output tube vertices and triangles
+	std::vector< Point< double , Dim+1 > > tubeVertices;
+	std::vector< SimplexIndex< Dim > > tubeTriangles;
+};
+
+// Extracts the level-set from a grid whose samples are of type Real
+// [NOTE] For quantized grids the samples are compared to the iso-value mapped into sample units, so values are only converted to double on edges crossing the level-set
+template< typename Real >
+void Execute( const Batch::Job &job , Workspace< Real > &workspace , bool verbose , bool progress )
 {
-	using Factory = VertexFactory::PositionFactory< double , Dim >;
 
 	// A function linearizing a grid's index
 	auto Linearize = [&]( RegularGrid< Dim >::Index I , RegularGrid< Dim >::Range range )
 		{
 			unsigned int idx = I[0] - range.first[0];
-			for( unsigned int d=1 ; d<Dim ; d++ ) idx = idx * ( range.second[d-1] - range.first[d-1] ) + ( I[d] - range.first[d] );
+			for( unsigned int d=1 ; d<Dim ; d++ ) idx = idx * ( range.second[d] - range.first[d] ) + ( I[d] - range.first[d] );
 			return idx;
 		};
 
-	Misha::CmdLineParse( argc-1 , argv+1 , params );
-	if( !In.set )
-	{
-		ShowUsage( argv[0] );
-		return EXIT_SUCCESS;
-	}
-
-	Miscellany::Timer timer , subTimer;
+	Miscellany::Timer subTimer;
 
-	// The output level-set vertices
-	std::vector< Factory::VertexType > levelSetVertices;
-	// The output level-set edges
-	std::vector< SimplexIndex< Dim-1 > > levelSetEdges;
+	RegularGrid< Dim , Real > &grid = workspace.grid;
+	std::vector< Factory::VertexType > &levelSetVertices = workspace.levelSetVertices;
+	std::vector< SimplexIndex< Dim-1 > > &levelSetEdges = workspace.levelSetEdges;
+	MultiIndex< Dim >::HashMap< unsigned int > &levelSetVertexMap = workspace.levelSetVertexMap;
+	levelSetVertices.resize( 0 ) , levelSetEdges.resize( 0 ) , levelSetVertexMap.clear();
 
 	// The transformations from grid coordinates to world coordinates
 	XForm< double , Dim+1 > gridToWorld;
-	// The regular grid of input values
-	RegularGrid< Dim , double > grid;
+	// The map from samples to values
+	double scale = 1. , offset = 0.;
 	// Range of grid cells and grid corners
 	// [NOTE] Grid values are associated with corners
 	RegularGrid< Dim >::Range cellRange , cornerRange;
+	// When extracting coarse-to-fine, the pyramid and the level from which the level-set is extracted
+	const bool coarseToFine = Level.set || Tolerance.set;
+	GridPyramid::Pyramid< Dim > pyramid;
+	unsigned int level = 0;
 
 
-	// Read in the input grid
-	grid = GridReader< Dim >::Read( In.value , gridToWorld );
+	// Read in the input grid, restricted to the bounding box if one is given
+	{
+		Instrumentation::Scope scope( "read" );
+		RegularGrid< Dim >::Range bbox;
+		for( unsigned int d=0 ; d<Dim ; d++ ) bbox.first[d] = BBox.values[d] , bbox.second[d] = BBox.values[Dim+d];
+		if constexpr( std::is_same_v< Real , double > )
+		{
+			// [NOTE] When reading a pyramid, only the samples of the extraction level and the bounds of the coarser levels are read
+			const bool readPyramid = coarseToFine && !BBox.set && !GridGenerator::IsProcedural( job.in ) && GridPyramid::IsPyramid( job.in );
+			if( readPyramid ) pyramid.readHeader( job.in , gridToWorld );
+			else
+			{
+				grid = GridReader< Dim >::Read( job.in , gridToWorld , BBox.set ? &bbox : NULL );
+				if( coarseToFine ) pyramid = GridPyramid::Pyramid< Dim >( grid );
+			}
+			if( coarseToFine )
+			{
+				level = Level.set ? Level.value : pyramid.level( gridToWorld , Tolerance.value );
+				if( level>=pyramid.levels() )
+				{
+					WARN( "Level exceeds coarsest level: " , level , " >= " , pyramid.levels() );
+					level = pyramid.levels()-1;
+				}
+				if( readPyramid ) pyramid.read( job.in , gridToWorld , level );
+				grid = pyramid.values[level];
+			}
+		}
+		else GridReader< Dim >::ReadQuantized( job.in , grid , gridToWorld , scale , offset , BBox.set ? &bbox : NULL );
+	}
+
+	// A function returning the position of a corner, in the coordinates of the finest grid
+	auto Position = [&]( RegularGrid< Dim >::Index I ){ return coarseToFine ? pyramid.position( level , I ) : Point< double , Dim >( I ); };
+	// The iso-value in sample units
+	// [NOTE] Since quantized samples are integers, an iso-value on the integer lattice would equal the samples with that value,
+	// so it is nudged off the lattice by an amount far smaller than the quantization step (treating samples equal to the iso-value as smaller)
+	double isoValue = ( ( job.hasIsoValue ? job.isoValue : IsoValue.value ) - offset ) / scale;
+	if constexpr( std::is_integral_v< Real > ) if( isoValue==std::floor( isoValue ) ) isoValue += 1./(1<<20);
 
 	for( unsigned int d=0 ; d<Dim ; d++ ) cellRange.first[d] = cornerRange.first[d] = 0 , cellRange.second[d] = grid.res(d)-1 , cornerRange.second[d] = grid.res(d);
-	if( Verbose.set )
+	if( verbose )
 	{
 		std::cout << "Grid resolution:";
 		for( unsigned int d=0 ; d<Dim ; d++ ) std::cout << " " << grid.res(d);
 		std::cout << std::endl;
+		if( coarseToFine ) std::cout << "Level: " << level << " / " << pyramid.levels() << std::endl;
 		double min , max;
 		min = max = grid[0];
 		for( size_t i=0 ; i<grid.resolution() ; i++ ) min = std::min< double >( min , grid[i] ) , max = std::max< double >( max , grid[i] );
-		std::cout << "Min/max: " << min << " / " << max << std::endl;
+		std::cout << "Min/max: " << offset + scale * min << " / " << offset + scale * max << std::endl;
 	}
 
-	// An ordered map to track the level-set vertices associated with edges
-	std::map< MultiIndex< Dim > , unsigned int > levelSetVertexMap;
-
-	// Functionality for adding the level-set associated with a simplex
+	// Functionality for adding the level-set associated with a simplex, returning true if the simplex contains part of the level-set
 	auto AddLevelSetGeometry = [&]( SimplexIndex< Dim , RegularGrid< Dim >::Index > s )
 		{
+			TriangleCount.add();
 			// Given a triangle T = { (i_0,j_0) , (i_1,j_1) , (i_2,j_2) }
-			double values[] = { grid( s[0] ) , grid( s[1] ) , grid( s[2] ) };
+			Real values[] = { grid( s[0] ) , grid( s[1] ) , grid( s[2] ) };
 
 			unsigned int lCount=0 , gCount=0;
 			for( unsigned int d=0 ; d<=Dim ; d++ )
-				if     ( values[d]<IsoValue.value ) lCount++;
-				else if( values[d]>IsoValue.value ) gCount++;
+				if     ( values[d]<isoValue ) lCount++;
+				else if( values[d]>isoValue ) gCount++;
 
-			if( lCount+gCount!=Dim+1 ) ERROR_OUT( "Not in general position" );
-			if( lCount==0 || lCount==Dim+1 ) return;
+			if( lCount+gCount!=Dim+1 ) THROW( "Not in general position" );
+			if( lCount==0 || lCount==Dim+1 ) return false;
+			ActiveTriangleCount.add();
 
 			SimplexIndex< Dim-1 > edge;
 
 			if( lCount==1 )
 			{
-				unsigned int ltIdx = -1;
-				for( unsigned int d=0 ; d<=Dim ; d++ ) if( values[d]<IsoValue.value ) ltIdx = d;
+				unsigned int ltIdx = (unsigned int)-1;
+				for( unsigned int d=0 ; d<=Dim ; d++ ) if( values[d]<isoValue ) ltIdx = d;
 
-				if( ltIdx==-1 ) ERROR_OUT( "Could not find less than vertex" );
+				if( ltIdx==(unsigned int)-1 ) THROW( "Could not find less than vertex" );
 
 				// The 2D index of the less-than corner is: ( s[ltIdx][0] , s[ltIdx][1] )
 				// 20 - 21 - 22 - 23  - 24
@@ -134,22 +224,22 @@ int main( int argc , char *argv[] )
 					// alpha = values[ltIdx] - values[ltIdx] * t + values[gtIdx] * t
 					// alpha - values[ltIdx] = t * ( values[gtIdx] - values[ltIdx] )
 					// ( alpha - values[ltIdx] ) / ( values[gtIdx] - values[ltIdx] ) = t
-					double t = ( IsoValue.value - values[ltIdx] ) / ( values[gtIdx] - values[ltIdx] );
-					Point< double , Dim > p;
-					for( unsigned int d=0 ; d<Dim ; d++ ) p[d] = s[ltIdx][d] * ( 1.-t ) + s[gtIdx][d] * t;
+					double t = ( isoValue - (double)values[ltIdx] ) / ( (double)values[gtIdx] - (double)values[ltIdx] );
+					Point< double , Dim > p = Position( s[ltIdx] ) * ( 1.-t ) + Position( s[gtIdx] ) * t;
 
 					unsigned int gtLinearIndex = Linearize( s[gtIdx] , cornerRange );
 
 					MultiIndex< 2 > mi( ltLinearIndex , gtLinearIndex );
-					unsigned int vIdx;
+					bool inserted;
+					unsigned int &vIdx = levelSetVertexMap.insert( mi , inserted );
+					MapLookupCount.add();
 
-					if( levelSetVertexMap.find( mi )==levelSetVertexMap.end() )
+					if( inserted )
 					{
+						MapInsertionCount.add();
 						vIdx = (unsigned int)levelSetVertices.size();
 						levelSetVertices.push_back( p );
-						levelSetVertexMap[ mi ] = vIdx;
 					}
-					else vIdx = levelSetVertexMap[ mi ];
 
 					edge[i] = vIdx;
 				}
@@ -157,10 +247,10 @@ int main( int argc , char *argv[] )
 			}
 			else if( lCount==2 )
 			{
-				unsigned int gtIdx = -1;
-				for( unsigned int d=0 ; d<=Dim ; d++ ) if( values[d]>IsoValue.value ) gtIdx = d;
+				unsigned int gtIdx = (unsigned int)-1;
+				for( unsigned int d=0 ; d<=Dim ; d++ ) if( values[d]>isoValue ) gtIdx = d;
 
-				if( gtIdx==-1 ) ERROR_OUT( "Could not find less than vertex" );
+				if( gtIdx==(unsigned int)-1 ) THROW( "Could not find less than vertex" );
 				unsigned int gtLinearIndex = Linearize( s[gtIdx] , cornerRange );
 
 				for( unsigned int i=0 ; i<2 ; i++ )
@@ -171,28 +261,29 @@ int main( int argc , char *argv[] )
 					// alpha = values[ltIdx] - values[ltIdx] * t + values[gtIdx] * t
 					// alpha - values[ltIdx] = t * ( values[gtIdx] - values[ltIdx] )
 					// ( alpha - values[ltIdx] ) / ( values[gtIdx] - values[ltIdx] ) = t
-					double t = ( IsoValue.value - values[ltIdx] ) / ( values[gtIdx] - values[ltIdx] );
-					Point< double , Dim > p;
-					for( unsigned int d=0 ; d<Dim ; d++ ) p[d] = s[ltIdx][d] * ( 1.-t ) + s[gtIdx][d] * t;
+					double t = ( isoValue - (double)values[ltIdx] ) / ( (double)values[gtIdx] - (double)values[ltIdx] );
+					Point< double , Dim > p = Position( s[ltIdx] ) * ( 1.-t ) + Position( s[gtIdx] ) * t;
 
 					unsigned int ltLinearIndex = Linearize( s[ltIdx] , cornerRange );
 
 					MultiIndex< 2 > mi( ltLinearIndex , gtLinearIndex );
-					unsigned int vIdx;
+					bool inserted;
+					unsigned int &vIdx = levelSetVertexMap.insert( mi , inserted );
+					MapLookupCount.add();
 
-					if( levelSetVertexMap.find( mi )==levelSetVertexMap.end() )
+					if( inserted )
 					{
+						MapInsertionCount.add();
 						vIdx = (unsigned int)levelSetVertices.size();
 						levelSetVertices.push_back( p );
-						levelSetVertexMap[ mi ] = vIdx;
 					}
-					else vIdx = levelSetVertexMap[ mi ];
 
 					edge[i] = vIdx;
 				}
 				std::swap< unsigned int >( edge[0] , edge[1] );
 				levelSetEdges.push_back( edge );
 			}
+			return true;
 		};
 
 	// Functionality for adding the level-set associated with a cell
@@ -200,7 +291,7 @@ int main( int argc , char *argv[] )
 	ProgressBar progressBar( 10 , cellRange.second[0] - cellRange.first[0] , progressText , false );
 	auto GetCellLevelSet = [&]( RegularGrid< Dim >::Index I )
 		{
-			if( Progress.set )
+			if( progress )
 			{
 				bool show = true;
 				for( unsigned int d=1 ; d<Dim ; d++ ) if( I[d] ) show = false;
@@ -212,29 +303,115 @@ int main( int argc , char *argv[] )
 			}
 
 			CellSimplices< Dim > cellSimplices( I );
-			AddLevelSetGeometry( cellSimplices[0] );
-			AddLevelSetGeometry( cellSimplices[1] );
+			bool active0 = AddLevelSetGeometry( cellSimplices[0] ) , active1 = AddLevelSetGeometry( cellSimplices[1] );
+			CellCount.add();
+			if( active0 || active1 ) ActiveCellCount.add();
 		};
 	// Iterate over the cells and add the level sets
 	subTimer.reset();
-	cellRange.process( GetCellLevelSet );
+	{
+		Instrumentation::Scope scope( "extract" );
+		// When extracting coarse-to-fine, only the cells whose ancestors' bounds contain the iso-value are visited
+		// Otherwise, if a block size is given, the cells are visited block by block so that the corners of consecutive cells are close in memory
+		if( coarseToFine ) pyramid.processActiveCells( level , isoValue , GetCellLevelSet );
+		else if( BlockSize.value ) BlockedGrid::Process< Dim >( cellRange , BlockSize.value , GetCellLevelSet );
+		else cellRange.process( GetCellLevelSet );
+	}
 
-	// Transform vertices into world coordinates
-	for( unsigned int i=0 ; i<levelSetVertices.size() ; i++ ) levelSetVertices[i] = gridToWorld * levelSetVertices[i];
-	if( Verbose.set )
+	if( verbose )
 	{
 		std::cout << "Got level-set: " << subTimer() << std::endl;
 		std::cout << "Vertices/edges: " << levelSetVertices.size() << " / " << levelSetEdges.size() << std::endl;
 	}
 
-	if( Out.set )
+	// Simplify the level-set before it is transformed, smoothed, or written, measuring distances in grid (or world) units
+	if( SimplifyTolerance.set )
 	{
-		Factory vertexFactory;
-		PLY::WriteSimplices( Out.value , vertexFactory , levelSetVertices , levelSetEdges , ASCII.set ? PLY_ASCII : PLY_BINARY_NATIVE );
+		subTimer.reset();
+		std::vector< bool > retained;
+		if( SimplifyWorld.set )
+		{
+			std::vector< Point< double , Dim > > positions( levelSetVertices.size() );
+			for( unsigned int i=0 ; i<levelSetVertices.size() ; i++ ) positions[i] = gridToWorld * levelSetVertices[i];
+			retained = CurveSimplifier::Simplify( positions , levelSetEdges , SimplifyTolerance.value );
+		}
+		else retained = CurveSimplifier::Simplify( levelSetVertices , levelSetEdges , SimplifyTolerance.value );
+		CurveSimplifier::Compact( levelSetVertices , levelSetEdges , retained );
+		if( verbose )
+		{
+			std::cout << "Simplified level-set: " << subTimer() << std::endl;
+			std::cout << "Vertices/edges: " << levelSetVertices.size() << " / " << levelSetEdges.size() << std::endl;
+		}
 	}
 
-	if( Performance.set ) std::cout << "Performance: " << timer() << ", " << Miscellany::MemoryInfo::PeakMemoryUsageMB() << " (MB)" << std::endl;
+	// Transform vertices into world coordinates
+	for( unsigned int i=0 ; i<levelSetVertices.size() ; i++ ) levelSetVertices[i] = gridToWorld * levelSetVertices[i];
+
+	// Smooth the level-set and/or convert it to a tube, and write out the result
+	CurveOutput::Process( CurveParameters , levelSetVertices , levelSetEdges , workspace.tubeVertices , workspace.tubeTriangles , job.out , ASCII.set , verbose );
+}
+
+// Reads the header of the job's grid and extracts the level-set, using the thread's workspace for the grid's type, and sets the size of the output in the report
+void Execute( const Batch::Job &job , Batch::Workspaces &workspaces , Batch::Report &report , bool verbose , bool progress )
+{
+	unsigned int dataDim;
+	std::string dataName;
+	GridReader< Dim >::ReadHeader( job.in , dataDim , dataName );
+	if( dataDim!=1 ) THROW( "Only one-dimensional values per cell supported: " , dataDim );
+
+	auto _Execute = [&]< typename Real >( void )
+		{
+			Workspace< Real > &workspace = workspaces.get< Workspace< Real > >();
+			Execute( job , workspace , verbose , progress );
+			if( CurveParameters.tubularRadius.set ) report.vertices = workspace.tubeVertices.size() , report.simplices = workspace.tubeTriangles.size();
+			else                                    report.vertices = workspace.levelSetVertices.size() , report.simplices = workspace.levelSetEdges.size();
+		};
+
+	// [NOTE] Coarse-to-fine extraction reads (and if necessary dequantizes) the grid as doubles
+	if( Level.set || Tolerance.set ) _Execute.template operator()< double >();
+	else if( dataName==QuantizedGrid::Type< unsigned char  >::Name ) _Execute.template operator()< unsigned char  >();
+	else if( dataName==QuantizedGrid::Type< unsigned short >::Name ) _Execute.template operator()< unsigned short >();
+	else _Execute.template operator()< double >();
+}
+
+int main( int argc , char *argv[] )
+{
+	Misha::CmdLineParse( argc-1 , argv+1 , params );
+	if( !In.set && !Manifest.set )
+	{
+		ShowUsage( argv[0] );
+		return EXIT_SUCCESS;
+	}
+	CurveParameters.validate();
+	if( Stats.set || Trace.set ) Instrumentation::Enable();
+
+	Miscellany::Timer timer;
 
+	// In batch mode, each job reads its own header, so the grids in the manifest can have different types
+	if( Manifest.set )
+	{
+		std::vector< Batch::Job > jobs = Batch::ReadManifest( Manifest.value );
+		if( !jobs.size() ) ERROR_OUT( "No jobs in manifest: " , Manifest.value );
+
+		std::vector< Batch::Workspaces > workspaces( omp_get_max_threads() );
+		std::vector< Batch::Report > reports = Batch::Process( jobs , [&]( const Batch::Job &job , unsigned int thread , Batch::Report &report ){ Execute( job , workspaces[thread] , report , false , false ); } );
+		Batch::Summarize( jobs , reports , Verbose.set );
+		if( BatchReport.set ) Batch::WriteReport( BatchReport.value , jobs , reports );
+	}
+	else
+	{
+		Batch::Job job;
+		job.in = In.value;
+		if( Out.set ) job.out = Out.value;
+		Batch::Workspaces workspaces;
+		Batch::Report report;
+		try{ Execute( job , workspaces , report , Verbose.set , Progress.set ); }
+		catch( const std::exception &e ){ ERROR_OUT( e.what() ); }
+	}
+
+	if( Performance.set ) std::cout << "Performance: " << timer() << ", " << Miscellany::MemoryInfo::PeakMemoryUsageMB() << " (MB)" << std::endl;
+	if( Stats.set ) Instrumentation::WriteStats( Stats.value , "MarchingTriangles" );
+	if( Trace.set ) Instrumentation::WriteTrace( Trace.value , "MarchingTriangles" );
 
 	return EXIT_SUCCESS;
 }
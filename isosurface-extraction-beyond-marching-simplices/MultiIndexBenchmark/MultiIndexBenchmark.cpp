@@ -0,0 +1,199 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <map>
+#include <unordered_map>
+#include <tuple>
+#include <iostream>
+#include <random>
+#include <type_traits>
+#include "Misha/Miscellany.h"
+#include "Misha/CmdLineParser.h"
+#include "Misha/Geometry.h"
+#include "Misha/RegularGrid.h"
+#include "Include/MultiIndex.h"
+#include "Include/CellSimplices.h"
+#include "Include/Timings.h"
+
+static const unsigned int Dim = 2;
+
+Misha::CmdLineParameter< std::string > Out( "out" ) , Baseline( "baseline" );
+Misha::CmdLineParameter< unsigned int > MaxResolution( "maxRes" , 1025 ) , Trials( "trials" , 5 ) , Seed( "seed" , 0 );
+Misha::CmdLineParameter< double > Active( "active" , 0.05 ) , Slack( "slack" , 1.5 );
+Misha::CmdLineReadable RunDefaults( "run" ) , Verbose( "verbose" );
+
+Misha::CmdLineReadable* params[] =
+{
+	&RunDefaults ,
+	&Out ,
+	&Baseline ,
+	&MaxResolution ,
+	&Trials ,
+	&Seed ,
+	&Active ,
+	&Slack ,
+	&Verbose ,
+	NULL
+};
+
+void ShowUsage( const char* ex )
+{
+	std::cout << "Usage " << std::string( ex ) << ":" << std::endl;
+	std::cout << "\t[--" << RunDefaults.name << "] (runs the benchmark if no other argument is given)" << std::endl;
+	std::cout << "\t[--" << Out.name << " <output timings (CSV)>]" << std::endl;
+	std::cout << "\t[--" << Baseline.name << " <baseline timings (CSV)>]" << std::endl;
+	std::cout << "\t[--" << MaxResolution.name << " <maximum grid resolution>=" << MaxResolution.value << "]" << std::endl;
+	std::cout << "\t[--" << Trials.name << " <number of passes per measurement>=" << Trials.value << "]" << std::endl;
+	std::cout << "\t[--" << Seed.name << " <random seed>=" << Seed.value << "]" << std::endl;
+	std::cout << "\t[--" << Active.name << " <fraction of cells crossed by the level-set>=" << Active.value << "]" << std::endl;
+	std::cout << "\t[--" << Slack.name << " <allowed slow-down relative to the baseline>=" << Slack.value << "]" << std::endl;
+	std::cout << "\t[--" << Verbose.name << "]" << std::endl;
+}
+
+// The maximum number of entries in the dense map for which it will be benchmarked
+static const size_t MaxDenseMapStorage = 1<<26;
+
+// The number of entries in the dense map, Choose( n , k ), computed without overflow
+size_t DenseMapStorage( unsigned int n , unsigned int k )
+{
+	size_t storage = 1;
+	for( unsigned int i=0 ; i<k ; i++ ) storage = ( storage * ( n-i ) ) / ( i+1 );
+	return storage;
+}
+
+enum Method
+{
+	STD_MAP ,
+	STD_UNORDERED_MAP ,
+	DENSE_MAP ,
+	HASH_MAP ,
+	METHOD_COUNT
+};
+const std::string MethodNames[] = { "std::map" , "std::unordered_map" , "MultiIndex::Map" , "MultiIndex::HashMap" };
+
+// A (key size , grid resolution , method) key
+using Key = std::tuple< unsigned int , unsigned int , std::string >;
+
+// Returns the sequence of multi-indices looked up when extracting a level-set crossing the active cells of a grid:
+// The vertices of the triangles for K=Dim+1 (as in MultiMarchingTriangles) and the vertices of their edges for K=Dim (as in MarchingTriangles)
+template< unsigned int K >
+std::vector< MultiIndex< K > > Keys( unsigned int res , std::mt19937 &generator )
+{
+	std::uniform_real_distribution< double > uniform( 0. , 1. );
+	RegularGrid< Dim >::Range cellRange , cornerRange;
+	for( unsigned int d=0 ; d<Dim ; d++ ) cellRange.first[d] = cornerRange.first[d] = 0 , cellRange.second[d] = res-1 , cornerRange.second[d] = res;
+
+	auto Linearize = [&]( RegularGrid< Dim >::Index I )
+		{
+			unsigned int idx = I[0];
+			for( unsigned int d=1 ; d<Dim ; d++ ) idx = idx * res + I[d];
+			return idx;
+		};
+
+	std::vector< MultiIndex< K > > keys;
+	cellRange.process( [&]( RegularGrid< Dim >::Index I )
+		{
+			if( uniform( generator )>Active.value ) return;
+			CellSimplices< Dim > cellSimplices( I );
+			for( unsigned int s=0 ; s<CellSimplices< Dim >::Num ; s++ )
+			{
+				SimplexIndex< Dim , RegularGrid< Dim >::Index > t = cellSimplices[s];
+				if constexpr( K==Dim+1 ) keys.push_back( MultiIndex< K >( Linearize( t[0] ) , Linearize( t[1] ) , Linearize( t[2] ) ) );
+				else for( unsigned int d=0 ; d<=Dim ; d++ ) keys.push_back( MultiIndex< K >( Linearize( t[(d+1)%(Dim+1)] ) , Linearize( t[(d+2)%(Dim+1)] ) ) );
+			}
+		} );
+	return keys;
+}
+
+// Assigns consecutive indices to the distinct keys, in the order in which they are first seen, and returns a checksum of the assigned indices
+template< typename Map , unsigned int K >
+unsigned long long Process( Map &map , const std::vector< MultiIndex< K > > &keys )
+{
+	unsigned long long checksum = 0;
+	unsigned int count = 0;
+	for( size_t i=0 ; i<keys.size() ; i++ )
+	{
+		unsigned int &idx = map[ keys[i] ];
+		if( !idx ) idx = ++count;
+		checksum += idx;
+	}
+	return checksum;
+}
+
+template< unsigned int K >
+void Benchmark( std::mt19937 &generator , std::map< Key , std::pair< double , unsigned int > > &timings )
+{
+	for( unsigned int res=17 ; res<=MaxResolution.value ; res=2*res-1 )
+	{
+		std::vector< MultiIndex< K > > keys = Keys< K >( res , generator );
+		if( !keys.size() ) continue;
+		unsigned int vertexNum = res * res;
+
+		double nsPerLookup[METHOD_COUNT];
+		unsigned long long checksums[METHOD_COUNT];
+		for( unsigned int m=0 ; m<METHOD_COUNT ; m++ )
+		{
+			nsPerLookup[m] = -1;
+			if( m==DENSE_MAP && DenseMapStorage( vertexNum , K )>MaxDenseMapStorage ) continue;
+
+			std::map< MultiIndex< K > , unsigned int > stdMap;
+			std::unordered_map< MultiIndex< K > , unsigned int , typename MultiIndex< K >::Hash > stdUnorderedMap;
+			typename MultiIndex< K >::template Map< unsigned int > denseMap;
+			typename MultiIndex< K >::template HashMap< unsigned int > hashMap;
+			if( m==DENSE_MAP ) denseMap.resize( vertexNum );
+
+			// Each pass starts from an empty map, reusing the memory of the previous pass where the map allows it
+			Miscellany::Timer timer;
+			for( unsigned int t=0 ; t<Trials.value ; t++ )
+			{
+				switch( m )
+				{
+				case STD_MAP:           stdMap.clear()          ; checksums[m] = Process( stdMap , keys )          ; break;
+				case STD_UNORDERED_MAP: stdUnorderedMap.clear() ; checksums[m] = Process( stdUnorderedMap , keys ) ; break;
+				case DENSE_MAP:         denseMap.clear()        ; checksums[m] = Process( denseMap , keys )        ; break;
+				case HASH_MAP:          hashMap.clear()         ; checksums[m] = Process( hashMap , keys )         ; break;
+				default: ERROR_OUT( "Unrecognized method: " , m );
+				}
+			}
+			nsPerLookup[m] = ( timer() * 1e9 ) / ( (double)Trials.value * keys.size() );
+		}
+
+		for( unsigned int m=0 ; m<METHOD_COUNT ; m++ ) if( nsPerLookup[m]>=0 )
+		{
+			// All the maps should assign the same indices as the ordered map
+			unsigned int mismatch = checksums[m]!=checksums[STD_MAP] ? 1 : 0;
+			timings[ Key( K , res , MethodNames[m] ) ] = std::pair< double , unsigned int >( nsPerLookup[m] , mismatch );
+			if( Verbose.set ) std::cout << "\t" << K << " " << res << " " << MethodNames[m] << ": " << nsPerLookup[m] << " (ns) " << keys.size() << " lookups" << std::endl;
+		}
+		std::cout << "K " << K << " , resolution " << res << ": " << keys.size() << " lookups , " << MethodNames[HASH_MAP] << " " << nsPerLookup[STD_MAP] / nsPerLookup[HASH_MAP] << "x faster than " << MethodNames[STD_MAP] << std::endl;
+	}
+}
+
+int main( int argc , char* argv[] )
+{
+	Misha::CmdLineParse( argc-1 , argv+1 , params );
+	// [NOTE] Since all the parameters are optional, the benchmark runs only if some argument is given, with --run running it with the default settings
+	if( argc<2 )
+	{
+		ShowUsage( argv[0] );
+		return EXIT_SUCCESS;
+	}
+
+	std::mt19937 generator( Seed.value );
+	std::map< Key , std::pair< double , unsigned int > > timings;
+
+	Benchmark< Dim   >( generator , timings );
+	Benchmark< Dim+1 >( generator , timings );
+
+	if( Out.set ) Timings::Write( Out.value , "k,resolution,method,ns_per_lookup,mismatches" , timings , []( std::pair< double , unsigned int > t ){ return std::make_tuple( t.first , t.second ); } );
+
+	bool success = true;
+	for( auto iter=timings.begin() ; iter!=timings.end() ; iter++ ) if( iter->second.second )
+	{
+		std::cerr << "[FAILURE] Index mismatch: " << Timings::ToString( iter->first ) << std::endl;
+		success = false;
+	}
+
+	if( Baseline.set && !Timings::CheckBaseline( Baseline.value , timings , Slack.value , []( std::pair< double , unsigned int > t ){ return t.first; } ) ) success = false;
+
+	return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
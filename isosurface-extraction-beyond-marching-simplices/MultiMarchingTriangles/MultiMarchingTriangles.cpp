@@ -12,87 +12,181 @@
 #include "Misha/Ply.h"
 #include "Misha/PlyVertexData.h"
 #include "Include/GridReader.h"
+#include "Include/BlockedGrid.h"
 #include "Include/MultiIndex.h"
 #include "Include/CellSimplices.h"
+#include "Include/CurveOutput.h"
+#include "Include/CurveSimplifier.h"
+#include "Include/Instrumentation.h"
 #include "Include/SimplexFunctions.h"
 #include "Include/ConvexHull.h"
+#include "Include/Batch.h"
 
 static const unsigned int Dim = 2;
 
 #define USE_CONVEX_HULL
+#define BATCH_SIMPLE_HULL	// Compute the (simple) hulls of a row's triangles together
 
 
-Misha::CmdLineParameter< std::string > In( "in" ) , Out( "out" );
-Misha::CmdLineReadable Verbose( "verbose" ) , Progress( "progress" ) , Performance( "performance" ) , ASCII( "ascii" ) , Progess( "progress" ) , NoCulling( "noCulling" ) , NoConvexHull( "noHull" );
+Misha::CmdLineParameter< std::string > In( "in" ) , Out( "out" ) , Stats( "stats" ) , Trace( "trace" ) , Manifest( "batch" ) , BatchReport( "report" );
+Misha::CmdLineParameter< double > SimplifyTolerance( "simplify" , 0. );
+Misha::CmdLineParameter< unsigned int > BlockSize( "block" , 0 );
+Misha::CmdLineParameterArray< int , 2*Dim > BBox( "bbox" );
+CurveOutput::Parameters CurveParameters;
+Misha::CmdLineReadable Verbose( "verbose" ) , Progress( "progress" ) , Performance( "performance" ) , ASCII( "ascii" ) , Progess( "progress" ) , NoCulling( "noCulling" ) , NoConvexHull( "noHull" ) , SimplifyWorld( "simplifyWorld" );
 Misha::CmdLineReadable* params[] =
 {
 	&In ,
 	&Out ,
+	&Manifest ,
+	&BatchReport ,
+	&BBox ,
+	&SimplifyTolerance ,
+	&SimplifyWorld ,
+	&CurveParameters.diffusionTime ,
+	&CurveParameters.tubularRadius ,
+	&CurveParameters.angularResolution ,
+	&BlockSize ,
 	&NoCulling ,
 	&NoConvexHull ,
 	&Progress ,
 	&Verbose ,
 	&Performance ,
+	&Stats ,
+	&Trace ,
 	&Progress ,
 	&ASCII ,
 	NULL
 };
 
+// Counters for the extraction
+// [NOTE] The number of hulls computed by each method is counted in ConvexHull
+Instrumentation::Counter CellCount( "cells" ) , TriangleCount( "triangles" ) , CulledTriangleCount( "culled triangles" ) , ActiveTriangleCount( "active triangles" ) , MapLookupCount( "map lookups" ) , MapInsertionCount( "map insertions" );
+// The number of (non-culled) triangles whose level-set vertices are computed directly from two or three labels, or from the hull
+Instrumentation::Counter TwoLabelTriangleCount( "two-label triangles" ) , ThreeLabelTriangleCount( "three-label triangles" ) , HullTriangleCount( "hull triangles" );
+
 void ShowUsage( const char* ex )
 {
 	printf( "Usage %s:\n" , ex );
 	printf( "\t --%s <input grid>\n" , In.name.c_str() );
-	printf( "\t[--%s <output curve>]\n" , Out.name.c_str() );
+	printf( "\t[--%s <output curve (or tube)>]\n" , Out.name.c_str() );
+	printf( "\t[--%s <batch manifest (lines of: <input grid> [<output>])>]\n" , Manifest.name.c_str() );
+	printf( "\t[--%s <batch report (CSV)>]\n" , BatchReport.name.c_str() );
+	printf( "\t[--%s <bounding box min corner> <bounding box max corner (exclusive)>]\n" , BBox.name.c_str() );
+	printf( "\t[--%s <simplification tolerance (in grid units)>]\n" , SimplifyTolerance.name.c_str() );
+	printf( "\t[--%s]\n" , SimplifyWorld.name.c_str() );
+	CurveParameters.showUsage();
+	printf( "\t[--%s <cell traversal block size>]\n" , BlockSize.name.c_str() );
 	printf( "\t[--%s]\n" , NoCulling.name.c_str() );
 	printf( "\t[--%s]\n" , NoConvexHull.name.c_str() );
 	printf( "\t[--%s]\n" , Progress.name.c_str() );
 	printf( "\t[--%s]\n" , Verbose.name.c_str() );
 	printf( "\t[--%s]\n" , Performance.name.c_str() );
+	printf( "\t[--%s <output statistics (JSON)>]\n" , Stats.name.c_str() );
+	printf( "\t[--%s <output trace (Chrome trace-event JSON)>]\n" , Trace.name.c_str() );
 	printf( "\t[--%s]\n" , ASCII.name.c_str() );
 }
 
-template< unsigned int N >
-void Process( void )
+using Factory = VertexFactory::PositionFactory< double , Dim >;
+
+// The level-set vertices associated with an edge or triangle, each paired with the multi-index of the labels defining it
+// [NOTE] The vertices are stored in place so that the hash-map entries do not allocate
+template< unsigned int K , unsigned int Capacity >
+struct VertexList
+{
+	using Entry = std::pair< MultiIndex< K > , unsigned int >;
+
+	unsigned int size( void ) const { return _size; }
+	const Entry &operator[]( unsigned int i ) const { return _entries[i]; }
+	void push_back( const Entry &entry )
+	{
+		if( _size==Capacity ) THROW( "Vertex list is full (not in general position?): " , Capacity );
+		_entries[ _size++ ] = entry;
+	}
+
+protected:
+	unsigned int _size = 0;
+	Entry _entries[Capacity];
+};
+
+// In general position, the upper envelope of N linear functions has at most N-1 break-points on an edge,
+// and the vertices inside a triangle are dual to faces of the hull of N points, of which there are at most 2N-4
+template< unsigned int N > using EdgeVertexData = VertexList< Dim , N-1 >;
+template< unsigned int N > using TriangleVertexData = VertexList< Dim+1 , ( N>2 ? 2*N-4 : 1 ) >;
+template< unsigned int N > using EdgeVertexMap = MultiIndex< Dim >::HashMap< EdgeVertexData< N > >;
+template< unsigned int N > using TriangleVertexMap = MultiIndex< Dim+1 >::HashMap< TriangleVertexData< N > >;
+
+// The buffers used to extract a multi-level-set
+// [NOTE] In batch mode each thread has its own workspace for each grid type, whose buffers are cleared (but not released) between jobs
+template< unsigned int N , typename Real >
+struct Workspace
+{
+	// The regular grid of input samples
+	RegularGrid< Dim , Point< Real , N > > grid;
+	// The output level-set vertices and edges
+	std::vector< Factory::VertexType > levelSetVertices;
+	std::vector< SimplexIndex< Dim-1 > > levelSetEdges;
+	// The pair of labels separated by each level-set edge (when simplifying)
+	std::vector< unsigned int > levelSetEdgeLabels;
+	// Hash maps to track the level-set vertices associated with edges and triangles
+	EdgeVertexMap< N > edgeVertexMap;
+	TriangleVertexMap< N > triangleVertexMap;
+	// The scratch space for computing the hulls of the dual points of edges and triangles
+	ConvexHull::ConvexHullScratch< Dim > edgeHullScratch;
+	ConvexHull::ConvexHullScratch< Dim+1 > triangleHullScratch;
+	// The non-culled triangles of a row, and their hulls
+	std::vector< SimplexIndex< Dim , RegularGrid< Dim >::Index > > rowTriangles;
+	std::vector< std::vector< SimplexIndex< Dim > > > rowHulls;
+	// The labels of the row triangles reaching the upper envelope (N per triangle) and their number, and the indices of the row triangles whose hulls are computed
+	std::vector< unsigned int > rowLabels , rowLabelCounts , rowHullTriangles;
+	// The output tube vertices and triangles
+	std::vector< Point< double , Dim+1 > > tubeVertices;
+	std::vector< SimplexIndex< Dim > > tubeTriangles;
+};
+
+// Extracts the multi-level-set from a grid whose samples are N-dimensional points with coordinates of type Real
+// [NOTE] For quantized grids the samples are only converted to (normalized) weights at the corners of simplices that are not culled
+template< unsigned int N , typename Real >
+void Process( const Batch::Job &job , Workspace< N , Real > &workspace , bool verbose , bool progress )
 {
-	using Factory = VertexFactory::PositionFactory< double , Dim >;
-	using TriangleVertexData =  std::vector< std::pair< MultiIndex< Dim+1 > , unsigned int > >;
-	using EdgeVertexData = std::vector< std::pair< MultiIndex< Dim > , unsigned int > >;
-	using TriangleVertexMap = std::map< MultiIndex< Dim+1 > , TriangleVertexData >;
-	using EdgeVertexMap = std::map< MultiIndex< Dim > , EdgeVertexData >;
 
 	// A function linearizing a grid's index
 	auto Linearize = [&]( RegularGrid< Dim >::Index I , RegularGrid< Dim >::Range range )
 		{
 			unsigned int idx = I[0] - range.first[0];
-			for( unsigned int d=1 ; d<Dim ; d++ ) idx = idx * ( range.second[d-1] - range.first[d-1] ) + ( I[d] - range.first[d] );
+			for( unsigned int d=1 ; d<Dim ; d++ ) idx = idx * ( range.second[d] - range.first[d] ) + ( I[d] - range.first[d] );
 			return idx;
 		};
 
-	Miscellany::Timer timer , subTimer;
-
-	// The output level-set vertices
-	std::vector< Factory::VertexType > levelSetVertices;
-	// The output level-set edges
-	std::vector< SimplexIndex< Dim-1 > > levelSetEdges;
-	// An ordered map to track the level-set vertices associated with edges
-	EdgeVertexMap edgeVertexMap;
-	// An ordered map to track the level-set vertices associated with triangles
-	TriangleVertexMap triangleVertexMap;
+	Miscellany::Timer subTimer;
 
+	RegularGrid< Dim , Point< Real , N > > &grid = workspace.grid;
+	std::vector< Factory::VertexType > &levelSetVertices = workspace.levelSetVertices;
+	std::vector< SimplexIndex< Dim-1 > > &levelSetEdges = workspace.levelSetEdges;
+	std::vector< unsigned int > &levelSetEdgeLabels = workspace.levelSetEdgeLabels;
+	EdgeVertexMap< N > &edgeVertexMap = workspace.edgeVertexMap;
+	TriangleVertexMap< N > &triangleVertexMap = workspace.triangleVertexMap;
+	levelSetVertices.resize( 0 ) , levelSetEdges.resize( 0 ) , levelSetEdgeLabels.resize( 0 ) , edgeVertexMap.clear() , triangleVertexMap.clear();
 
 	// The transformations from grid coordinates to world coordinates
 	XForm< double , Dim+1 > gridToWorld;
-	// The regular grid of input values
-	RegularGrid< Dim , Point< double , N > > grid;
+	// The map from samples to values
+	double scale = 1. , offset = 0.;
 	// Range of grid cells and grid corners
 	// [NOTE] Grid values are associated with corners
 	RegularGrid< Dim >::Range cellRange , cornerRange;
 
 
-	// Read in the input grid
-	grid = GridReader< Dim , N >::Read( In.value , gridToWorld );
+	// Read in the input grid, restricted to the bounding box if one is given
+	{
+		Instrumentation::Scope scope( "read" );
+		RegularGrid< Dim >::Range bbox;
+		for( unsigned int d=0 ; d<Dim ; d++ ) bbox.first[d] = BBox.values[d] , bbox.second[d] = BBox.values[Dim+d];
+		if constexpr( std::is_same_v< Real , double > ) grid = GridReader< Dim , N >::Read( job.in , gridToWorld , BBox.set ? &bbox : NULL );
+		else GridReader< Dim >::ReadQuantized( job.in , grid , gridToWorld , scale , offset , BBox.set ? &bbox : NULL );
+	}
 	for( unsigned int d=0 ; d<Dim ; d++ ) cellRange.first[d] = cornerRange.first[d] = 0 , cellRange.second[d] = grid.res(d)-1 , cornerRange.second[d] = grid.res(d);
-	if( Verbose.set )
+	if( verbose )
 	{
 		std::cout << "Grid resolution:";
 		for( unsigned int d=0 ; d<Dim ; d++ ) std::cout << " " << grid.res(d);
@@ -100,55 +194,91 @@ void Process( void )
 	}
 
 	// Normalize the values to be weights in the range [0,1]
+	auto Normalize = []( Point< double , N > & v )
+		{
+			double sum = 0;
+			for( unsigned int n=0 ; n<N ; n++ ) if( v[n]>0 ) sum += v[n];
+			if( !sum ) THROW( "Could not normalize value: " , v );
+			for( unsigned int n=0 ; n<N ; n++ )
+				if( v[n]<0 ) v[n] = 0;
+				else v[n] /= sum;
+		};
+	if constexpr( std::is_same_v< Real , double > )
 	{
+		Instrumentation::Scope scope( "normalize" );
 		subTimer.reset();
-		auto Normalize = []( Point< double , N > & v )
-			{
-				double sum = 0;
-				for( unsigned int n=0 ; n<N ; n++ ) if( v[n]>0 ) sum += v[n];
-				if( !sum ) ERROR_OUT( "Could not normalize value: " , v );
-				for( unsigned int n=0 ; n<N ; n++ )
-					if( v[n]<0 ) v[n] = 0;
-					else v[n] /= sum;
-			};
 		cornerRange.process( [&]( RegularGrid< Dim >::Index I ){ Normalize( grid(I) ); } );
 
-		if( Verbose.set ) std::cout << "Normalized: " << subTimer() << std::endl;
+		if( verbose ) std::cout << "Normalized: " << subTimer() << std::endl;
 	}
 
-	// Functionality for adding the level-set vertices associated with an edge
+	// Functionality for getting the weights at a corner
+	// [NOTE] Since the scale is positive, and normalization divides by a positive sum, comparisons between the samples' coordinates
+	// are consistent with comparisons between the weights (though distinct negative values become equal weights)
+	auto Weights = [&]( RegularGrid< Dim >::Index I )
+		{
+			if constexpr( std::is_same_v< Real , double > ) return grid(I);
+			else
+			{
+				Point< double , N > v;
+				for( unsigned int n=0 ; n<N ; n++ ) v[n] = offset + scale * grid(I)[n];
+				Normalize( v );
+				return v;
+			}
+		};
+
+	// Functionality for gathering the labels that can reach the upper envelope of the functions fit to the weights at the corners of a simplex, returning the number of labels (in increasing order)
+	// A label is discarded if another label is at least as large at all corners, and either larger at some corner or (if the two are equal) has a smaller index
+	// [NOTE] Since the functions are linear, a label dominated at all corners is dominated everywhere on the simplex, so the retained labels define the same upper envelope
+	// [NOTE] Since dominance is transitive, every discarded label is dominated by a retained one
+	auto ActiveLabels = [&]( const Point< double , N > w[] , unsigned int cornerCount , unsigned int labels[N] )
+		{
+			unsigned int count = 0;
+			for( unsigned int n=0 ; n<N ; n++ )
+			{
+				bool dominated = false;
+				for( unsigned int m=0 ; m<N && !dominated ; m++ ) if( m!=n )
+				{
+					bool geq = true , gt = false;
+					for( unsigned int c=0 ; c<cornerCount && geq ; c++ )
+						if     ( w[c][m]<w[c][n] ) geq = false;
+						else if( w[c][m]>w[c][n] ) gt = true;
+					dominated = geq && ( gt || m<n );
+				}
+				if( !dominated ) labels[ count++ ] = n;
+			}
+			return count;
+		};
 
+	// Functionality for adding the level-set vertices associated with an edge
+	// [NOTE] If at most two labels reach the upper envelope, the only vertex is the zero crossing of their difference and the hull is not computed
+	// [NOTE] Otherwise, the hull is computed over the dual points of the labels that reach the upper envelope and its indices are mapped back to the labels
 	auto AddEdgeVertices = [&]( SimplexIndex< Dim-1 , RegularGrid< Dim >::Index > e )
 		{
 			MultiIndex< Dim > mi( Linearize( e[0] , cornerRange ) , Linearize( e[1] , cornerRange ) );
 
 			// Check if the edge's vertices have already been computed
-			if( edgeVertexMap.find( mi )!=edgeVertexMap.end() ) return mi;
+			MapLookupCount.add();
+			if( edgeVertexMap.find( mi ) ) return mi;
 
 			// If they have not already been added, add them now
-			std::vector< std::pair< MultiIndex< Dim > , unsigned int > > vertices;
+			EdgeVertexData< N > vertices;
 
 			// Fit functions to the corner values
+			const Point< double , N > w[] = { Weights( e[0] ) , Weights( e[1] ) };
 			SimplexFunction< Dim-1 > f[N];
-			for( unsigned int n=0 ; n<N ; n++ ) f[n] = SimplexFunction< Dim-1 >( grid( e[0] )[n] , grid( e[1] )[n] );
+			for( unsigned int n=0 ; n<N ; n++ ) f[n] = SimplexFunction< Dim-1 >( w[0][n] , w[1][n] );
 
 			if( !NoConvexHull.set )
 			{
-				std::vector< Point< double , Dim > > duals( N );
-				for( unsigned int n=0 ; n<N ; n++ ) duals[n] = f[n].dual();
-
-				std::vector< SimplexIndex< Dim-1 > > hull = ConvexHull::ConvexHull( duals , false );
-				for( unsigned int i=0 ; i<hull.size() ; i++ )
-				{
-					SimplexIndex< Dim-1 > si = hull[i];
-					Simplex< double , Dim , Dim-1 > s;
-					for( unsigned int d=0 ; d<Dim ; d++ ) s[d] = duals[ si[d] ];
-					if( s.normal()[0]<0 )
+				// Adds the point of intersection of the two functions, if it is on the edge
+				// [NOTE] The functions are intersected in the order of their labels, so the position does not depend on how the labels were found
+				auto AddVertex = [&]( MultiIndex< Dim > mi )
 					{
-						// Find the point of intersection of the three functions, dual to the corners of a hull triangle
-						Point< double , Dim-1 > x;
-						try{ x = SimplexFunction< Dim-1 >::Intersect( f[ si[0] ] , f[ si[1] ] ); }
-						catch( Misha::Exception ){ ERROR_OUT( "Expected intersection" ); }
+						bool success;
+						const SimplexFunction< Dim-1 > _f[] = { f[ mi[0] ] , f[ mi[1] ] };
+						Point< double , Dim-1 > x = SimplexFunction< Dim-1 >::TryIntersect( _f , success );
+						if( !success ) THROW( "Expected intersection" );
 
 						// Check that the position is on the edge
 						if( x[0]>=0 && x[0]<=1 )
@@ -156,31 +286,54 @@ void Process( void )
 							// Compute the world coordinates of the position
 							Point< double , 2 > p = Point< double , 2 >( e[0] ) * ( 1. - x[0] ) + Point< double , 2 >( e[1] ) * x[0] ;
 
-							// Add to the triangle-to-vertex-index map, and add to the list of vertices
-							vertices.push_back( std::pair< MultiIndex< Dim > , unsigned int >( MultiIndex< Dim >( si[0] , si[1] ) , (unsigned int)levelSetVertices.size() ) );
+							// Add to the edge-to-vertex-index map, and add to the list of vertices
+							vertices.push_back( std::pair< MultiIndex< Dim > , unsigned int >( mi , (unsigned int)levelSetVertices.size() ) );
 							levelSetVertices.push_back( p );
 						}
+					};
+
+				unsigned int labels[N];
+				unsigned int labelCount = ActiveLabels( w , Dim , labels );
+				if( labelCount<=Dim )
+				{
+					if( labelCount==Dim ) AddVertex( MultiIndex< Dim >( labels[0] , labels[1] ) );
+				}
+				else
+				{
+					std::vector< Point< double , Dim > > duals( N ) , activeDuals( labelCount );
+					for( unsigned int n=0 ; n<N ; n++ ) duals[n] = f[n].dual();
+					for( unsigned int i=0 ; i<labelCount ; i++ ) activeDuals[i] = duals[ labels[i] ];
+
+					std::vector< SimplexIndex< Dim-1 > > hull = ConvexHull::ConvexHull( activeDuals , workspace.edgeHullScratch , false );
+					for( unsigned int i=0 ; i<hull.size() ; i++ )
+					{
+						SimplexIndex< Dim-1 > si = hull[i];
+						for( unsigned int d=0 ; d<Dim ; d++ ) si[d] = labels[ si[d] ];
+						Simplex< double , Dim , Dim-1 > s;
+						for( unsigned int d=0 ; d<Dim ; d++ ) s[d] = duals[ si[d] ];
+						// The intersection of the two functions, dual to the end-points of a hull edge
+						if( s.normal()[0]<0 ) AddVertex( MultiIndex< Dim >( si[0] , si[1] ) );
 					}
 				}
 			}
 			else
 			{
+				const SimplexFunctionBatch< Dim-1 , N > functions( f );
+
 				// For every pair of functions, find the point where the functions are equal, check if that is the maximal value, and add the point if it is
 				for( unsigned int i=0 ; i<N ; i++ ) for( unsigned int j=0 ; j<i ; j++ )
 				{
-					Point< double , 1 > x;
-					bool foundIntersection = true;
-					try{ x = SimplexFunction< 1 >::Intersect( f[i] , f[j] ); }
-					catch( Misha::Exception ){ foundIntersection = false; }
+					bool foundIntersection;
+					const SimplexFunction< Dim-1 > _f[] = { f[i] , f[j] };
+					Point< double , Dim-1 > x = SimplexFunction< Dim-1 >::TryIntersect( _f , foundIntersection );
 					if( !foundIntersection ) continue;
 
 					// Check that the position is on the edge
 					if( x[0]>=0 && x[0]<=1 )
 					{
 						// Check that the value is maximized by the pair (i,j)
-						bool isMax = true;
-						for( unsigned int k=0 ; k<N ; k++ ) if( k!=i && k!=j ) if( f[k](x)>f[i](x) ) isMax = false;
-						if( isMax )
+						const unsigned int indices[] = { i , j };
+						if( functions.isMaximal( x , indices , 2 ) )
 						{
 							// Compute the world coordinates of the position
 							Point< double , 2 > p = Point< double , 2 >( e[0] ) * ( 1. - x[0] ) + Point< double , 2 >( e[1] ) * x[0];
@@ -194,40 +347,58 @@ void Process( void )
 			}
 
 			edgeVertexMap[ mi ] = vertices;
+			MapInsertionCount.add();
 			return mi;
 		};
 
+	// Functionality for computing the dual points of the functions fit to the corner values of a triangle
+	auto SetTriangleDuals = [&]( SimplexIndex< Dim , RegularGrid< Dim >::Index > t , Point< double , Dim+1 > duals[N] )
+		{
+			const Point< double , N > w[] = { Weights( t[0] ) , Weights( t[1] ) , Weights( t[2] ) };
+			for( unsigned int n=0 ; n<N ; n++ ) duals[n] = SimplexFunction< Dim >( w[0][n] , w[1][n] , w[2][n] ).dual();
+		};
+
+	// Functionality for gathering the labels that can reach the upper envelope of the functions fit to the corner values of a triangle, returning the number of labels
+	auto TriangleLabels = [&]( SimplexIndex< Dim , RegularGrid< Dim >::Index > t , unsigned int labels[N] )
+		{
+			const Point< double , N > w[] = { Weights( t[0] ) , Weights( t[1] ) , Weights( t[2] ) };
+			return ActiveLabels( w , Dim+1 , labels );
+		};
+
 	// Functionality for adding the level-set vertices associated with a triangle
-	auto AddTriangleVertices = [&]( SimplexIndex< Dim , RegularGrid< Dim >::Index > t )
+	// [NOTE] If the hull of the dual points has already been computed, it can be passed in (indexed by label)
+	// [NOTE] Otherwise, if the labels reaching the upper envelope have already been gathered, they can be passed in
+	// [NOTE] If at most three labels reach the upper envelope, the only possible vertex is the point where the three functions are equal and the hull is not computed
+	// [NOTE] Otherwise, the hull is computed over the dual points of the labels that reach the upper envelope and its indices are mapped back to the labels
+	auto AddTriangleVertices = [&]( SimplexIndex< Dim , RegularGrid< Dim >::Index > t , const std::vector< SimplexIndex< Dim > > *_hull=NULL , const unsigned int *_labels=NULL , unsigned int _labelCount=0 )
 		{
 			MultiIndex< Dim+1 > mi( Linearize( t[0] , cornerRange ) , Linearize( t[1] , cornerRange ) , Linearize( t[2] , cornerRange ) );
 			// Check if the triangle's vertices have already been computed
-			if( triangleVertexMap.find( mi )!=triangleVertexMap.end() ) return mi;
+			MapLookupCount.add();
+			if( triangleVertexMap.find( mi ) ) return mi;
 
 			// If they have not already been added, add them now
-			std::vector< std::pair< MultiIndex< Dim+1 > , unsigned int > > vertices;
+			TriangleVertexData< N > vertices;
 
 			// Fit functions to the corner values
+			const Point< double , N > w[] = { Weights( t[0] ) , Weights( t[1] ) , Weights( t[2] ) };
 			SimplexFunction< Dim > f[N];
-			for( unsigned int n=0 ; n<N ; n++ ) f[n] = SimplexFunction< Dim >( grid( t[0] )[n] , grid( t[1] )[n] , grid( t[2] )[n] );
+			for( unsigned int n=0 ; n<N ; n++ ) f[n] = SimplexFunction< Dim >( w[0][n] , w[1][n] , w[2][n] );
 
 			if( !NoConvexHull.set )
 			{
-				std::vector< Point< double , Dim+1 > > duals( N );
-				for( unsigned int n=0 ; n<N ; n++ ) duals[n] = f[n].dual();
-
-				std::vector< SimplexIndex< Dim > > hull = ConvexHull::ConvexHull( duals , false );
-				for( unsigned int i=0 ; i<hull.size() ; i++ )
-				{
-					SimplexIndex< Dim > si = hull[i];
-					Simplex< double , Dim+1 , Dim > s;
-					for( unsigned int d=0 ; d<=Dim ; d++ ) s[d] = duals[ si[d] ];
-					if( s.normal()[0]<0 )
+				// Adds the point of intersection of the three functions, if it is on the triangle
+				// [NOTE] The functions are intersected in the order of their labels, so the position does not depend on how the labels were found
+				auto AddVertex = [&]( MultiIndex< Dim+1 > mi , bool expectIntersection )
 					{
-						// Find the point of intersection of the three functions, dual to the corners of a hull triangle
-						Point< double , Dim > xy;
-						try{ xy = SimplexFunction< Dim >::Intersect( f[ si[0] ] , f[ si[1] ] , f[ si[2] ] ); }
-						catch( Misha::Exception ){ ERROR_OUT( "Expected intersection" ); }
+						bool success;
+						const SimplexFunction< Dim > _f[] = { f[ mi[0] ] , f[ mi[1] ] , f[ mi[2] ] };
+						Point< double , Dim > xy = SimplexFunction< Dim >::TryIntersect( _f , success );
+						if( !success )
+						{
+							if( expectIntersection ) THROW( "Expected intersection" );
+							return;
+						}
 
 						// Check that the position is on the triangle
 						if( xy[0]>=0 && xy[0]<=1 && xy[1]>=0 && xy[1]<=1 && (xy[0] + xy[1])<=1 )
@@ -236,30 +407,62 @@ void Process( void )
 							Point< double , 2 > p = Point< double , 2 >( t[0] ) * ( 1. - xy[0] - xy[1] ) + Point< double , 2 >( t[1] ) * xy[0] + Point< double , 2 >( t[2] ) * xy[1];
 
 							// Add to the triangle-to-vertex-index map, and add to the list of vertices
-							vertices.push_back( std::pair< MultiIndex< Dim+1 > , unsigned int >( MultiIndex< Dim+1 >( si[0] , si[1] , si[2] ) , (unsigned int)levelSetVertices.size() ) );
+							vertices.push_back( std::pair< MultiIndex< Dim+1 > , unsigned int >( mi , (unsigned int)levelSetVertices.size() ) );
 							levelSetVertices.push_back( p );
 						}
+					};
+
+				unsigned int activeLabels[N];
+				const unsigned int *labels = _labels ? _labels : activeLabels;
+				unsigned int labelCount = _hull ? 0 : ( _labels ? _labelCount : ActiveLabels( w , Dim+1 , activeLabels ) );
+				if( !_hull && labelCount<=Dim+1 )
+				{
+					if( labelCount==Dim+1 ) ThreeLabelTriangleCount.add() , AddVertex( MultiIndex< Dim+1 >( labels[0] , labels[1] , labels[2] ) , false );
+					else TwoLabelTriangleCount.add();
+				}
+				else
+				{
+					HullTriangleCount.add();
+					std::vector< Point< double , Dim+1 > > duals( N );
+					for( unsigned int n=0 ; n<N ; n++ ) duals[n] = f[n].dual();
+
+					std::vector< SimplexIndex< Dim > > hull;
+					if( _hull ) hull = *_hull;
+					else
+					{
+						std::vector< Point< double , Dim+1 > > activeDuals( labelCount );
+						for( unsigned int i=0 ; i<labelCount ; i++ ) activeDuals[i] = duals[ labels[i] ];
+						hull = ConvexHull::ConvexHull( activeDuals , workspace.triangleHullScratch , false );
+						for( unsigned int i=0 ; i<hull.size() ; i++ ) for( unsigned int d=0 ; d<=Dim ; d++ ) hull[i][d] = labels[ hull[i][d] ];
+					}
+					for( unsigned int i=0 ; i<hull.size() ; i++ )
+					{
+						SimplexIndex< Dim > si = hull[i];
+						Simplex< double , Dim+1 , Dim > s;
+						for( unsigned int d=0 ; d<=Dim ; d++ ) s[d] = duals[ si[d] ];
+						// The intersection of the three functions, dual to the corners of a hull triangle
+						if( s.normal()[0]<0 ) AddVertex( MultiIndex< Dim+1 >( si[0] , si[1] , si[2] ) , true );
 					}
 				}
 			}
 			else
 			{
+				const SimplexFunctionBatch< Dim , N > functions( f );
+
 				// For every triplet of functions, find the point where the functions are equal, check if that is the maximal value, and add the point if it is
 				for( unsigned int i=0 ; i<N ; i++ ) for( unsigned int j=0 ; j<i ; j++ ) for( unsigned int k=0 ; k<j ; k++ )
 				{
-					Point< double , 2 > xy;
-					bool foundIntersection = true;
-					try{ xy = SimplexFunction< 2 >::Intersect( f[i] , f[j] , f[k] ); }
-					catch( Misha::Exception ){ foundIntersection = false; }
+					bool foundIntersection;
+					const SimplexFunction< Dim > _f[] = { f[i] , f[j] , f[k] };
+					Point< double , Dim > xy = SimplexFunction< Dim >::TryIntersect( _f , foundIntersection );
 					if( !foundIntersection ) continue;
 
 					// Check that the position is on the triangle
 					if( xy[0]>=0 && xy[0]<=1 && xy[1]>=0 && xy[1]<=1 && (xy[0] + xy[1])<=1 )
 					{
 						// Check that the value is maximized by the triplet (i,j,k)
-						bool isMax = true;
-						for( unsigned int l=0 ; l<N ; l++ ) if( l!=i && l!=j && l!=k ) if( f[l](xy)>f[i](xy) ) isMax = false;
-						if( isMax )
+						const unsigned int indices[] = { i , j , k };
+						if( functions.isMaximal( xy , indices , 3 ) )
 						{
 							// Compute the world coordinates of the position
 							Point< double , 2 > p = Point< double , 2 >( t[0] ) * ( 1. - xy[0] - xy[1] ) + Point< double , 2 >( t[1] ) * xy[0] + Point< double , 2 >( t[2] ) * xy[1];
@@ -273,76 +476,94 @@ void Process( void )
 			}
 
 			triangleVertexMap[ mi ] = vertices;
+			MapInsertionCount.add();
 			return mi;
 		};
 
-	// Functionality for adding the level-set associated with a simplex
-	auto AddLevelSetGeometry = [&]( SimplexIndex< Dim , RegularGrid< Dim >::Index > s )
+	// Functionality for testing if a simplex can be culled because a single label dominates all others
+	// [NOTE] The test is performed on the samples, which is conservative for quantized grids
+	auto IsCulled = [&]( SimplexIndex< Dim , RegularGrid< Dim >::Index > s )
 		{
-			if( !NoCulling.set )
+			TriangleCount.add();
+			if( NoCulling.set ) return false;
+
+			bool hasDominatingLabel = false;
+			// Try if the i-th label dominates all other functions at all the corners
+			for( unsigned int i=0 ; i<N ; i++ )
 			{
-				bool hasDominatingLabel = false;
-				// Try if the i-th label dominates all other functions at all the corners
-				for( unsigned int i=0 ; i<N ; i++ )
-				{
-					bool isDominant = true;
-
-					// Try all other functions
-					for( unsigned int j=0 ; j<N ; j++ ) if( j!=i )
-						// At all other corners
-						for( unsigned int d=0 ; d<=Dim ; d++ )
-							// If the j-th function is larger at any corner, the i-th function cannot dominate
-							if( grid( s[d] )[j] > grid( s[d] )[i] ) isDominant = false;
-					if( isDominant ) hasDominatingLabel = true;
-				}
-				if( hasDominatingLabel ) return;
+				bool isDominant = true;
+
+				// Try all other functions
+				for( unsigned int j=0 ; j<N ; j++ ) if( j!=i )
+					// At all other corners
+					for( unsigned int d=0 ; d<=Dim ; d++ )
+						// If the j-th function is larger at any corner, the i-th function cannot dominate
+						if( grid( s[d] )[j] > grid( s[d] )[i] ) isDominant = false;
+				if( isDominant ) hasDominatingLabel = true;
 			}
+			if( hasDominatingLabel ) CulledTriangleCount.add();
+			return hasDominatingLabel;
+		};
 
-			//  Add multi-level-set vertices along the edged and in the interior of the triangle
-			TriangleVertexMap::iterator triangleVertices;
-			EdgeVertexMap::iterator edgeVertices[Dim+1];
+	// Functionality for adding the level-set associated with a simplex
+	// [NOTE] If the hull of the dual points or the labels reaching the upper envelope have already been computed, they can be passed in
+	// [NOTE] The culling test can be skipped if it has already been performed
+	auto AddLevelSetGeometry = [&]( SimplexIndex< Dim , RegularGrid< Dim >::Index > s , const std::vector< SimplexIndex< Dim > > *hull=NULL , bool cull=true , const unsigned int *labels=NULL , unsigned int labelCount=0 )
+		{
+			if( !hull && cull && IsCulled( s ) ) return;
 
-			triangleVertices = triangleVertexMap.find( AddTriangleVertices( s ) );
+			//  Add multi-level-set vertices along the edged and in the interior of the triangle
+			// [NOTE] The look-ups are performed after all the insertions, since inserting into a hash map can invalidate pointers to its data
+			MultiIndex< Dim+1 > triangleIndex = AddTriangleVertices( s , hull , labels , labelCount );
+			MultiIndex< Dim > edgeIndices[Dim+1];
 			for( unsigned int d=0 ; d<=Dim ; d++ )
 			{
 				SimplexIndex< Dim-1 , RegularGrid< Dim >::Index > e;
 				e[0] = s[(d+1)%(Dim+1)] , e[1] = s[(d+2)%(Dim+1)];
-				edgeVertices[d] = edgeVertexMap.find( AddEdgeVertices( e ) );
+				edgeIndices[d] = AddEdgeVertices( e );
 			}
 
-			for( unsigned int i=0 ; i<N ; i++ ) for( unsigned int j=0 ; j<i ; j++ )
-			{
-				SimplexIndex< Dim-1 > levelSetEdge;
-				levelSetEdge[0] = levelSetEdge[1] = -1;
+			const TriangleVertexData< N > *triangleVertices = triangleVertexMap.find( triangleIndex );
+			const EdgeVertexData< N > *edgeVertices[Dim+1];
+			for( unsigned int d=0 ; d<=Dim ; d++ ) edgeVertices[d] = edgeVertexMap.find( edgeIndices[d] );
+			MapLookupCount.add( Dim+2 );
+
+			// The (at most two) level-set vertices associated with each pair of labels, indexed by the rank of the pair
+			// [NOTE] Since the rank of the pair j<i is j + i*(i-1)/2, iterating over ranks visits the pairs with i in the outer loop and j in the inner one
+			static const unsigned int PairNum = MultiIndex< 2 , N >::Size( N );
+			SimplexIndex< Dim-1 > pairVertices[PairNum];
+			for( unsigned int p=0 ; p<PairNum ; p++ ) pairVertices[p][0] = pairVertices[p][1] = (unsigned int)-1;
 
-				// Look at the vertices generated inside the triangle
+			auto AddPairVertex = [&]( unsigned int i , unsigned int j , unsigned int v )
 				{
-					const std::vector< std::pair< MultiIndex< Dim+1 > , unsigned int > > &vertices = triangleVertices->second;
-					for( unsigned int v=0 ; v<vertices.size() ; v++ )
-						if( ( vertices[v].first[0]==i || vertices[v].first[1]==i || vertices[v].first[2]==i ) && ( vertices[v].first[0]==j || vertices[v].first[1]==j || vertices[v].first[2]==j ) )
-						{
-							if     ( levelSetEdge[0]==-1 ) levelSetEdge[0] = vertices[v].second;
-							else if( levelSetEdge[1]==-1 ) levelSetEdge[1] = vertices[v].second;
-							else ERROR_OUT( "Edge is full" );
-						}
-				}
+					SimplexIndex< Dim-1 > &levelSetEdge = pairVertices[ MultiIndex< 2 , N >( i , j )() ];
+					if     ( levelSetEdge[0]==(unsigned int)-1 ) levelSetEdge[0] = v;
+					else if( levelSetEdge[1]==(unsigned int)-1 ) levelSetEdge[1] = v;
+					else THROW( "Edge is full" );
+				};
+
+			// Add the vertices generated inside the triangle to the three pairs of labels defining them
+			for( unsigned int v=0 ; v<triangleVertices->size() ; v++ )
+			{
+				const MultiIndex< Dim+1 > &mi = (*triangleVertices)[v].first;
+				AddPairVertex( mi[0] , mi[1] , (*triangleVertices)[v].second );
+				AddPairVertex( mi[0] , mi[2] , (*triangleVertices)[v].second );
+				AddPairVertex( mi[1] , mi[2] , (*triangleVertices)[v].second );
+			}
 
-				// Look at the vertices generated inside the edges
-				for( unsigned int d=0 ; d<=Dim ; d++ )
+			// Add the vertices generated inside the edges to the pair of labels defining them
+			for( unsigned int d=0 ; d<=Dim ; d++ ) for( unsigned int v=0 ; v<edgeVertices[d]->size() ; v++ )
+				AddPairVertex( (*edgeVertices[d])[v].first[0] , (*edgeVertices[d])[v].first[1] , (*edgeVertices[d])[v].second );
+
+			size_t edgeCount = levelSetEdges.size();
+			for( unsigned int p=0 ; p<PairNum ; p++ )
+				if( pairVertices[p][1]!=(unsigned int)-1 )
 				{
-					const std::vector< std::pair< MultiIndex< Dim > , unsigned int > > &vertices = edgeVertices[d]->second;
-					for( unsigned int v=0 ; v<vertices.size() ; v++ )
-						if( ( vertices[v].first[0]==i || vertices[v].first[1]==i ) && ( vertices[v].first[0]==j || vertices[v].first[1]==j ) )
-						{
-							if     ( levelSetEdge[0]==-1 ) levelSetEdge[0] = vertices[v].second;
-							else if( levelSetEdge[1]==-1 ) levelSetEdge[1] = vertices[v].second;
-							else ERROR_OUT( "Edge is full" );
-						}
+					levelSetEdges.push_back( pairVertices[p] );
+					if( SimplifyTolerance.set ) levelSetEdgeLabels.push_back( p );
 				}
-
-				if     ( levelSetEdge[1]!=-1 ) levelSetEdges.push_back( levelSetEdge );
-				else if( levelSetEdge[0]!=-1 ) ERROR_OUT( "Could not complete edge" );
-			}
+				else if( pairVertices[p][0]!=(unsigned int)-1 ) THROW( "Could not complete edge" );
+			if( levelSetEdges.size()>edgeCount ) ActiveTriangleCount.add();
 		};
 
 	// Functionality for adding the level-set associated with a cell
@@ -350,7 +571,7 @@ void Process( void )
 	ProgressBar progressBar( 10 , cellRange.second[0] - cellRange.first[0] , progressText , false );
 	auto GetCellLevelSet = [&]( RegularGrid< Dim >::Index I )
 		{
-			if( Progress.set )
+			if( progress )
 			{
 				bool show = true;
 				for( unsigned int d=1 ; d<Dim ; d++ ) if( I[d] ) show = false;
@@ -361,58 +582,221 @@ void Process( void )
 				}
 			}
 
+			CellCount.add();
 			CellSimplices< Dim > cellSimplices( I );
 			AddLevelSetGeometry( cellSimplices[0] );
 			AddLevelSetGeometry( cellSimplices[1] );
 		};
-	if( Progress.set ) std::cout << std::endl;
+	if( progress ) std::cout << std::endl;
 	// Iterate over the cells and add the level sets
 	subTimer.reset();
-	cellRange.process( GetCellLevelSet );
+	{
+		Instrumentation::Scope scope( "extract" );
+#ifdef BATCH_SIMPLE_HULL
+		// The batched hull computation applies to the triangles whose dual hulls, after discarding the labels that cannot reach the upper envelope, are simple hulls of Dim+2 or Dim+3 points
+		if( !NoConvexHull.set && N>=Dim+2 )
+		{
+			static const unsigned int Lanes = 8;
+			ConvexHull::SimpleHullBatch< Dim+1 , Lanes > batch;
+
+			// The non-culled triangles of the row, and their hulls
+			std::vector< SimplexIndex< Dim , RegularGrid< Dim >::Index > > &rowTriangles = workspace.rowTriangles;
+			std::vector< std::vector< SimplexIndex< Dim > > > &rowHulls = workspace.rowHulls;
+			std::vector< unsigned int > &rowLabels = workspace.rowLabels , &rowLabelCounts = workspace.rowLabelCounts , &rowHullTriangles = workspace.rowHullTriangles;
+
+			// Process the cells one row (fixed first coordinate) at a time or, if a block size is given, one block at a time
+			std::vector< RegularGrid< Dim >::Range > rowRanges;
+			if( BlockSize.value ) rowRanges = BlockedGrid::Blocks< Dim >( cellRange , BlockSize.value );
+			else for( int i=cellRange.first[0] ; i<cellRange.second[0] ; i++ )
+			{
+				RegularGrid< Dim >::Range rowRange = cellRange;
+				rowRange.first[0] = i , rowRange.second[0] = i+1;
+				rowRanges.push_back( rowRange );
+			}
+			ProgressBar rowProgressBar( 10 , rowRanges.size() , progressText , false );
+			for( size_t r=0 ; r<rowRanges.size() ; r++ )
+			{
+				if( progress )
+				{
+					sprintf( progressText , "Processing cells" );
+					rowProgressBar.update();
+				}
 
-	// Transform vertices into world coordinates
-	for( unsigned int i=0 ; i<levelSetVertices.size() ; i++ ) levelSetVertices[i] = gridToWorld * levelSetVertices[i];
-	if( Verbose.set )
+				rowTriangles.resize( 0 );
+				BlockedGrid::ProcessRange< Dim >( rowRanges[r] , [&]( RegularGrid< Dim >::Index I )
+					{
+						CellCount.add();
+						CellSimplices< Dim > cellSimplices( I );
+						for( unsigned int s=0 ; s<CellSimplices< Dim >::Num ; s++ ) if( !IsCulled( cellSimplices[s] ) ) rowTriangles.push_back( cellSimplices[s] );
+					} );
+				if( rowHulls.size()<rowTriangles.size() ) rowHulls.resize( rowTriangles.size() );
+
+				// Gather the labels of every triangle once, so that AddTriangleVertices does not gather them again
+				// Only the triangles with four or five labels reaching the upper envelope get batched hulls
+				// [NOTE] Those with fewer labels do not need hulls, and those with more compute them in AddTriangleVertices
+				rowLabels.resize( rowTriangles.size()*N ) , rowLabelCounts.resize( rowTriangles.size() ) , rowHullTriangles.resize( 0 );
+				for( unsigned int t=0 ; t<rowTriangles.size() ; t++ )
+				{
+					rowLabelCounts[t] = TriangleLabels( rowTriangles[t] , &rowLabels[ t*N ] );
+					if( rowLabelCounts[t]>=Dim+2 && rowLabelCounts[t]<=Dim+3 ) rowHullTriangles.push_back( t );
+				}
+
+				// Compute the hulls, Lanes triangles with the same number of labels at a time, and map the hull indices back to the labels
+				for( unsigned int count=Dim+2 ; count<=Dim+3 && count<=N ; count++ )
+				{
+					unsigned int lanes[Lanes] , laneNum = 0;
+					auto Flush = [&]( void )
+						{
+							batch.process( count );
+							for( unsigned int l=0 ; l<laneNum ; l++ )
+							{
+								const unsigned int *labels = &rowLabels[ lanes[l]*N ];
+								std::vector< SimplexIndex< Dim > > &hull = rowHulls[ lanes[l] ];
+								batch.hull( l , count , hull );
+								for( unsigned int i=0 ; i<hull.size() ; i++ ) for( unsigned int d=0 ; d<=Dim ; d++ ) hull[i][d] = labels[ hull[i][d] ];
+							}
+							laneNum = 0;
+						};
+					for( unsigned int h=0 ; h<rowHullTriangles.size() ; h++ ) if( rowLabelCounts[ rowHullTriangles[h] ]==count )
+					{
+						unsigned int t = rowHullTriangles[h];
+						Point< double , Dim+1 > duals[N] , activeDuals[N];
+						SetTriangleDuals( rowTriangles[t] , duals );
+						for( unsigned int i=0 ; i<count ; i++ ) activeDuals[i] = duals[ rowLabels[ t*N+i ] ];
+						batch.set( laneNum , activeDuals , count );
+						lanes[ laneNum++ ] = t;
+						if( laneNum==Lanes ) Flush();
+					}
+					if( laneNum ) Flush();
+				}
+
+				// [NOTE] The triangles have already been tested for culling
+				for( unsigned int t=0 , h=0 ; t<rowTriangles.size() ; t++ )
+					if( h<rowHullTriangles.size() && rowHullTriangles[h]==t ) AddLevelSetGeometry( rowTriangles[t] , &rowHulls[t] , false , &rowLabels[ t*N ] , rowLabelCounts[t] ) , h++;
+					else AddLevelSetGeometry( rowTriangles[t] , NULL , false , &rowLabels[ t*N ] , rowLabelCounts[t] );
+			}
+		}
+		else
+#endif // BATCH_SIMPLE_HULL
+		if( BlockSize.value ) BlockedGrid::Process< Dim >( cellRange , BlockSize.value , GetCellLevelSet );
+		else cellRange.process( GetCellLevelSet );
+	}
+
+	if( verbose )
 	{
 		std::cout << "Got level-set: " << subTimer() << std::endl;
 		std::cout << "Vertices/edges: " << levelSetVertices.size() << " / " << levelSetEdges.size() << std::endl;
 	}
 
-	if( Out.set )
+	// Simplify the level-set before it is transformed, smoothed, or written, measuring distances in grid (or world) units
+	if( SimplifyTolerance.set )
 	{
-		Factory vertexFactory;
-		PLY::WriteSimplices( Out.value , vertexFactory , levelSetVertices , levelSetEdges , ASCII.set ? PLY_ASCII : PLY_BINARY_NATIVE );
+		subTimer.reset();
+		std::vector< bool > retained;
+		if( SimplifyWorld.set )
+		{
+			std::vector< Point< double , Dim > > positions( levelSetVertices.size() );
+			for( unsigned int i=0 ; i<levelSetVertices.size() ; i++ ) positions[i] = gridToWorld * levelSetVertices[i];
+			retained = CurveSimplifier::Simplify( positions , levelSetEdges , SimplifyTolerance.value , &levelSetEdgeLabels );
+		}
+		else retained = CurveSimplifier::Simplify( levelSetVertices , levelSetEdges , SimplifyTolerance.value , &levelSetEdgeLabels );
+		CurveSimplifier::Compact( levelSetVertices , levelSetEdges , retained );
+		if( verbose )
+		{
+			std::cout << "Simplified level-set: " << subTimer() << std::endl;
+			std::cout << "Vertices/edges: " << levelSetVertices.size() << " / " << levelSetEdges.size() << std::endl;
+		}
 	}
 
-	if( Performance.set ) std::cout << "Performance: " << timer() << ", " << Miscellany::MemoryInfo::PeakMemoryUsageMB() << " (MB)" << std::endl;
+	// Transform vertices into world coordinates
+	for( unsigned int i=0 ; i<levelSetVertices.size() ; i++ ) levelSetVertices[i] = gridToWorld * levelSetVertices[i];
+
+	// Smooth the level-set and/or convert it to a tube, and write out the result
+	CurveOutput::Process( CurveParameters , levelSetVertices , levelSetEdges , workspace.tubeVertices , workspace.tubeTriangles , job.out , ASCII.set , verbose );
+}
+
+// Extracts the multi-level-set using the thread's workspace for the grid's type, and sets the size of the output in the report
+template< unsigned int N >
+void Process( std::string dataName , const Batch::Job &job , Batch::Workspaces &workspaces , Batch::Report &report , bool verbose , bool progress )
+{
+	auto _Process = [&]< typename Real >( void )
+		{
+			Workspace< N , Real > &workspace = workspaces.get< Workspace< N , Real > >();
+			Process( job , workspace , verbose , progress );
+			if( CurveParameters.tubularRadius.set ) report.vertices = workspace.tubeVertices.size() , report.simplices = workspace.tubeTriangles.size();
+			else                                    report.vertices = workspace.levelSetVertices.size() , report.simplices = workspace.levelSetEdges.size();
+		};
+
+	if     ( dataName==QuantizedGrid::Type< unsigned char  >::Name ) _Process.template operator()< unsigned char  >();
+	else if( dataName==QuantizedGrid::Type< unsigned short >::Name ) _Process.template operator()< unsigned short >();
+	else _Process.template operator()< double >();
+}
+
+// Reads the header of the job's grid and dispatches on the number of labels and the sample type
+void Process( const Batch::Job &job , Batch::Workspaces &workspaces , Batch::Report &report , bool verbose , bool progress )
+{
+	unsigned int dataDim;
+	std::string dataName;
+	GridReader< Dim >::ReadHeader( job.in , dataDim , dataName );
+
+	switch( dataDim )
+	{
+	case  2: Process<  2 >( dataName , job , workspaces , report , verbose , progress ) ; break;
+	case  3: Process<  3 >( dataName , job , workspaces , report , verbose , progress ) ; break;
+	case  4: Process<  4 >( dataName , job , workspaces , report , verbose , progress ) ; break;
+	case  5: Process<  5 >( dataName , job , workspaces , report , verbose , progress ) ; break;
+	case  6: Process<  6 >( dataName , job , workspaces , report , verbose , progress ) ; break;
+	case  7: Process<  7 >( dataName , job , workspaces , report , verbose , progress ) ; break;
+	case  8: Process<  8 >( dataName , job , workspaces , report , verbose , progress ) ; break;
+	case  9: Process<  9 >( dataName , job , workspaces , report , verbose , progress ) ; break;
+	case 10: Process< 10 >( dataName , job , workspaces , report , verbose , progress ) ; break;
+	default: THROW( "Only grid values of dimension 2..10 supported: " , dataDim );
+	}
 }
 
 int main( int argc , char* argv[] )
 {
 	Misha::CmdLineParse( argc-1 , argv+1 , params );
-	if( !In.set )
+	if( !In.set && !Manifest.set )
 	{
 		ShowUsage( argv[0] );
 		return EXIT_SUCCESS;
 	}
+	CurveParameters.validate();
+	if( Stats.set || Trace.set ) Instrumentation::Enable();
 
-	unsigned int dataDim;
-	std::string dataName;
-	RegularGrid< Dim >::ReadHeader( In.value , dataDim , dataName );
+	Miscellany::Timer timer;
 
-	switch( dataDim )
+	// In batch mode, each job reads its own header, so the grids in the manifest can have different types and numbers of labels
+	if( Manifest.set )
+	{
+		std::vector< Batch::Job > jobs = Batch::ReadManifest( Manifest.value );
+		if( !jobs.size() ) ERROR_OUT( "No jobs in manifest: " , Manifest.value );
+		for( unsigned int j=0 ; j<jobs.size() ; j++ ) if( jobs[j].hasIsoValue )
+		{
+			WARN( "Iso-values are ignored for multi-level-sets" );
+			break;
+		}
+
+		std::vector< Batch::Workspaces > workspaces( omp_get_max_threads() );
+		std::vector< Batch::Report > reports = Batch::Process( jobs , [&]( const Batch::Job &job , unsigned int thread , Batch::Report &report ){ Process( job , workspaces[thread] , report , false , false ); } );
+		Batch::Summarize( jobs , reports , Verbose.set );
+		if( BatchReport.set ) Batch::WriteReport( BatchReport.value , jobs , reports );
+	}
+	else
 	{
-	case  2: Process<  2 >() ; break;
-	case  3: Process<  3 >() ; break;
-	case  4: Process<  4 >() ; break;
-	case  5: Process<  5 >() ; break;
-	case  6: Process<  6 >() ; break;
-	case  7: Process<  7 >() ; break;
-	case  8: Process<  8 >() ; break;
-	case  9: Process<  9 >() ; break;
-	case 10: Process< 10 >() ; break;
-	default: ERROR_OUT( "Only grid values of dimension 2..10 supported: " , dataDim );
+		Batch::Job job;
+		job.in = In.value;
+		if( Out.set ) job.out = Out.value;
+		Batch::Workspaces workspaces;
+		Batch::Report report;
+		try{ Process( job , workspaces , report , Verbose.set , Progress.set ); }
+		catch( const std::exception &e ){ ERROR_OUT( e.what() ); }
 	}
 
+	if( Performance.set ) std::cout << "Performance: " << timer() << ", " << Miscellany::MemoryInfo::PeakMemoryUsageMB() << " (MB)" << std::endl;
+	if( Stats.set ) Instrumentation::WriteStats( Stats.value , "MultiMarchingTriangles" );
+	if( Trace.set ) Instrumentation::WriteTrace( Trace.value , "MultiMarchingTriangles" );
+
 	return EXIT_SUCCESS;
 }
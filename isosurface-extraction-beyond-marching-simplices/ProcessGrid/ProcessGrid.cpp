@@ -8,10 +8,15 @@
 #include "Misha/Ply.h"
 #include "Misha/PlyVertexData.h"
 #include "Include/GridReader.h"
+#include "Include/TiledGrid.h"
+#include "Include/GridOperators.h"
+#include "Include/GridPyramid.h"
+#include "Include/Instrumentation.h"
 
-Misha::CmdLineParameter< std::string > In( "in" ) , Out( "out" );
-Misha::CmdLineParameter< unsigned int > SmoothingIterations( "iters" , 0 ) , Extract( "extract" , -1 );
-Misha::CmdLineReadable Normalize( "normalize" ) , Discretize( "discretize" );
+Misha::CmdLineParameter< std::string > In( "in" ) , Out( "out" ) , SignedDistance( "sdf" ) , Stats( "stats" ) , Trace( "trace" );
+Misha::CmdLineParameter< unsigned int > SmoothingIterations( "iters" , 0 ) , Extract( "extract" , -1 ) , TileSize( "tile" , TiledGrid::DefaultTileSize ) , BlockSize( "block" , 0 ) , Quantize( "quantize" , 0 ) , Seed( "seed" , 0 );
+Misha::CmdLineParameters< std::string > Pipeline( "pipeline" );
+Misha::CmdLineReadable Normalize( "normalize" ) , Discretize( "discretize" ) , Fuse( "fuse" ) , Pyramid( "pyramid" );
 
 Misha::CmdLineReadable* params[] =
 {
@@ -19,8 +24,18 @@ Misha::CmdLineReadable* params[] =
 	&Out ,
 	&SmoothingIterations ,
 	&Extract ,
+	&TileSize ,
+	&BlockSize ,
+	&Quantize ,
+	&Seed ,
 	&Normalize ,
 	&Discretize ,
+	&Fuse ,
+	&Pyramid ,
+	&Pipeline ,
+	&SignedDistance ,
+	&Stats ,
+	&Trace ,
 	NULL
 };
 
@@ -31,87 +46,336 @@ void ShowUsage( const char* ex )
 	std::cout << "\t[--" << Out.name << " <output curve>]" << std::endl;
 	std::cout << "\t[--" << SmoothingIterations.name << " <smoothing iterations>=" << SmoothingIterations.value << "]" << std::endl;
 	std::cout << "\t[--" << Extract.name << " <extraction coordinate>]" << std::endl;
+	std::cout << "\t[--" << TileSize.name << " <output tile size>=" << TileSize.value << "]" << std::endl;
+	std::cout << "\t[--" << BlockSize.name << " <smoothing block size (power of two)>]" << std::endl;
+	std::cout << "\t[--" << Quantize.name << " <output bits per value (8 or 16)>]" << std::endl;
+	std::cout << "\t[--" << Seed.name << " <random seed>]" << std::endl;
 	std::cout << "\t[--" << Normalize.name << "]" << std::endl;
 	std::cout << "\t[--" << Discretize.name << "]" << std::endl;
+	std::cout << "\t[--" << Fuse.name << "]" << std::endl;
+	std::cout << "\t[--" << Pyramid.name << "]" << std::endl;
+	std::cout << "\t[--" << SignedDistance.name << " <threshold | label:<label> | labels>]" << std::endl;
+	std::cout << "\t[--" << Pipeline.name << " <operator count> <operators: normalize, jitter:<magnitude>, smooth:<iterations>, sdf[:<threshold> | :label:<label> | :labels], extract:<coordinate>, discretize, write:<output grid>>]" << std::endl;
+	std::cout << "\t[--" << Stats.name << " <output statistics (JSON)>]" << std::endl;
+	std::cout << "\t[--" << Trace.name << " <output trace (Chrome trace-event JSON)>]" << std::endl;
 }
 
-template< unsigned int Dim , unsigned int N >
-RegularGrid< Dim , Point< double , N > > Smooth( const RegularGrid< Dim , Point< double , N > > &in )
+// An operator in the processing pipeline
+struct Operator
 {
-	RegularGrid< Dim , Point< double , N > > out;
-	out.resize( in.res() );
-	typename RegularGrid< Dim >::Range range , nRange;
-	for( unsigned int d=0 ; d<Dim ; d++ ) range.first[d] = 0 , range.second[d] = in.res( d );
+	enum Type
+	{
+		NORMALIZE ,
+		JITTER ,
+		SMOOTH ,
+		SDF ,
+		EXTRACT ,
+		DISCRETIZE ,
+		WRITE ,
+		COUNT
+	};
+	static const std::string Names[];
+
+	Type type;
+	double magnitude;		// The jitter magnitude
+	unsigned int index;		// The number of smoothing iterations or the extraction coordinate
+	std::string fileName;	// The output file
+	double threshold;		// The value above which a sample is inside, for the signed distance of a thresholded grid
+	int label;				// The label whose signed distance is computed (or -1 if the grid is thresholded)
+	bool labels;			// Whether the signed distance of each label is computed
 
-	const double Weights[] = { 0.25 , 0.5 , 0.25 };
-	auto SetWeightedAverage = [&]( typename RegularGrid< Dim >::Index outI )
+	Operator( Type t=COUNT ) : type(t) , magnitude(0) , index(0) , threshold(0) , label(-1) , labels(false) {}
+
+	// Returns true if the operator can be applied to each value independently
+	bool perValue( void ) const { return type==NORMALIZE || type==JITTER; }
+
+	// Parses an operator of the form <name>[:<argument>]
+	static Operator Parse( std::string str )
+	{
+		std::string name = str , arg;
+		size_t pos = str.find( ':' );
+		if( pos!=std::string::npos ) name = str.substr( 0 , pos ) , arg = str.substr( pos+1 );
+
+		Operator op;
+		for( unsigned int t=0 ; t<COUNT ; t++ ) if( name==Names[t] ) op.type = (Type)t;
+		switch( op.type )
 		{
-			Point< double , N > sum = {};
-			double wSum = 0;
-			auto SumNeighborValues = [&]( typename RegularGrid< Dim >::Index inI )
-				{
-					double w = 1;
-					for( unsigned int d=0 ; d<Dim ; d++ ) w *= Weights[ 1 + outI[d] - inI[d] ];
-					sum += in( inI ) * w;
-					wSum += w;
-				};
-			RegularGrid< Dim >::Range::Intersect( ( typename RegularGrid< Dim >::Range( outI ) ).dilate(1) , range ).process( SumNeighborValues );
-			out( outI ) = sum / wSum;
-		};
-	range.process( SetWeightedAverage );
-	return out;
+			case NORMALIZE: case DISCRETIZE: break;
+			case SDF:
+				if     ( arg=="labels" ) op.labels = true;
+				else if( arg.substr( 0 , 6 )=="label:" ) op.label = std::stoi( arg.substr( 6 ) );
+				else if( arg.size() ) op.threshold = std::stod( arg );
+				break;
+			case JITTER:  if( !arg.size() ) ERROR_OUT( "Expected jitter magnitude: " , str ) ; op.magnitude = std::stod( arg ) ; break;
+			case SMOOTH:  if( !arg.size() ) ERROR_OUT( "Expected smoothing iterations: " , str ) ; op.index = std::stoi( arg ) ; break;
+			case EXTRACT: if( !arg.size() ) ERROR_OUT( "Expected extraction coordinate: " , str ) ; op.index = std::stoi( arg ) ; break;
+			case WRITE:   if( !arg.size() ) ERROR_OUT( "Expected output file: " , str ) ; op.fileName = arg ; break;
+			default: ERROR_OUT( "Unrecognized operator: " , str );
+		}
+		return op;
+	}
+};
+const std::string Operator::Names[] = { "normalize" , "jitter" , "smooth" , "sdf" , "extract" , "discretize" , "write" };
+
+// Writes the grid, as a pyramid if requested for scalar grids, quantized if a bit count is given for real-valued grids, and tiled if a tile size is given
+template< unsigned int Dim , typename Data , typename Real >
+void WriteGrid( std::string fileName , const RegularGrid< Dim , Data > &grid , const XForm< Real , Dim+1 > &xForm )
+{
+	using Traits = TiledGrid::_DataTraits< Data >;
+	if constexpr( std::is_same_v< typename Traits::Real , double > && Traits::Channels==1 ) if( Pyramid.set )
+	{
+		if( Quantize.value || TileSize.set ) WARN( "Pyramids are neither quantized nor tiled" );
+		RegularGrid< Dim , double > _grid;
+		_grid.resize( grid.res() );
+		for( size_t i=0 ; i<grid.resolution() ; i++ ) _grid[i] = Traits::Channel( grid[i] , 0 );
+		GridPyramid::Pyramid< Dim >( _grid ).write( fileName , xForm );
+		return;
+	}
+	if constexpr( std::is_same_v< typename Traits::Real , double > ) if( Quantize.value )
+	{
+		auto QuantizeAndWrite = [&]< typename Quantized >( void )
+			{
+				using QuantizedData = std::conditional_t< Traits::Channels==1 , Quantized , Point< Quantized , Traits::Channels > >;
+				RegularGrid< Dim , QuantizedData > _grid;
+				double scale , offset;
+				QuantizedGrid::Quantize( grid , _grid , scale , offset );
+				QuantizedGrid::Write( fileName , _grid , xForm , scale , offset );
+			};
+		if( TileSize.set ) WARN( "Quantized grids are not tiled" );
+		if     ( Quantize.value== 8 ) QuantizeAndWrite.template operator()< unsigned char  >();
+		else if( Quantize.value==16 ) QuantizeAndWrite.template operator()< unsigned short >();
+		else ERROR_OUT( "Only 8 and 16 bit quantization supported: " , Quantize.value );
+		return;
+	}
+	if constexpr( !std::is_same_v< typename Traits::Real , double > ) if( Quantize.value ) WARN( "Only real-valued grids are quantized" );
+	if( TileSize.set ) TiledGrid::Write( fileName , grid , xForm , TileSize.value );
+	else grid.write( fileName , xForm );
 }
 
+// Applies the operators, starting at the prescribed one, to the in-memory grid
+// [NOTE] Consecutive per-value operators, together with a subsequent extraction or discretization, are applied in a single pass over the grid
 template< unsigned int Dim , unsigned int N >
-void Execute( void )
+void Run( RegularGrid< Dim , Point< double , N > > &grid , const XForm< double , Dim+1 > &xForm , const std::vector< Operator > &ops , size_t o , unsigned int seed );
+
+// Computes the signed distances to the regions of the L labels and applies the remaining operators to the resulting grid
+template< unsigned int Dim , unsigned int L , typename LabelFunctor /* = std::function< unsigned int ( size_t ) > */ >
+void RunSignedDistances( const unsigned int res[Dim] , LabelFunctor label , const XForm< double , Dim+1 > &xForm , const std::vector< Operator > &ops , size_t o , unsigned int seed )
 {
-	XForm< double , Dim+1 > xForm;
-	RegularGrid< Dim , Point< double , N > > grid = GridReader< Dim , N >::Read( In.value , xForm );
-	if( Normalize.set )
+	double spacing[Dim];
+	GridOperators::Spacing< Dim >( xForm , spacing );
+	RegularGrid< Dim , Point< double , L > > grid;
+	grid.resize( res );
+	for( unsigned int l=0 ; l<L ; l++ )
 	{
-		if( N==1 ) WARN( "Normalizing one-dimensional data" );
-		for( unsigned int i=0 ; i<grid.resolution() ; i++ )
-		{
-			double sum = 0;
-			for( unsigned int n=0 ; n<N ; n++ ) sum += grid[i][n];
-			for( unsigned int n=0 ; n<N ; n++ ) grid[i][n] /= sum;
-		}
+		Instrumentation::Scope scope( "sdf" );
+		RegularGrid< Dim , double > sd = GridOperators::SignedDistance< Dim >( res , [&]( size_t i ){ return label(i)==l; } , spacing );
+#pragma omp parallel for
+		for( long long i=0 ; i<(long long)grid.resolution() ; i++ ) grid[i][l] = sd[i];
 	}
-	for( unsigned int i=0 ; i<SmoothingIterations.value ; i++ ) grid = Smooth( grid );
-	if( Out.set )
+	Run( grid , xForm , ops , o , seed );
+}
+
+template< unsigned int Dim , unsigned int N >
+void Run( RegularGrid< Dim , Point< double , N > > &grid , const XForm< double , Dim+1 > &xForm , const std::vector< Operator > &ops , size_t o , unsigned int seed )
+{
+	while( o<ops.size() )
 	{
-		if( Extract.set )
+		if( ops[o].type==Operator::WRITE )
 		{
-			if( Extract.value>N ) ERROR_OUT( "Extraction coordinate out of bounds: 0 <= " , Extract.value , " < " , N );
-			RegularGrid< Dim , double > _grid;
-			_grid.resize( grid.res() );
-			for( unsigned int i=0 ; i<grid.resolution() ; i++ ) _grid[i] = grid[i][ Extract.value ];
-			_grid.write( Out.value , xForm );
+			Instrumentation::Scope scope( "write" );
+			WriteGrid( ops[o].fileName , grid , xForm );
+			o++;
+		}
+		else if( ops[o].type==Operator::SMOOTH )
+		{
+			// Since the weights and the renormalization are separable, each iteration can be performed as a sequence of 1D passes
+			// If the iterations are fused, a single binomial kernel of radius equal to the number of iterations is used instead
+			// [NOTE] Away from the boundary the two are equivalent
+			// If a block size is given, the grid is stored block by block while smoothing, so that the passes along the slower dimensions stay in cache
+			if( ops[o].index )
+			{
+				Instrumentation::Scope scope( "smooth" );
+				std::vector< double > kernel = GridOperators::BinomialKernel( Fuse.set ? ops[o].index : 1 );
+				unsigned int iterations = Fuse.set ? 1 : ops[o].index;
+				if( BlockSize.value ) GridOperators::Smooth( grid , kernel , iterations , BlockSize.value );
+				else                  GridOperators::Smooth( grid , kernel , iterations );
+			}
+			o++;
+		}
+		else if( ops[o].type==Operator::SDF )
+		{
+			unsigned int res[Dim];
+			for( unsigned int d=0 ; d<Dim ; d++ ) res[d] = grid.res(d);
+
+			// The label of a sample is the index of the largest coordinate of a multi-dimensional value or the (rounded) value of a one-dimensional one
+			auto Label = [&]( size_t i )
+				{
+					if constexpr( N==1 ) return (unsigned int)std::max< long long >( 0 , std::llround( grid[i][0] ) );
+					else return GridOperators::Discretize( grid[i] );
+				};
+
+			if( ops[o].labels )
+			{
+				if constexpr( N>1 ) return RunSignedDistances< Dim , N >( res , Label , xForm , ops , o+1 , seed );
+				else
+				{
+					unsigned int labelNum = 0;
+					for( size_t i=0 ; i<grid.resolution() ; i++ ) labelNum = std::max< unsigned int >( labelNum , Label(i)+1 );
+					switch( labelNum )
+					{
+						case  1: return RunSignedDistances< Dim ,  1 >( res , Label , xForm , ops , o+1 , seed );
+						case  2: return RunSignedDistances< Dim ,  2 >( res , Label , xForm , ops , o+1 , seed );
+						case  3: return RunSignedDistances< Dim ,  3 >( res , Label , xForm , ops , o+1 , seed );
+						case  4: return RunSignedDistances< Dim ,  4 >( res , Label , xForm , ops , o+1 , seed );
+						case  5: return RunSignedDistances< Dim ,  5 >( res , Label , xForm , ops , o+1 , seed );
+						case  6: return RunSignedDistances< Dim ,  6 >( res , Label , xForm , ops , o+1 , seed );
+						case  7: return RunSignedDistances< Dim ,  7 >( res , Label , xForm , ops , o+1 , seed );
+						case  8: return RunSignedDistances< Dim ,  8 >( res , Label , xForm , ops , o+1 , seed );
+						case  9: return RunSignedDistances< Dim ,  9 >( res , Label , xForm , ops , o+1 , seed );
+						case 10: return RunSignedDistances< Dim , 10 >( res , Label , xForm , ops , o+1 , seed );
+						default: ERROR_OUT( "Only label counts 1..10 are supported: " , labelNum );
+					}
+				}
+			}
+			else
+			{
+				double spacing[Dim];
+				GridOperators::Spacing< Dim >( xForm , spacing );
+				RegularGrid< Dim , double > sd;
+				RegularGrid< Dim , Point< double , 1 > > _grid;
+				{
+					Instrumentation::Scope scope( "sdf" );
+					if( ops[o].label>=0 ) sd = GridOperators::SignedDistance< Dim >( res , [&]( size_t i ){ return Label(i)==(unsigned int)ops[o].label; } , spacing );
+					else if( N==1 ) sd = GridOperators::SignedDistance< Dim >( res , [&]( size_t i ){ return grid[i][0]>ops[o].threshold; } , spacing );
+					else ERROR_OUT( "Thresholding requires one-dimensional values: " , N );
+
+					_grid.resize( res );
+#pragma omp parallel for
+					for( long long i=0 ; i<(long long)_grid.resolution() ; i++ ) _grid[i][0] = sd[i];
+				}
+				grid = RegularGrid< Dim , Point< double , N > >();
+				return Run( _grid , xForm , ops , o+1 , seed );
+			}
 		}
-		else if( Discretize.set )
+		else
 		{
-			RegularGrid< Dim , unsigned int > _grid;
-			_grid.resize( grid.res() );
-			for( unsigned int i=0 ; i<grid.resolution() ; i++ )
+			// The run of per-value operators and the (optional) operator reducing the values that terminates it
+			size_t end = o;
+			while( end<ops.size() && ops[end].perValue() )
+			{
+				if( ops[end].type==Operator::NORMALIZE && N==1 ) WARN( "Normalizing one-dimensional data" );
+				end++;
+			}
+			const Operator *reduce = end<ops.size() && ( ops[end].type==Operator::EXTRACT || ops[end].type==Operator::DISCRETIZE ) ? &ops[end] : NULL;
+			if( reduce && reduce->type==Operator::EXTRACT && reduce->index>=N ) ERROR_OUT( "Extraction coordinate out of bounds: 0 <= " , reduce->index , " < " , N );
+
+			// [NOTE] Each jitter operator draws from its own stream, keyed on its position in the pipeline
+			auto Apply = [&]( Point< double , N > v , size_t i )
+				{
+					for( size_t _o=o ; _o<end ; _o++ )
+						if( ops[_o].type==Operator::NORMALIZE ) GridOperators::Normalize( v );
+						else GridOperators::Jitter( v , ops[_o].magnitude , Philox::MakeKey( seed , (unsigned int)_o ) , i );
+					return v;
+				};
+
+			if( !reduce )
+			{
+				Instrumentation::Scope scope( "apply" );
+#pragma omp parallel for
+				for( long long i=0 ; i<(long long)grid.resolution() ; i++ ) grid[i] = Apply( grid[i] , i );
+				o = end;
+			}
+			else if( reduce->type==Operator::EXTRACT )
+			{
+				RegularGrid< Dim , Point< double , 1 > > _grid;
+				{
+					Instrumentation::Scope scope( "apply" );
+					_grid.resize( grid.res() );
+#pragma omp parallel for
+					for( long long i=0 ; i<(long long)grid.resolution() ; i++ ) _grid[i][0] = Apply( grid[i] , i )[ reduce->index ];
+				}
+				grid = RegularGrid< Dim , Point< double , N > >();
+				return Run( _grid , xForm , ops , end+1 , seed );
+			}
+			else
 			{
-				unsigned int n=0;
-				for( unsigned int _n=0 ; _n<N ; _n++ ) if( grid[i][_n]>grid[i][n] ) n = _n;
-				_grid[i] = n;
+				RegularGrid< Dim , unsigned int > _grid;
+				{
+					Instrumentation::Scope scope( "apply" );
+					_grid.resize( grid.res() );
+#pragma omp parallel for
+					for( long long i=0 ; i<(long long)grid.resolution() ; i++ ) _grid[i] = GridOperators::Discretize( Apply( grid[i] , i ) );
+				}
+
+				XForm< unsigned int , Dim+1 > _xForm;
+				for( unsigned int i=0 ; i<=Dim ; i++ ) for( unsigned int j=0 ; j<=Dim ; j++ ) _xForm(i,j) = (unsigned int)xForm(i,j);
+				for( o=end+1 ; o<ops.size() ; o++ )
+					if( ops[o].type==Operator::WRITE )
+					{
+						Instrumentation::Scope scope( "write" );
+						WriteGrid( ops[o].fileName , _grid , _xForm );
+					}
+					else ERROR_OUT( "Only writing is supported after discretization: " , Operator::Names[ ops[o].type ] );
+				return;
 			}
-			XForm< unsigned int , Dim+1 > _xForm;
-			for( unsigned int i=0 ; i<=Dim ; i++ ) for( unsigned int j=0 ; j<=Dim ; j++ ) _xForm(i,j) = (unsigned int)xForm(i,j);
-			_grid.write( Out.value , _xForm );
 		}
-		else grid.write( Out.value , xForm );
 	}
 }
 
+// Returns the operators, either as prescribed by the pipeline or as implied by the individual flags
+std::vector< Operator > Operators( void )
+{
+	std::vector< Operator > ops;
+	if( Pipeline.set ) for( unsigned int i=0 ; i<Pipeline.count ; i++ ) ops.push_back( Operator::Parse( Pipeline.values[i] ) );
+	else
+	{
+		if( Normalize.set ) ops.push_back( Operator( Operator::NORMALIZE ) );
+		if( SmoothingIterations.value )
+		{
+			ops.push_back( Operator( Operator::SMOOTH ) );
+			ops.back().index = SmoothingIterations.value;
+		}
+		if( SignedDistance.set ) ops.push_back( Operator::Parse( Operator::Names[ Operator::SDF ] + ":" + SignedDistance.value ) );
+		if( Extract.set )
+		{
+			ops.push_back( Operator( Operator::EXTRACT ) );
+			ops.back().index = Extract.value;
+		}
+		else if( Discretize.set ) ops.push_back( Operator( Operator::DISCRETIZE ) );
+	}
+	if( Out.set )
+	{
+		ops.push_back( Operator( Operator::WRITE ) );
+		ops.back().fileName = Out.value;
+	}
+	return ops;
+}
+
+template< unsigned int Dim , unsigned int N >
+void Execute( void )
+{
+	XForm< double , Dim+1 > xForm;
+	RegularGrid< Dim , Point< double , N > > grid;
+	{
+		Instrumentation::Scope scope( "read" );
+		grid = GridReader< Dim , N >::Read( In.value , xForm );
+	}
+
+	unsigned int seed = Seed.value;
+	if( !Seed.set )
+	{
+		std::random_device rand_dev;
+		seed = rand_dev();
+	}
+	Run( grid , xForm , Operators() , 0 , seed );
+}
+
 template< unsigned int Dim >
 void Execute( void )
 {
 	unsigned int dataDim;
 	std::string dataName;
-	RegularGrid< Dim >::ReadHeader( In.value , dataDim , dataName );
+	GridReader< Dim >::ReadHeader( In.value , dataDim , dataName );
 	switch( dataDim )
 	{
 	case  1: Execute< Dim ,  1 >() ; break;
@@ -136,15 +400,22 @@ int main( int argc , char *argv[] )
 		ShowUsage( argv[0] );
 		return EXIT_SUCCESS;
 	}
+	if( Stats.set || Trace.set ) Instrumentation::Enable();
 
-	unsigned int dim;
-	RegularGrid< 0 >::ReadDimension( In.value , dim );
-	switch( dim )
+	try
 	{
-		case 1: Execute< 1 >() ; break;
-		case 2: Execute< 2 >() ; break;
-		case 3: Execute< 3 >() ; break;
-		default: ERROR_OUT( "Only dimensions 1, 2, and 3 supported: " , dim );
+		unsigned int dim;
+		ReadGridDimension( In.value , dim );
+		switch( dim )
+		{
+			case 1: Execute< 1 >() ; break;
+			case 2: Execute< 2 >() ; break;
+			case 3: Execute< 3 >() ; break;
+			default: ERROR_OUT( "Only dimensions 1, 2, and 3 supported: " , dim );
+		}
 	}
+	catch( const std::exception &e ){ ERROR_OUT( e.what() ); }
+	if( Stats.set ) Instrumentation::WriteStats( Stats.value , "ProcessGrid" );
+	if( Trace.set ) Instrumentation::WriteTrace( Trace.value , "ProcessGrid" );
 	return EXIT_SUCCESS;
 }
@@ -0,0 +1,216 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <map>
+#include <limits>
+#include <tuple>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <omp.h>
+#include "Misha/Miscellany.h"
+#include "Misha/CmdLineParser.h"
+#include "Misha/Geometry.h"
+#include "Include/GridGenerator.h"
+#include "Include/Timings.h"
+
+static const unsigned int Dim = 2;
+// The number of labels in the label field
+static const unsigned int Labels = 3;
+
+Misha::CmdLineParameter< std::string > Bin( "bin" , "Bin/Linux/" ) , Temp( "temp" , "." ) , Out( "out" ) , Baseline( "baseline" );
+Misha::CmdLineParameter< unsigned int > MinResolution( "minRes" , 256 ) , MaxResolution( "maxRes" , 16384 ) , MaxThreads( "maxThreads" , 0 ) , Trials( "trials" , 1 ) , Seed( "seed" , 0 );
+Misha::CmdLineParameter< double > Slack( "slack" , 1.5 );
+Misha::CmdLineReadable RunDefaults( "run" ) , Keep( "keep" ) , Verbose( "verbose" );
+
+Misha::CmdLineReadable* params[] =
+{
+	&RunDefaults ,
+	&Bin ,
+	&Temp ,
+	&Out ,
+	&Baseline ,
+	&MinResolution ,
+	&MaxResolution ,
+	&MaxThreads ,
+	&Trials ,
+	&Seed ,
+	&Slack ,
+	&Keep ,
+	&Verbose ,
+	NULL
+};
+
+void ShowUsage( const char* ex )
+{
+	std::cout << "Usage " << std::string( ex ) << ":" << std::endl;
+	std::cout << "\t[--" << RunDefaults.name << "] (runs the benchmark if no other argument is given)" << std::endl;
+	std::cout << "\t[--" << Bin.name << " <directory containing the executables>=" << Bin.value << "]" << std::endl;
+	std::cout << "\t[--" << Temp.name << " <directory for the intermediate files>=" << Temp.value << "]" << std::endl;
+	std::cout << "\t[--" << Out.name << " <output timings (CSV)>]" << std::endl;
+	std::cout << "\t[--" << Baseline.name << " <baseline timings (CSV)>]" << std::endl;
+	std::cout << "\t[--" << MinResolution.name << " <minimum grid resolution>=" << MinResolution.value << "]" << std::endl;
+	std::cout << "\t[--" << MaxResolution.name << " <maximum grid resolution>=" << MaxResolution.value << "]" << std::endl;
+	std::cout << "\t[--" << MaxThreads.name << " <maximum number of threads (0 for all cores)>=" << MaxThreads.value << "]" << std::endl;
+	std::cout << "\t[--" << Trials.name << " <number of runs per measurement>=" << Trials.value << "]" << std::endl;
+	std::cout << "\t[--" << Seed.name << " <random seed>=" << Seed.value << "]" << std::endl;
+	std::cout << "\t[--" << Slack.name << " <allowed slow-down relative to the baseline>=" << Slack.value << "]" << std::endl;
+	std::cout << "\t[--" << Keep.name << "]" << std::endl;
+	std::cout << "\t[--" << Verbose.name << "]" << std::endl;
+}
+
+enum Tool
+{
+	MARCHING_TRIANGLES ,
+	MULTI_MARCHING_TRIANGLES ,
+	PROCESS_GRID ,
+	SMOOTH_CURVE ,
+	CURVE_TO_TUBE ,
+	TOOL_COUNT
+};
+const std::string ToolNames[] = { "MarchingTriangles" , "MultiMarchingTriangles" , "ProcessGrid" , "SmoothCurve" , "CurveToTube" };
+// The units in which the throughput of a tool is measured (millions of grid samples or of curve vertices per second)
+const std::string ToolUnits[] = { "Msamples/s" , "Msamples/s" , "Msamples/s" , "Mvertices/s" , "Mvertices/s" };
+
+// A (tool , grid resolution , thread count) key
+using Key = std::tuple< std::string , unsigned int , unsigned int >;
+
+struct Measurement
+{
+	double seconds , throughput , peakMemory , efficiency;
+};
+
+// Returns the number of vertices in the header of a PLY file
+size_t PLYVertexCount( std::string fileName )
+{
+	std::ifstream stream( fileName , std::ios::binary );
+	if( !stream.is_open() ) ERROR_OUT( "Could not open file for reading: " , fileName );
+	std::string line;
+	while( std::getline( stream , line ) && line.find( "end_header" )!=0 )
+	{
+		std::stringstream ss( line );
+		std::string element , name;
+		size_t count;
+		if( ss >> element >> name >> count && element=="element" && name=="vertex" ) return count;
+	}
+	ERROR_OUT( "Could not find vertex count: " , fileName );
+	return 0;
+}
+
+// Returns the (numerical) value associated with the key in the statistics written by a tool
+double StatsValue( std::string fileName , std::string key )
+{
+	std::ifstream stream( fileName );
+	if( !stream.is_open() ) ERROR_OUT( "Could not open statistics for reading: " , fileName );
+	std::stringstream ss;
+	ss << stream.rdbuf();
+	std::string stats = ss.str();
+	size_t pos = stats.find( "\"" + key + "\":" );
+	if( pos==std::string::npos ) ERROR_OUT( "Could not find statistic: " , key , " in " , fileName );
+	return std::stod( stats.substr( pos + key.size() + 3 ) );
+}
+
+// Runs the tool with the prescribed number of threads, returning the (smallest) wall-clock time over the trials and setting the peak memory usage
+double Run( Tool tool , std::string arguments , unsigned int threads , double &peakMemory )
+{
+	std::string stats = Temp.value + "/bench.stats.json";
+	std::string command = Bin.value + ToolNames[tool] + " " + arguments + " --stats " + stats;
+#ifdef _WIN32
+	_putenv_s( "OMP_NUM_THREADS" , std::to_string( threads ).c_str() );
+#else // !_WIN32
+	setenv( "OMP_NUM_THREADS" , std::to_string( threads ).c_str() , 1 );
+	command += " > /dev/null";
+#endif // _WIN32
+	if( Verbose.set ) std::cout << "\t[" << threads << "] " << command << std::endl;
+
+	double seconds = std::numeric_limits< double >::infinity();
+	peakMemory = 0;
+	for( unsigned int t=0 ; t<Trials.value ; t++ )
+	{
+		Miscellany::Timer timer;
+		if( std::system( command.c_str() ) ) ERROR_OUT( "Command failed: " , command );
+		seconds = std::min< double >( seconds , timer() );
+		peakMemory = std::max< double >( peakMemory , StatsValue( stats , "peak memory (MB)" ) );
+	}
+	std::remove( stats.c_str() );
+	return seconds;
+}
+
+int main( int argc , char* argv[] )
+{
+	Misha::CmdLineParse( argc-1 , argv+1 , params );
+	// [NOTE] Since all the parameters are optional, the benchmark runs only if some argument is given, with --run running it with the default settings
+	if( argc<2 )
+	{
+		ShowUsage( argv[0] );
+		return EXIT_SUCCESS;
+	}
+
+	// The thread counts: powers of two, followed by the number of cores
+	unsigned int maxThreads = MaxThreads.value ? MaxThreads.value : (unsigned int)omp_get_num_procs();
+	std::vector< unsigned int > threadCounts;
+	for( unsigned int threads=1 ; threads<maxThreads ; threads*=2 ) threadCounts.push_back( threads );
+	threadCounts.push_back( maxThreads );
+
+	std::map< Key , Measurement > measurements;
+	for( unsigned int res=MinResolution.value ; res<=MaxResolution.value ; res*=2 )
+	{
+		std::string curve = Temp.value + "/bench.curve." + std::to_string( res ) + ".ply";
+		std::string tube = Temp.value + "/bench.tube." + std::to_string( res ) + ".ply";
+
+		// The scalar grid is noise with a fixed number of features, so that the number of active cells grows linearly with the resolution,
+		// and the label grid is a Voronoi field with a fixed number of sites per label
+		// [NOTE] The grids are passed to the tools as procedural descriptions, so that they are generated in memory rather than written to (and read from) disk
+		std::string scalarGrid , labelGrid;
+		{
+			GridGenerator::Description description;
+			description.dim = Dim , description.res = res , description.seed = Seed.value;
+			description.field = GridGenerator::NOISE , description.channels = 1;
+			scalarGrid = description.toString();
+			description.field = GridGenerator::VORONOI , description.channels = Labels;
+			labelGrid = description.toString();
+		}
+
+		// The curve input is the level-set extracted from the scalar grid, so the curve size grows with the resolution
+		// [NOTE] The extraction that generates the curve is not timed, so that writing does not contribute to the extraction timings
+		{
+			double peakMemory;
+			Run( MARCHING_TRIANGLES , "--in " + scalarGrid + " --out " + curve , maxThreads , peakMemory );
+		}
+		size_t curveVertices = PLYVertexCount( curve );
+
+		for( unsigned int tool=0 ; tool<TOOL_COUNT ; tool++ )
+		{
+			std::string arguments;
+			double size = 0;
+			switch( tool )
+			{
+			case MARCHING_TRIANGLES:       arguments = "--in " + scalarGrid                                          ; size = (double)res * res     ; break;
+			case MULTI_MARCHING_TRIANGLES: arguments = "--in " + labelGrid                                           ; size = (double)res * res     ; break;
+			case PROCESS_GRID:             arguments = "--in " + scalarGrid + " --iters 8"                           ; size = (double)res * res     ; break;
+			case SMOOTH_CURVE:             arguments = "--in " + curve + " --diffusion 1e-4"                         ; size = (double)curveVertices ; break;
+			case CURVE_TO_TUBE:            arguments = "--in " + curve + " --radius 1e-3 --res 8 --out " + tube      ; size = (double)curveVertices ; break;
+			default: ERROR_OUT( "Unrecognized tool: " , tool );
+			}
+
+			double serialSeconds = 0;
+			for( unsigned int i=0 ; i<threadCounts.size() ; i++ )
+			{
+				Measurement m;
+				m.seconds = Run( (Tool)tool , arguments , threadCounts[i] , m.peakMemory );
+				if( !i ) serialSeconds = m.seconds;
+				m.throughput = size / m.seconds / 1e6;
+				m.efficiency = serialSeconds / ( m.seconds * threadCounts[i] );
+				measurements[ Key( ToolNames[tool] , res , threadCounts[i] ) ] = m;
+				std::cout << ToolNames[tool] << " , resolution " << res << " , threads " << threadCounts[i] << ": " << m.seconds << " (s) , " << m.throughput << " (" << ToolUnits[tool] << ") , " << m.peakMemory << " (MB) , efficiency " << m.efficiency << std::endl;
+			}
+		}
+
+		if( !Keep.set ) for( std::string fileName : { curve , tube } ) std::remove( fileName.c_str() );
+	}
+
+	if( Out.set ) Timings::Write( Out.value , "tool,resolution,threads,seconds,throughput,peak_memory_mb,efficiency" , measurements , []( const Measurement &m ){ return std::make_tuple( m.seconds , m.throughput , m.peakMemory , m.efficiency ); } );
+
+	bool success = !Baseline.set || Timings::CheckBaseline( Baseline.value , measurements , Slack.value , []( const Measurement &m ){ return m.seconds; } );
+
+	return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -1,14 +1,16 @@
 #include <iostream>
-#include <Eigen/Sparse>
 #include "Misha/Miscellany.h"
 #include "Misha/CmdLineParser.h"
 #include "Misha/Ply.h"
 #include "Misha/PlyVertexData.h"
+#include "Include/CurveSmoother.h"
+#include "Include/Instrumentation.h"
 
 static const unsigned int Dim = 2;
 
-Misha::CmdLineParameter< std::string > In( "in" ) , Out( "out" );
+Misha::CmdLineParameter< std::string > In( "in" ) , Out( "out" ) , Stats( "stats" ) , Trace( "trace" );
 Misha::CmdLineParameter< double > DiffusionTime( "diffusion" , 1e-4 );
+Misha::CmdLineParameters< double > DiffusionTimes( "diffusions" );
 Misha::CmdLineReadable Verbose( "verbose" ) , Performance( "performance" );
 
 Misha::CmdLineReadable* params[] =
@@ -16,8 +18,11 @@ Misha::CmdLineReadable* params[] =
 	&In ,
 	&Out ,
 	&DiffusionTime ,
+	&DiffusionTimes ,
 	&Verbose ,
 	&Performance ,
+	&Stats ,
+	&Trace ,
 	NULL
 };
 
@@ -30,8 +35,19 @@ void ShowUsage( const char* ex )
 		Miscellany::StreamFloatPrecision sfw( std::cout , 1 , true );
 		std::cout << "\t[--" << DiffusionTime.name << " <diffusion time>=" << DiffusionTime.value << "]" << std::endl;
 	}
+	std::cout << "\t[--" << DiffusionTimes.name << " <diffusion time count> <diffusion times>]" << std::endl;
 	std::cout << "\t[--" << Performance.name << "]" << std::endl;
 	std::cout << "\t[--" << Verbose.name << "]" << std::endl;
+	std::cout << "\t[--" << Stats.name << " <output statistics (JSON)>]" << std::endl;
+	std::cout << "\t[--" << Trace.name << " <output trace (Chrome trace-event JSON)>]" << std::endl;
+}
+
+// Returns the name of the output file for the prescribed scale, inserting the index of the scale before the extension
+std::string OutputName( std::string fileName , unsigned int scale )
+{
+	size_t dot = fileName.find_last_of( '.' ) , slash = fileName.find_last_of( "/\\" );
+	if( dot==std::string::npos || ( slash!=std::string::npos && dot<slash ) ) dot = fileName.size();
+	return fileName.substr( 0 , dot ) + "." + std::to_string( scale ) + fileName.substr( dot );
 }
 
 int main( int argc , char* argv[] )
@@ -44,6 +60,7 @@ int main( int argc , char* argv[] )
 		ShowUsage( argv[0] );
 		return EXIT_SUCCESS;
 	}
+	if( Stats.set || Trace.set ) Instrumentation::Enable();
 
 	Miscellany::Timer timer , subTimer;
 
@@ -54,7 +71,10 @@ int main( int argc , char* argv[] )
 
 	Factory vFactory;
 	int file_type;
-	PLY::ReadSimplices( In.value , vFactory , vertices , edges , NULL , file_type );
+	{
+		Instrumentation::Scope scope( "read" );
+		PLY::ReadSimplices( In.value , vFactory , vertices , edges , NULL , file_type );
+	}
 
 	std::cout << "Input vertices/edges: " << vertices.size() << " / " << edges.size() << std::endl;
 
@@ -65,54 +85,36 @@ int main( int argc , char* argv[] )
 	for( unsigned int i=0 ; i<vertices.size() ; i++ ) vertices[i] /= scale;
 
 	subTimer.reset();
-	Eigen::SparseMatrix< double > M( vertices.size() , vertices.size() ) , S( vertices.size() , vertices.size() );
+	CurveSmoother< Dim > smoother( vertices , edges );
+	if( Verbose.set )
 	{
-		std::vector< Eigen::Triplet< double > > M_triplets , S_triplets;
-
-		for( unsigned int i=0 ; i<edges.size() ; i++ )
-		{
-			double len = sqrt( ( vertices[ edges[i][0] ] - vertices[ edges[i][1] ] ).squareNorm() );
-			// Construct the mass matrix coefficients associated to this edge
-			{
-				M_triplets.emplace_back( edges[i][0] , edges[i][0] , len/3. );
-				M_triplets.emplace_back( edges[i][1] , edges[i][1] , len/3. );
-				M_triplets.emplace_back( edges[i][0] , edges[i][1] , len/6. );
-				M_triplets.emplace_back( edges[i][1] , edges[i][0] , len/6. );
-			}
-
-			// Construct the stiffness matrix coefficients associated to this edge
-			{
-				S_triplets.emplace_back( edges[i][0] , edges[i][0] ,  1/len );
-				S_triplets.emplace_back( edges[i][1] , edges[i][1] ,  1/len );
-				S_triplets.emplace_back( edges[i][0] , edges[i][1] , -1/len );
-				S_triplets.emplace_back( edges[i][1] , edges[i][0] , -1/len );
-			}
-		}
-
-		M.setFromTriplets( M_triplets.begin() , M_triplets.end() );
-		S.setFromTriplets( S_triplets.begin() , S_triplets.end() );
+		std::cout << "Analyzed curve: " << subTimer() << std::endl;
+		for( unsigned int t=0 ; t<CurveSmoother< Dim >::COMPONENT_TYPE_COUNT ; t++ )
+			std::cout << "\t" << CurveSmoother< Dim >::ComponentTypeNames[t] << " components: " << smoother.components( (CurveSmoother< Dim >::ComponentType)t ) << std::endl;
 	}
-	if( Verbose.set ) std::cout << "Set mass and stiffness: " << subTimer() << std::endl;
 
-	subTimer.reset();
-	Eigen::SimplicialLDLT< Eigen::SparseMatrix< double > > solver( M + S*DiffusionTime.value );
-	if( Verbose.set ) std::cout << "Factored system matrix: " << subTimer() << std::endl;
+	// The diffusion times, one per output scale
+	std::vector< double > diffusionTimes;
+	if( DiffusionTimes.set ) diffusionTimes.assign( DiffusionTimes.values , DiffusionTimes.values + DiffusionTimes.count );
+	else diffusionTimes.push_back( DiffusionTime.value );
 
-	subTimer.reset();
-	Eigen::VectorXd b( vertices.size() );
-	for( unsigned int d=0 ; d<Dim ; d++ )
+	// [NOTE] The curve is analyzed once and each scale is obtained by diffusing the input curve, re-factoring only the numerical values
+	std::vector< Factory::VertexType > smoothed( vertices.size() );
+	for( unsigned int s=0 ; s<diffusionTimes.size() ; s++ )
 	{
-		for( unsigned int i=0 ; i<vertices.size() ; i++ ) b[i] = vertices[i][d];
-		b = solver.solve( M * b );
-		for( unsigned int i=0 ; i<vertices.size() ; i++ ) vertices[i][d] = b[i];
+		subTimer.reset();
+		try{ smoother.smooth( vertices , diffusionTimes[s] , smoothed ); }
+		catch( const std::exception &e ){ ERROR_OUT( e.what() ); }
+		if( Verbose.set ) std::cout << "Solved system[" << diffusionTimes[s] << "]: " << subTimer() << std::endl;
+
+		for( unsigned int i=0 ; i<smoothed.size() ; i++ ) smoothed[i] *= scale;
+		Instrumentation::Scope scope( "write" );
+		if( Out.set ) PLY::WriteSimplices( diffusionTimes.size()>1 ? OutputName( Out.value , s ) : Out.value , vFactory , smoothed , edges , file_type );
 	}
-	if( Verbose.set ) std::cout << "Solved system: " << subTimer() << std::endl;
-
-
-	for( unsigned int i=0 ; i<vertices.size() ; i++ ) vertices[i] *= scale;
-	if( Out.set ) PLY::WriteSimplices( Out.value , vFactory , vertices , edges , file_type );
 
 	if( Performance.set ) std::cout << "Performance: " << timer() << ", " << Miscellany::MemoryInfo::PeakMemoryUsageMB() << " (MB)" << std::endl;
+	if( Stats.set ) Instrumentation::WriteStats( Stats.value , "SmoothCurve" );
+	if( Trace.set ) Instrumentation::WriteTrace( Trace.value , "SmoothCurve" );
 
 	return EXIT_SUCCESS;
 }